@@ -9,36 +9,79 @@
 
 using namespace Noise3D::Core;
 
-CAllocator::CAllocator(uint32_t addressSpaceSize)
+CAllocator::CAllocator(uint64_t addressSpaceSize, NOISE_ALLOCATION_POLICY policy)
 {
 	mAddressSpaceSize = addressSpaceSize;
+	mPolicy = policy;
+	mNextFitCursor = 0;
 
 	//init free segment list with the entire address space
 	m_pFreeSegmentList = new std::list<N_AddressRange>;
 	m_pFreeSegmentList->push_back(N_AddressRange(0,addressSpaceSize));
+	m_pExtraReferenceMap = new std::unordered_map<uint64_t, uint32_t>;
 }
 
-uint32_t CAllocator::Allocate(uint32_t size)
+uint64_t CAllocator::Allocate(uint64_t size)
 {
 	//range = [start,end)
 
-	//FIRST FIT algorithm
-	for (auto pFreeSegIter = m_pFreeSegmentList->begin(); pFreeSegIter != m_pFreeSegmentList->end(); ++pFreeSegIter)
+	if (mPolicy == NOISE_ALLOCATION_POLICY_BEST_FIT)
 	{
-		uint32_t freeSegStart = pFreeSegIter->start;
-		uint32_t freeSegEnd = pFreeSegIter->start + pFreeSegIter->size;
-		uint32_t allocatedEnd = freeSegStart + size;
+		//BEST FIT algorithm : the smallest segment which is large enough
+		auto pBestSegIter = m_pFreeSegmentList->end();
+		for (auto pFreeSegIter = m_pFreeSegmentList->begin(); pFreeSegIter != m_pFreeSegmentList->end(); ++pFreeSegIter)
+		{
+			if (pFreeSegIter->size >= size && (pBestSegIter == m_pFreeSegmentList->end() || pFreeSegIter->size < pBestSegIter->size))
+			{
+				pBestSegIter = pFreeSegIter;
+				if (pBestSegIter->size == size)break;//can't be better
+			}
+		}
+		if (pBestSegIter == m_pFreeSegmentList->end())return c_invalid_alloc_address;
+
+		uint64_t freeSegStart = pBestSegIter->start;
+		if (pBestSegIter->size == size)
+		{
+			m_pFreeSegmentList->erase(pBestSegIter);
+		}
+		else
+		{
+			*pBestSegIter = N_AddressRange(freeSegStart + size, pBestSegIter->size - size);
+		}
+		return freeSegStart;
+	}
+
+	//NEXT FIT starts searching from the segment which contains/follows the cursor, 
+	//then wraps around. FIRST FIT always starts from the lowest address.
+	auto pStartIter = m_pFreeSegmentList->begin();
+	if (mPolicy == NOISE_ALLOCATION_POLICY_NEXT_FIT)
+	{
+		while (pStartIter != m_pFreeSegmentList->end() && pStartIter->start + pStartIter->size <= mNextFitCursor)++pStartIter;
+		if (pStartIter == m_pFreeSegmentList->end())pStartIter = m_pFreeSegmentList->begin();
+	}
+
+	uint32_t segCount = uint32_t(m_pFreeSegmentList->size());
+	auto pFreeSegIter = pStartIter;
+	for (uint32_t i = 0; i < segCount; ++i, ++pFreeSegIter)
+	{
+		if (pFreeSegIter == m_pFreeSegmentList->end())pFreeSegIter = m_pFreeSegmentList->begin();
+
+		uint64_t freeSegStart = pFreeSegIter->start;
+		uint64_t freeSegEnd = pFreeSegIter->start + pFreeSegIter->size;
+		uint64_t allocatedEnd = freeSegStart + size;
 
 		if (pFreeSegIter->size > size)
 		{
 			//1. first fit match, latter part of this segment still remains free
 			*pFreeSegIter = N_AddressRange(allocatedEnd, freeSegEnd - allocatedEnd);
+			mNextFitCursor = allocatedEnd;
 			return freeSegStart;
 		}
 		else 	if (pFreeSegIter->size == size)
 		{
 			//2.first fit match, entire segment is allocated
 			m_pFreeSegmentList->erase(pFreeSegIter);
+			mNextFitCursor = allocatedEnd;
 			return freeSegStart;
 		}
 	}
@@ -47,16 +90,16 @@ uint32_t CAllocator::Allocate(uint32_t size)
 	return c_invalid_alloc_address;
 }
 
-bool CAllocator::Allocate(uint32_t start, uint32_t size)
+bool CAllocator::Allocate(uint64_t start, uint64_t size)
 {
 	//range = [start,end)
-	uint32_t end = start + size;
+	uint64_t end = start + size;
 
 	for(auto pFreeSegIter =m_pFreeSegmentList->begin();pFreeSegIter!=m_pFreeSegmentList->end();++pFreeSegIter)
 	{ 
 		// ----------iterStart----------start----------end------------iterEnd--------
-		uint32_t freeSegStart = pFreeSegIter->start;
-		uint32_t freeSegEnd = pFreeSegIter->start + pFreeSegIter->size;
+		uint64_t freeSegStart = pFreeSegIter->start;
+		uint64_t freeSegEnd = pFreeSegIter->start + pFreeSegIter->size;
 
 		//there are several LEGITIMATE circumstances of allocation
 		if (start > freeSegStart && end < freeSegEnd)
@@ -98,9 +141,17 @@ bool CAllocator::Allocate(uint32_t start, uint32_t size)
 }
 
 
-bool CAllocator::Release(uint32_t start, uint32_t size)
+bool CAllocator::Release(uint64_t start, uint64_t size)
 {
-	uint32_t end = start + size;
+	//shared segment : only a reference is dropped
+	auto refIter = m_pExtraReferenceMap->find(start);
+	if (refIter != m_pExtraReferenceMap->end())
+	{
+		if (--refIter->second == 0)m_pExtraReferenceMap->erase(refIter);
+		return true;
+	}
+
+	uint64_t end = start + size;
 
 	//insert 2 empty auxiliary segments at boudnary unify the process of merging free segment
 	m_pFreeSegmentList->push_front(N_AddressRange(0, 0));
@@ -113,8 +164,8 @@ bool CAllocator::Release(uint32_t start, uint32_t size)
 	//loop through the "Free Segment List"
 	while (pFreeSeg2 != m_pFreeSegmentList->end())
 	{
-		uint32_t seg1End = pFreeSeg1->start + pFreeSeg1->size;
-		uint32_t seg2start = pFreeSeg2->start;
+		uint64_t seg1End = pFreeSeg1->start + pFreeSeg1->size;
+		uint64_t seg2start = pFreeSeg2->start;
 
 		if (start > seg1End && end < seg2start)
 		{
@@ -169,9 +220,106 @@ bool CAllocator::Release(uint32_t start, uint32_t size)
 	return false;
 }
 
+bool CAllocator::ReleaseRanges(std::vector<N_AddressRange>& ranges)
+{
+	std::sort(ranges.begin(), ranges.end(), [](const N_AddressRange& a, const N_AddressRange& b) {return a.start < b.start; });
+
+	//releases of a shared segment drop its extra references first (the same segment is
+	//adjacent in sorted ranges), only the last one frees it
+	std::unordered_map<uint64_t, uint32_t> droppedReferences;
+	std::vector<N_AddressRange> freedRanges;
+	freedRanges.reserve(ranges.size());
+	for (auto& range : ranges)
+	{
+		auto refIter = m_pExtraReferenceMap->find(range.start);
+		if (refIter != m_pExtraReferenceMap->end() && droppedReferences[range.start] < refIter->second)
+			++droppedReferences[range.start];
+		else
+			freedRanges.push_back(range);
+	}
+
+	//sorted ranges and free segments are merged into a new list (adjacent segments coalesce),
+	//the old list is kept until every range is proven legal
+	std::list<N_AddressRange> newFreeSegmentList;
+	auto appendSegment = [&newFreeSegmentList](const N_AddressRange& seg)
+	{
+		if (!newFreeSegmentList.empty() && newFreeSegmentList.back().start + newFreeSegmentList.back().size == seg.start)
+			newFreeSegmentList.back().size += seg.size;
+		else
+			newFreeSegmentList.push_back(seg);
+	};
+
+	auto pFreeSegIter = m_pFreeSegmentList->begin();
+	uint64_t lastEnd = 0;
+	for (auto& range : freedRanges)
+	{
+		if (range.size == 0)continue;
+		if (range.start < lastEnd || range.start > mAddressSpaceSize || range.size > mAddressSpaceSize - range.start)return false;
+
+		while (pFreeSegIter != m_pFreeSegmentList->end() && pFreeSegIter->start + pFreeSegIter->size <= range.start)
+			appendSegment(*pFreeSegIter++);
+
+		//free segment behind range's start overlaps it
+		if (pFreeSegIter != m_pFreeSegmentList->end() && pFreeSegIter->start < range.start + range.size)return false;
+
+		appendSegment(range);
+		lastEnd = range.start + range.size;
+	}
+	while (pFreeSegIter != m_pFreeSegmentList->end())appendSegment(*pFreeSegIter++);
+
+	m_pFreeSegmentList->swap(newFreeSegmentList);
+	for (auto& dropped : droppedReferences)
+	{
+		auto refIter = m_pExtraReferenceMap->find(dropped.first);
+		refIter->second -= dropped.second;
+		if (refIter->second == 0)m_pExtraReferenceMap->erase(refIter);
+	}
+	return true;
+}
+
 void CAllocator::ReleaseAllSpace()
 {
-	m_pFreeSegmentList->resize(1, N_AddressRange(0, mAddressSpaceSize));
+	m_pFreeSegmentList->clear();
+	m_pFreeSegmentList->push_back(N_AddressRange(0, mAddressSpaceSize));
+	m_pExtraReferenceMap->clear();
+	mNextFitCursor = 0;
+}
+
+void CAllocator::AddReference(uint64_t start)
+{
+	++(*m_pExtraReferenceMap)[start];
+}
+
+uint32_t CAllocator::GetReferenceCount(uint64_t start)
+{
+	auto refIter = m_pExtraReferenceMap->find(start);
+	return refIter == m_pExtraReferenceMap->end() ? 1 : refIter->second + 1;
+}
+
+bool CAllocator::GrowAddressSpace(uint64_t newAddressSpaceSize)
+{
+	if (newAddressSpaceSize < mAddressSpaceSize)return false;
+	if (newAddressSpaceSize == mAddressSpaceSize)return true;
+
+	//the appended range is released like an allocated one, so it merges with a free tail
+	uint64_t oldAddressSpaceSize = mAddressSpaceSize;
+	mAddressSpaceSize = newAddressSpaceSize;
+	return Release(oldAddressSpaceSize, newAddressSpaceSize - oldAddressSpaceSize);
+}
+
+bool CAllocator::ShrinkAddressSpace(uint64_t newAddressSpaceSize)
+{
+	if (newAddressSpaceSize > mAddressSpaceSize)return false;
+	if (newAddressSpaceSize == mAddressSpaceSize)return true;
+
+	//the cut range must lie in the free tail (NEXT FIT cursor beyond the end wraps around)
+	if (m_pFreeSegmentList->empty())return false;
+	N_AddressRange& tailSeg = m_pFreeSegmentList->back();
+	if (tailSeg.start + tailSeg.size != mAddressSpaceSize || tailSeg.start > newAddressSpaceSize)return false;
+	tailSeg.size = newAddressSpaceSize - tailSeg.start;
+	if (tailSeg.size == 0)m_pFreeSegmentList->pop_back();
+	mAddressSpaceSize = newAddressSpaceSize;
+	return true;
 }
 
 bool CAllocator::IsAddressSpaceRanOut()
@@ -179,14 +327,36 @@ bool CAllocator::IsAddressSpaceRanOut()
 	return (m_pFreeSegmentList->size()==0);
 }
 
-uint32_t CAllocator::GetFreeSpace()
+uint64_t CAllocator::GetFreeSpace()
 {
-	uint32_t fs=0;
+	uint64_t fs=0;
 	for (auto seg : *m_pFreeSegmentList)fs += seg.size;
 	return fs;
 }
 
-uint32_t CAllocator::GetTotalSpace()
+uint64_t CAllocator::GetTotalSpace()
 {
 	return mAddressSpaceSize;
 }
+
+uint32_t CAllocator::GetFreeSegmentCount()
+{
+	return uint32_t(m_pFreeSegmentList->size());
+}
+
+uint64_t CAllocator::GetLargestFreeSegmentSize()
+{
+	uint64_t largest = 0;
+	for (auto& seg : *m_pFreeSegmentList)if (seg.size > largest)largest = seg.size;
+	return largest;
+}
+
+void CAllocator::GetFreeSegments(std::vector<N_AddressRange>& outSegments)
+{
+	outSegments.assign(m_pFreeSegmentList->begin(), m_pFreeSegmentList->end());
+}
+
+NOISE_ALLOCATION_POLICY CAllocator::GetPolicy()
+{
+	return mPolicy;
+}
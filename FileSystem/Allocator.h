@@ -19,43 +19,75 @@ namespace Noise3D
 {
 	namespace Core
 	{
-		const uint32_t c_invalid_alloc_address = 0xffffffff;
+		const uint64_t c_invalid_alloc_address = 0xffffffffffffffff;
+
+		enum NOISE_ALLOCATION_POLICY
+		{
+			NOISE_ALLOCATION_POLICY_FIRST_FIT = 0,//the lowest free segment that is large enough
+			NOISE_ALLOCATION_POLICY_BEST_FIT = 1,//the smallest free segment that is large enough
+			NOISE_ALLOCATION_POLICY_NEXT_FIT = 2//first fit, but search from where the last allocation ended
+		};
 
 		struct N_AddressRange
 		{
-			N_AddressRange(uint32_t _start, uint32_t _size)
+			N_AddressRange(uint64_t _start, uint64_t _size)
 			{
 				start = _start; 
 				size = _size; 
 			}
-			uint32_t start;
-			uint32_t size;
+			uint64_t start;
+			uint64_t size;
 		};
 
 		class /*_declspec(dllexport)*/ CAllocator 
 		{
 		public:
 
-			CAllocator(uint32_t addressSpaceSize);
+			CAllocator(uint64_t addressSpaceSize, NOISE_ALLOCATION_POLICY policy = NOISE_ALLOCATION_POLICY_FIRST_FIT);
 
-			uint32_t	Allocate(uint32_t size);//start address of the allocated segment is decided by allocator,0xffffffff for failure
+			uint64_t	Allocate(uint64_t size);//start address of the allocated segment is decided by allocator,c_invalid_alloc_address for failure
 
-			bool			Allocate(uint32_t start,uint32_t size);//forcely choose the start address of allocated segment
+			bool			Allocate(uint64_t start,uint64_t size);//forcely choose the start address of allocated segment
 
-			bool			Release(uint32_t start,uint32_t size);//return true if the release is legal(no free address is "released")
+			bool			Release(uint64_t start,uint64_t size);//return true if the release is legal(no free address is "released"). a shared segment only loses one reference
+
+			//release many segments in one merge pass (ranges are sorted in place).
+			//nothing is released if any range is illegal (overlapped or already free)
+			bool			ReleaseRanges(std::vector<N_AddressRange>& ranges);
 
 			void			ReleaseAllSpace();//release all allocated address
 
+			//shared segment (copy-on-write) : every AddReference needs one more Release before the segment
+			//is really freed. start must be the start of an allocated segment
+			void			AddReference(uint64_t start);
+
+			uint32_t	GetReferenceCount(uint64_t start);//1 for a segment that isn't shared
+
+			bool			GrowAddressSpace(uint64_t newAddressSpaceSize);//the appended part of address space is free
+
+			bool			ShrinkAddressSpace(uint64_t newAddressSpaceSize);//false unless the cut part of address space is free
+
 			bool			IsAddressSpaceRanOut();
 
-			uint32_t	GetFreeSpace();
+			uint64_t	GetFreeSpace();
+
+			uint64_t	GetTotalSpace();
+
+			uint32_t	GetFreeSegmentCount();
+
+			uint64_t	GetLargestFreeSegmentSize();
+
+			void			GetFreeSegments(std::vector<N_AddressRange>& outSegments);//sorted by address
 
-			uint32_t	GetTotalSpace();
+			NOISE_ALLOCATION_POLICY GetPolicy();
 
 		private:
 
-			uint32_t	mAddressSpaceSize;
+			uint64_t	mAddressSpaceSize;
+			NOISE_ALLOCATION_POLICY mPolicy;
+			uint64_t	mNextFitCursor;//(NEXT FIT only)end address of the last managed allocation
 			std::list<N_AddressRange>* m_pFreeSegmentList;//list of <start,size>
+			std::unordered_map<uint64_t, uint32_t>* m_pExtraReferenceMap;//start of shared segment -> reference count - 1
 		};
 
 	}
@@ -0,0 +1,128 @@
+/***********************************************************************
+
+									cppArchive
+
+************************************************************************/
+
+#include "Noise3D.h"
+
+using namespace Noise3D::Core;
+
+/***************************************************
+						ARCHIVE WRITER
+****************************************************/
+
+CArchiveWriter::CArchiveWriter() :
+	m_pArchiveFile(nullptr),
+	mChecksum(0)
+{
+}
+
+CArchiveWriter::~CArchiveWriter()
+{
+	if (m_pArchiveFile != nullptr)Close();
+}
+
+bool CArchiveWriter::Open(NFilePath archivePath)
+{
+	if (m_pArchiveFile != nullptr)
+	{
+		ERROR_MSG("Archive : Open failure! archive is already opened.");
+		return false;
+	}
+
+	//(stream buffer must be given before the file is opened)
+	mStreamBuffer.resize(c_StreamBufferSize);
+	m_pArchiveFile = new std::ofstream;
+	m_pArchiveFile->rdbuf()->pubsetbuf(&mStreamBuffer.at(0), std::streamsize(mStreamBuffer.size()));
+	m_pArchiveFile->open(archivePath.c_str(), std::ios::binary | std::ios::trunc);
+	if (!m_pArchiveFile->is_open())
+	{
+		ERROR_MSG("Archive : Open failure! archive file can't be created.");
+		delete m_pArchiveFile;
+		m_pArchiveFile = nullptr;
+		return false;
+	}
+	mChecksum = 0;
+	return true;
+}
+
+bool CArchiveWriter::Write(const char * pData, uint64_t size)
+{
+	if (m_pArchiveFile == nullptr)return false;
+	if (size == 0)return true;
+	mChecksum = CChecksum::CRC32C(pData, size, mChecksum);
+	m_pArchiveFile->write(pData, std::streamsize(size));
+	return m_pArchiveFile->good();
+}
+
+bool CArchiveWriter::Close()
+{
+	if (m_pArchiveFile == nullptr)return false;
+	m_pArchiveFile->write(reinterpret_cast<const char*>(&mChecksum), sizeof(mChecksum));
+	m_pArchiveFile->flush();
+	bool isSucceeded = m_pArchiveFile->good();
+	m_pArchiveFile->close();
+	delete m_pArchiveFile;
+	m_pArchiveFile = nullptr;
+	return isSucceeded;
+}
+
+/***************************************************
+						ARCHIVE READER
+****************************************************/
+
+CArchiveReader::CArchiveReader() :
+	m_pArchiveFile(nullptr),
+	mChecksum(0)
+{
+}
+
+CArchiveReader::~CArchiveReader()
+{
+	if (m_pArchiveFile != nullptr)Close();
+}
+
+bool CArchiveReader::Open(NFilePath archivePath)
+{
+	if (m_pArchiveFile != nullptr)
+	{
+		ERROR_MSG("Archive : Open failure! archive is already opened.");
+		return false;
+	}
+
+	m_pArchiveFile = new std::ifstream(archivePath.c_str(), std::ios::binary);
+	if (!m_pArchiveFile->is_open())
+	{
+		ERROR_MSG("Archive : Open failure! archive file can't be opened.");
+		delete m_pArchiveFile;
+		m_pArchiveFile = nullptr;
+		return false;
+	}
+	mChecksum = 0;
+	return true;
+}
+
+bool CArchiveReader::Read(char * pData, uint64_t size)
+{
+	if (m_pArchiveFile == nullptr)return false;
+	if (size == 0)return true;
+
+	//(large reads go from file straight into destination)
+	m_pArchiveFile->read(pData, std::streamsize(size));
+	if (uint64_t(m_pArchiveFile->gcount()) != size)return false;
+	mChecksum = CChecksum::CRC32C(pData, size, mChecksum);
+	return true;
+}
+
+bool CArchiveReader::Close()
+{
+	if (m_pArchiveFile == nullptr)return false;
+	uint32_t storedChecksum = 0;
+	m_pArchiveFile->read(reinterpret_cast<char*>(&storedChecksum), sizeof(storedChecksum));
+	bool isTrailerRead = (m_pArchiveFile->gcount() == sizeof(storedChecksum));
+	bool isEnded = (m_pArchiveFile->peek() == std::ifstream::traits_type::eof());
+	delete m_pArchiveFile;
+	m_pArchiveFile = nullptr;
+	return isTrailerRead && isEnded && storedChecksum == mChecksum;
+}
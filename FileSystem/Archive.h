@@ -0,0 +1,118 @@
+
+/***********************************************************************
+
+									hArchive
+
+			Desc: sequential archive of a directory subtree, written by
+			IFileSystem::ExportArchive and loaded into another virtual
+			disk by IFileSystem::ImportArchive. metadata of the whole
+			subtree comes first, so that the loader allocates i-nodes
+			and user space at once, then data of every file follows
+			in entry order, so that it's streamed into one contiguous
+			run of user space. the archive is checksummed as a whole.
+
+			archive file layout (little-endian):
+				header : magic(4) | version(4) | entryCount(4) |
+							nameAreaSize(4) | dataSize(8)
+				entry : parentEntry(4) | flags(4) | size(8) | storedSize(8) |
+							accessMode(2) | ownerUserID(1) | nameLength(1) | reserved(4)
+							(x entryCount. entry 0 is the exported folder itself,
+							a parent always comes before its children)
+				names : names of entries in entry order (not terminated)
+				data : storedSize bytes per file in entry order (compressed
+							files are kept compressed, inline data as well)
+				trailer : CRC32C of everything before it (4)
+
+************************************************************************/
+
+#pragma once
+
+namespace Noise3D
+{
+	namespace Core
+	{
+		const uint32_t c_ArchiveMagicNumber = 0x4352414e;//"NARC"
+		const uint32_t c_ArchiveVersion = 1;
+
+		enum NOISE_ARCHIVE_ENTRY_FLAG
+		{
+			NOISE_ARCHIVE_ENTRY_FLAG_FOLDER = 0x1,
+			NOISE_ARCHIVE_ENTRY_FLAG_COMPRESSED = 0x2,//data is LZ4 chunks (see Compression.h) of storedSize bytes
+		};
+
+		struct N_ArchiveHeader
+		{
+			N_ArchiveHeader() :magicNumber(c_ArchiveMagicNumber), versionNumber(c_ArchiveVersion), entryCount(0), nameAreaSize(0), dataSize(0) {}
+
+			uint32_t magicNumber;
+			uint32_t versionNumber;
+			uint32_t entryCount;
+			uint32_t nameAreaSize;
+			uint64_t dataSize;//sum of storedSize of files
+		};
+
+		//(32 bytes)
+		struct N_ArchiveEntry
+		{
+			N_ArchiveEntry() { memset(this, 0, sizeof(N_ArchiveEntry)); }
+
+			bool isFolder() const { return (flags & NOISE_ARCHIVE_ENTRY_FLAG_FOLDER) != 0; }
+
+			bool isCompressed() const { return (flags & NOISE_ARCHIVE_ENTRY_FLAG_COMPRESSED) != 0; }
+
+			uint32_t parentEntry;//index of entry of parent folder (0 for entry 0)
+			uint32_t flags;//NOISE_ARCHIVE_ENTRY_FLAG
+			uint64_t size;//file byte size (0 for folders)
+			uint64_t storedSize;//bytes of file in data area
+			uint16_t accessMode;
+			uint8_t ownerUserID;
+			uint8_t nameLength;
+			uint32_t reserved;
+		};
+
+		//archive file is written in one pass, trailer is appended by Close
+		class /*_declspec(dllexport)*/ CArchiveWriter
+		{
+		public:
+
+			CArchiveWriter();
+
+			~CArchiveWriter();//archive is closed
+
+			bool Open(NFilePath archivePath);
+
+			bool Write(const char* pData, uint64_t size);
+
+			bool Close();//false if anything failed to be written
+
+		private:
+
+			static const uint32_t c_StreamBufferSize = 1024 * 1024;//small records are gathered
+
+			std::ofstream*	m_pArchiveFile;
+			std::vector<char> mStreamBuffer;
+			uint32_t			mChecksum;
+		};
+
+		//archive file is read in one pass, trailer is verified by Close
+		class /*_declspec(dllexport)*/ CArchiveReader
+		{
+		public:
+
+			CArchiveReader();
+
+			~CArchiveReader();
+
+			bool Open(NFilePath archivePath);
+
+			bool Read(char* pData, uint64_t size);//false if archive ends before
+
+			bool Close();//false if checksum doesn't match, or archive doesn't end with trailer
+
+		private:
+
+			std::ifstream*	m_pArchiveFile;
+			uint32_t			mChecksum;
+		};
+	}
+}
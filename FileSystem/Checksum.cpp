@@ -0,0 +1,148 @@
+/***********************************************************************
+
+									cppChecksum
+
+************************************************************************/
+
+#include "Noise3D.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define NOISE_CRC32C_X64
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define NOISE_TARGET_SSE42
+#else
+#define NOISE_TARGET_SSE42 __attribute__((target("sse4.2")))
+#endif
+#endif
+
+using namespace Noise3D::Core;
+
+static const uint32_t c_CRC32CPolynomial = 0x82f63b78;//(reflected)
+static const uint64_t c_StreamLength = 1360;//bytes per interleaved stream, 3 streams cover a checksum block
+
+struct N_CRC32CTables
+{
+	N_CRC32CTables()
+	{
+		for (uint32_t i = 0; i < 256; ++i)
+		{
+			uint32_t crc = i;
+			for (int bit = 0; bit < 8; ++bit)crc = (crc >> 1) ^ ((crc & 1) ? c_CRC32CPolynomial : 0);
+			slice[0][i] = crc;
+		}
+		for (uint32_t k = 1; k < 8; ++k)
+			for (uint32_t i = 0; i < 256; ++i)slice[k][i] = (slice[k - 1][i] >> 8) ^ slice[0][slice[k - 1][i] & 0xff];
+
+		//crc is linear : advancing it over zero bytes is computed once per bit, then combined per byte
+		uint32_t shiftedBits[32];
+		for (uint32_t bit = 0; bit < 32; ++bit)
+		{
+			uint32_t crc = uint32_t(1) << bit;
+			for (uint64_t i = 0; i < c_StreamLength; ++i)crc = slice[0][crc & 0xff] ^ (crc >> 8);
+			shiftedBits[bit] = crc;
+		}
+		for (uint32_t k = 0; k < 4; ++k)
+			for (uint32_t i = 0; i < 256; ++i)
+			{
+				shift[k][i] = 0;
+				for (uint32_t bit = 0; bit < 8; ++bit)if (i & (1 << bit))shift[k][i] ^= shiftedBits[k * 8 + bit];
+			}
+	}
+
+	uint32_t slice[8][256];//slicing-by-8
+	uint32_t shift[4][256];//crc advanced over c_StreamLength zero bytes, per byte of crc
+};
+
+static const N_CRC32CTables& GetCRC32CTables()
+{
+	static const N_CRC32CTables tables;
+	return tables;
+}
+
+static inline uint64_t Read64(const char* p)
+{
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+uint32_t CChecksum::CRC32C(const char * pData, uint64_t size, uint32_t crc)
+{
+	if (IsHardwareAccelerated())return ~mFunction_CRC32C_SSE42(pData, size, ~crc);
+	return ~mFunction_CRC32C_Table(pData, size, ~crc);
+}
+
+bool CChecksum::IsHardwareAccelerated()
+{
+	static const bool isSupported = []()
+	{
+#if defined(NOISE_CRC32C_X64) && defined(_MSC_VER)
+		//SSE4.2 : cpuid(1).ecx bit 20
+		int info[4] = { 0 };
+		__cpuid(info, 1);
+		return (info[2] & (1 << 20)) != 0;
+#elif defined(NOISE_CRC32C_X64)
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("sse4.2") != 0;
+#else
+		return false;
+#endif
+	}();
+	return isSupported;
+}
+
+/***********************************************************
+
+								P R I V A T E
+
+***********************************************************/
+
+uint32_t CChecksum::mFunction_CRC32C_Table(const char * pData, uint64_t size, uint32_t crc)
+{
+	const N_CRC32CTables& tables = GetCRC32CTables();
+	for (; size >= 8; size -= 8, pData += 8)
+	{
+		uint64_t v = Read64(pData) ^ crc;
+		crc = tables.slice[7][v & 0xff] ^ tables.slice[6][(v >> 8) & 0xff] ^ tables.slice[5][(v >> 16) & 0xff] ^ tables.slice[4][(v >> 24) & 0xff] ^
+			tables.slice[3][(v >> 32) & 0xff] ^ tables.slice[2][(v >> 40) & 0xff] ^ tables.slice[1][(v >> 48) & 0xff] ^ tables.slice[0][v >> 56];
+	}
+	for (; size > 0; --size, ++pData)crc = tables.slice[0][(crc ^ uint8_t(*pData)) & 0xff] ^ (crc >> 8);
+	return crc;
+}
+
+#ifdef NOISE_CRC32C_X64
+NOISE_TARGET_SSE42
+#endif
+uint32_t CChecksum::mFunction_CRC32C_SSE42(const char * pData, uint64_t size, uint32_t crc)
+{
+#ifdef NOISE_CRC32C_X64
+	const N_CRC32CTables& tables = GetCRC32CTables();
+	auto shift = [&tables](uint32_t c) {return tables.shift[0][c & 0xff] ^ tables.shift[1][(c >> 8) & 0xff] ^ tables.shift[2][(c >> 16) & 0xff] ^ tables.shift[3][c >> 24]; };
+
+	//3 independent streams hide the latency of crc32 instruction, then they are joined :
+	//crc(a|b) = crc(a) shifted over length of b, xor crc of b started from 0
+	while (size >= 3 * c_StreamLength)
+	{
+		uint64_t crc0 = crc, crc1 = 0, crc2 = 0;
+		for (uint64_t i = 0; i < c_StreamLength; i += 8)
+		{
+			crc0 = _mm_crc32_u64(crc0, Read64(pData + i));
+			crc1 = _mm_crc32_u64(crc1, Read64(pData + c_StreamLength + i));
+			crc2 = _mm_crc32_u64(crc2, Read64(pData + 2 * c_StreamLength + i));
+		}
+		crc = shift(shift(uint32_t(crc0)) ^ uint32_t(crc1)) ^ uint32_t(crc2);
+		pData += 3 * c_StreamLength;
+		size -= 3 * c_StreamLength;
+	}
+
+	uint64_t crc64 = crc;
+	for (; size >= 8; size -= 8, pData += 8)crc64 = _mm_crc32_u64(crc64, Read64(pData));
+	crc = uint32_t(crc64);
+	for (; size > 0; --size, ++pData)crc = _mm_crc32_u8(crc, uint8_t(*pData));
+	return crc;
+#else
+	return mFunction_CRC32C_Table(pData, size, crc);
+#endif
+}
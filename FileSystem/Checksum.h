@@ -0,0 +1,50 @@
+
+/***********************************************************************
+
+									hChecksum
+
+			Desc: CRC32C (Castagnoli) of virtual disk image. user space is
+			checksummed per block, the checksums are stored after user
+			space and are updated whenever the image is written
+			back, then verified when it is installed (and by scrubber).
+			SSE4.2 crc32 instruction is used when cpu supports it (three
+			interleaved streams per block), table driven otherwise.
+
+************************************************************************/
+
+#pragma once
+
+namespace Noise3D
+{
+	namespace Core
+	{
+		const uint32_t c_ChecksumBlockSize = 4096;//user space is checksummed per block of this size
+
+		//corruption found in an installed image (by install verification and scrubber)
+		struct N_ChecksumReport
+		{
+			N_ChecksumReport() :verifiedBytes(0), scrubPassCount(0), isIndexNodeTableCorrupted(false) {}
+
+			uint64_t verifiedBytes;
+			uint32_t scrubPassCount;//complete passes of scrubber over image file
+			bool isIndexNodeTableCorrupted;
+			std::vector<uint64_t> corruptedBlocks;//user space address of blocks that don't match their checksum
+		};
+
+		class /*_declspec(dllexport)*/ CChecksum
+		{
+		public:
+
+			//crc : CRC of preceding data, so that a checksum can be computed piece by piece
+			static uint32_t	CRC32C(const char* pData, uint64_t size, uint32_t crc = 0);
+
+			static bool			IsHardwareAccelerated();//SSE4.2 (detected once)
+
+		private:
+
+			static uint32_t	mFunction_CRC32C_Table(const char* pData, uint64_t size, uint32_t crc);//(crc is not inverted)
+
+			static uint32_t	mFunction_CRC32C_SSE42(const char* pData, uint64_t size, uint32_t crc);//(crc is not inverted)
+		};
+	}
+}
@@ -0,0 +1,197 @@
+/***********************************************************************
+
+									cppCompression
+
+************************************************************************/
+
+#include "Noise3D.h"
+
+using namespace Noise3D::Core;
+
+static const uint32_t c_MinMatch = 4;
+static const uint32_t c_LastLiterals = 5;//last bytes of a block are always literals
+static const uint32_t c_MatchFindLimit = 12;//no match starts in the last bytes of a block
+static const uint32_t c_MaxOffset = 65535;
+static const uint32_t c_HashLog = 12;
+
+static inline uint32_t Read32(const char* p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint32_t HashSequence(uint32_t sequence)
+{
+	return (sequence * 2654435761u) >> (32 - c_HashLog);
+}
+
+uint32_t CCompression::CompressLZ4(const char * pSrc, uint32_t srcSize, char * pDst, uint32_t dstCapacity)
+{
+	uint32_t op = 0;
+
+	//length above 15 continues in bytes of 255
+	auto writeLength = [&](uint32_t length) ->bool
+	{
+		for (; length >= 255; length -= 255)
+		{
+			if (op >= dstCapacity)return false;
+			pDst[op++] = char(255);
+		}
+		if (op >= dstCapacity)return false;
+		pDst[op++] = char(length);
+		return true;
+	};
+
+	//sequence : token | literal length | literals | offset | match length
+	auto writeSequence = [&](uint32_t literalStart, uint32_t literalLength, uint32_t offset, uint32_t matchLength) ->bool
+	{
+		if (op >= dstCapacity)return false;
+		uint32_t tokenPos = op++;
+		uint8_t token = uint8_t(std::min<uint32_t>(literalLength, 15) << 4);
+		if (literalLength >= 15 && !writeLength(literalLength - 15))return false;
+		if (literalLength > dstCapacity - op)return false;
+		memcpy(pDst + op, pSrc + literalStart, literalLength);
+		op += literalLength;
+
+		if (matchLength != 0)
+		{
+			if (dstCapacity - op < 2)return false;
+			pDst[op++] = char(offset & 0xff);
+			pDst[op++] = char(offset >> 8);
+			uint32_t matchCode = matchLength - c_MinMatch;
+			token |= uint8_t(std::min<uint32_t>(matchCode, 15));
+			if (matchCode >= 15 && !writeLength(matchCode - 15))return false;
+		}
+		pDst[tokenPos] = char(token);
+		return true;
+	};
+
+	//greedy matching on a hash table of recent positions (+1, 0 is empty)
+	std::vector<uint32_t> hashTable(size_t(1) << c_HashLog, 0);
+	uint32_t anchor = 0;
+	uint32_t ip = 0;
+	if (srcSize > c_MatchFindLimit)
+	{
+		uint32_t matchFindEnd = srcSize - c_MatchFindLimit;
+		uint32_t matchEnd = srcSize - c_LastLiterals;
+		while (ip < matchFindEnd)
+		{
+			uint32_t sequence = Read32(pSrc + ip);
+			uint32_t& slot = hashTable[HashSequence(sequence)];
+			uint32_t ref = slot;
+			slot = ip + 1;
+			if (ref == 0 || ip + 1 - ref > c_MaxOffset || Read32(pSrc + ref - 1) != sequence)
+			{
+				++ip;
+				continue;
+			}
+			--ref;
+
+			uint32_t matchLength = c_MinMatch;
+			while (ip + matchLength < matchEnd && pSrc[ref + matchLength] == pSrc[ip + matchLength])++matchLength;
+			if (!writeSequence(anchor, ip - anchor, ip - ref, matchLength))return 0;
+			ip += matchLength;
+			anchor = ip;
+		}
+	}
+
+	if (!writeSequence(anchor, srcSize - anchor, 0, 0))return 0;
+	return op;
+}
+
+bool CCompression::DecompressLZ4(const char * pSrc, uint32_t srcSize, char * pDst, uint32_t dstSize)
+{
+	const uint8_t* ip = reinterpret_cast<const uint8_t*>(pSrc);
+	const uint8_t* ipEnd = ip + srcSize;
+	uint32_t op = 0;
+
+	auto readLength = [&](uint32_t& length) ->bool
+	{
+		uint8_t b;
+		do
+		{
+			if (ip >= ipEnd)return false;
+			b = *ip++;
+			length += b;
+		} while (b == 255);
+		return true;
+	};
+
+	while (ip < ipEnd)
+	{
+		uint8_t token = *ip++;
+
+		uint32_t literalLength = token >> 4;
+		if (literalLength == 15 && !readLength(literalLength))return false;
+		if (literalLength > uint32_t(ipEnd - ip) || literalLength > dstSize - op)return false;
+		memcpy(pDst + op, ip, literalLength);
+		ip += literalLength;
+		op += literalLength;
+		if (ip == ipEnd)break;//last sequence has no match
+
+		if (ipEnd - ip < 2)return false;
+		uint32_t offset = uint32_t(ip[0]) | (uint32_t(ip[1]) << 8);
+		ip += 2;
+		uint32_t matchLength = token & 15;
+		if (matchLength == 15 && !readLength(matchLength))return false;
+		matchLength += c_MinMatch;
+		if (offset == 0 || offset > op || matchLength > dstSize - op)return false;
+
+		//(match may overlap its own output)
+		char* pMatch = pDst + op - offset;
+		if (offset >= matchLength)memcpy(pDst + op, pMatch, matchLength);
+		else for (uint32_t i = 0; i < matchLength; ++i)pDst[op + i] = pMatch[i];
+		op += matchLength;
+	}
+	return op == dstSize;
+}
+
+void CCompression::CompressChunks(const char * pData, uint64_t size, std::vector<char>& outExtent)
+{
+	uint32_t chunkCount = GetChunkCount(size);
+	uint64_t tableSize = 8 + uint64_t(chunkCount) * 8;
+	outExtent.assign(size_t(tableSize), 0);
+	memcpy(&outExtent.at(0), &chunkCount, sizeof(chunkCount));
+
+	std::vector<char> compressedChunk(c_CompressionChunkSize);
+	for (uint32_t i = 0; i < chunkCount; ++i)
+	{
+		uint64_t chunkStart = uint64_t(i) * c_CompressionChunkSize;
+		uint32_t chunkSize = uint32_t(std::min<uint64_t>(c_CompressionChunkSize, size - chunkStart));
+
+		//a chunk that doesn't shrink is stored raw
+		uint32_t compressedSize = CompressLZ4(pData + chunkStart, chunkSize, &compressedChunk.at(0), chunkSize - 1);
+		if (compressedSize == 0)outExtent.insert(outExtent.end(), pData + chunkStart, pData + chunkStart + chunkSize);
+		else outExtent.insert(outExtent.end(), compressedChunk.begin(), compressedChunk.begin() + compressedSize);
+
+		uint64_t chunkEnd = outExtent.size();
+		memcpy(&outExtent.at(size_t(8 + uint64_t(i) * 8)), &chunkEnd, sizeof(chunkEnd));
+	}
+}
+
+bool CCompression::DecompressChunk(const char * pExtent, uint64_t extentSize, uint64_t dataSize, uint32_t chunkIndex, char * pOutChunk)
+{
+	uint32_t chunkCount = GetChunkCount(dataSize);
+	uint64_t tableSize = 8 + uint64_t(chunkCount) * 8;
+	if (chunkIndex >= chunkCount || extentSize < tableSize)return false;
+
+	uint64_t chunkStart = tableSize, chunkEnd = 0;
+	if (chunkIndex > 0)memcpy(&chunkStart, pExtent + 8 + uint64_t(chunkIndex - 1) * 8, sizeof(chunkStart));
+	memcpy(&chunkEnd, pExtent + 8 + uint64_t(chunkIndex) * 8, sizeof(chunkEnd));
+	if (chunkStart > chunkEnd || chunkEnd > extentSize)return false;
+
+	uint32_t chunkSize = uint32_t(std::min<uint64_t>(c_CompressionChunkSize, dataSize - uint64_t(chunkIndex) * c_CompressionChunkSize));
+	uint64_t storedSize = chunkEnd - chunkStart;
+	if (storedSize == chunkSize)
+	{
+		memcpy(pOutChunk, pExtent + chunkStart, chunkSize);
+		return true;
+	}
+	return DecompressLZ4(pExtent + chunkStart, uint32_t(storedSize), pOutChunk, chunkSize);
+}
+
+uint32_t CCompression::GetChunkCount(uint64_t dataSize)
+{
+	return uint32_t((dataSize + c_CompressionChunkSize - 1) / c_CompressionChunkSize);
+}
@@ -0,0 +1,53 @@
+
+/***********************************************************************
+
+									hCompression
+
+			Desc: chunked LZ4 compression of file data. file data is cut
+			into fixed-size chunks that are compressed independently
+			(LZ4 block format), so that a read only decompresses the
+			chunks it touches. a compressed extent is laid out as :
+				chunkCount(4) | reserved(4) | chunkEnd(8) x chunkCount |
+				chunk data
+			(chunkEnd is relative to extent start. a chunk that doesn't
+			shrink is stored raw, told by its stored size)
+
+************************************************************************/
+
+#pragma once
+
+namespace Noise3D
+{
+	namespace Core
+	{
+		const uint32_t c_CompressionChunkSize = 65536;
+
+		const uint32_t c_DecompressedChunkCacheSize = 4;//chunks cached per opened file
+
+		//decompressed chunk cached by an opened compressed file
+		struct N_DecompressedChunk
+		{
+			uint32_t chunkIndex;
+			uint64_t lastUseTime;
+			std::vector<char> data;
+		};
+
+		class /*_declspec(dllexport)*/ CCompression
+		{
+		public:
+
+			//LZ4 block format. return compressed size, 0 if it doesn't fit in dstCapacity
+			static uint32_t	CompressLZ4(const char* pSrc, uint32_t srcSize, char* pDst, uint32_t dstCapacity);
+
+			//false if compressed data is broken or doesn't decompress to exactly dstSize bytes
+			static bool			DecompressLZ4(const char* pSrc, uint32_t srcSize, char* pDst, uint32_t dstSize);
+
+			static void			CompressChunks(const char* pData, uint64_t size, std::vector<char>& outExtent);
+
+			//chunk of a compressed extent (the last chunk may be shorter)
+			static bool			DecompressChunk(const char* pExtent, uint64_t extentSize, uint64_t dataSize, uint32_t chunkIndex, char* pOutChunk);
+
+			static uint32_t	GetChunkCount(uint64_t dataSize);
+		};
+	}
+}
@@ -0,0 +1,157 @@
+/***********************************************************************
+
+									cppDedup Index
+
+************************************************************************/
+
+#include "Noise3D.h"
+
+using namespace Noise3D::Core;
+
+static const uint64_t c_Prime64_1 = 11400714785074694791ull;
+static const uint64_t c_Prime64_2 = 14029467366897019727ull;
+static const uint64_t c_Prime64_3 = 1609587929392839161ull;
+static const uint64_t c_Prime64_4 = 9650029242287828579ull;
+static const uint64_t c_Prime64_5 = 2870177450012600261ull;
+
+static inline uint64_t RotateLeft(uint64_t v, int bits)
+{
+	return (v << bits) | (v >> (64 - bits));
+}
+
+static inline uint64_t Read64(const char* p)
+{
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint32_t Read32(const char* p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint64_t Round(uint64_t acc, uint64_t input)
+{
+	return RotateLeft(acc + input * c_Prime64_2, 31) * c_Prime64_1;
+}
+
+static inline uint64_t MergeRound(uint64_t acc, uint64_t val)
+{
+	return (acc ^ Round(0, val)) * c_Prime64_1 + c_Prime64_4;
+}
+
+CDedupIndex::CDedupIndex()
+{
+}
+
+uint64_t CDedupIndex::Hash(const char * pData, uint64_t size, uint64_t seed)
+{
+	const char* p = pData;
+	const char* pEnd = pData + size;
+	uint64_t h;
+
+	if (size >= 32)
+	{
+		//4 independent lanes of 8 bytes
+		uint64_t v1 = seed + c_Prime64_1 + c_Prime64_2;
+		uint64_t v2 = seed + c_Prime64_2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - c_Prime64_1;
+		const char* pLimit = pEnd - 32;
+		do
+		{
+			v1 = Round(v1, Read64(p));
+			v2 = Round(v2, Read64(p + 8));
+			v3 = Round(v3, Read64(p + 16));
+			v4 = Round(v4, Read64(p + 24));
+			p += 32;
+		} while (p <= pLimit);
+
+		h = RotateLeft(v1, 1) + RotateLeft(v2, 7) + RotateLeft(v3, 12) + RotateLeft(v4, 18);
+		h = MergeRound(h, v1);
+		h = MergeRound(h, v2);
+		h = MergeRound(h, v3);
+		h = MergeRound(h, v4);
+	}
+	else
+	{
+		h = seed + c_Prime64_5;
+	}
+	h += size;
+
+	//tail
+	for (; p + 8 <= pEnd; p += 8)h = RotateLeft(h ^ Round(0, Read64(p)), 27) * c_Prime64_1 + c_Prime64_4;
+	if (p + 4 <= pEnd)
+	{
+		h = RotateLeft(h ^ (uint64_t(Read32(p)) * c_Prime64_1), 23) * c_Prime64_2 + c_Prime64_3;
+		p += 4;
+	}
+	for (; p < pEnd; ++p)h = RotateLeft(h ^ (uint64_t(uint8_t(*p)) * c_Prime64_5), 11) * c_Prime64_1;
+
+	//avalanche
+	h ^= h >> 33;
+	h *= c_Prime64_2;
+	h ^= h >> 29;
+	h *= c_Prime64_3;
+	h ^= h >> 32;
+	return h;
+}
+
+void CDedupIndex::Clear()
+{
+	mFingerprints.clear();
+	mFiles.clear();
+}
+
+void CDedupIndex::Insert(uint32_t indexNodeId, uint64_t fingerprint)
+{
+	Erase(indexNodeId);
+	mFingerprints[indexNodeId] = fingerprint;
+	mFiles.insert(std::make_pair(fingerprint, indexNodeId));
+}
+
+void CDedupIndex::Erase(uint32_t indexNodeId)
+{
+	auto iter = mFingerprints.find(indexNodeId);
+	if (iter == mFingerprints.end())return;
+
+	auto range = mFiles.equal_range(iter->second);
+	for (auto fileIter = range.first; fileIter != range.second; ++fileIter)
+	{
+		if (fileIter->second != indexNodeId)continue;
+		mFiles.erase(fileIter);
+		break;
+	}
+	mFingerprints.erase(iter);
+}
+
+bool CDedupIndex::GetFingerprint(uint32_t indexNodeId, uint64_t & outFingerprint)
+{
+	auto iter = mFingerprints.find(indexNodeId);
+	if (iter == mFingerprints.end())return false;
+	outFingerprint = iter->second;
+	return true;
+}
+
+void CDedupIndex::GetCandidates(uint64_t fingerprint, std::vector<uint32_t>& outIndexNodes)
+{
+	outIndexNodes.clear();
+	auto range = mFiles.equal_range(fingerprint);
+	for (auto iter = range.first; iter != range.second; ++iter)outIndexNodes.push_back(iter->second);
+}
+
+void CDedupIndex::AddToReport(const N_DedupReport & report)
+{
+	mReport.scannedFileCount += report.scannedFileCount;
+	mReport.hashedBytes += report.hashedBytes;
+	mReport.dedupedFileCount += report.dedupedFileCount;
+	mReport.savedBytes += report.savedBytes;
+}
+
+const N_DedupReport & CDedupIndex::GetReport()
+{
+	return mReport;
+}
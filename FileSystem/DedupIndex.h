@@ -0,0 +1,61 @@
+
+/***********************************************************************
+
+									hDedup Index
+
+			Desc: fingerprint index of file contents for deduplication.
+			a fingerprint is the 64-bit xxHash (XXH64) of the whole file
+			data. files with equal fingerprint are only candidates, the
+			data is compared before IFileSystem lets a file share the
+			extent of another one (refcounted extents, see CloneFile).
+			files are (re-)fingerprinted when they are closed, or all at
+			once by IFileSystem::DeduplicateFiles.
+
+************************************************************************/
+
+#pragma once
+
+namespace Noise3D
+{
+	namespace Core
+	{
+		struct N_DedupReport
+		{
+			N_DedupReport() :scannedFileCount(0), hashedBytes(0), dedupedFileCount(0), savedBytes(0) {}
+
+			uint32_t scannedFileCount;//files fingerprinted
+			uint64_t hashedBytes;
+			uint32_t dedupedFileCount;//files that now share the extent of an identical file
+			uint64_t savedBytes;//user space given back to allocator
+		};
+
+		class /*_declspec(dllexport)*/ CDedupIndex
+		{
+		public:
+
+			CDedupIndex();
+
+			static uint64_t	Hash(const char* pData, uint64_t size, uint64_t seed = 0);//XXH64
+
+			void		Clear();
+
+			void		Insert(uint32_t indexNodeId, uint64_t fingerprint);//(re-inserting a file updates it)
+
+			void		Erase(uint32_t indexNodeId);//no effect if the i-node isn't indexed
+
+			bool		GetFingerprint(uint32_t indexNodeId, uint64_t& outFingerprint);
+
+			void		GetCandidates(uint64_t fingerprint, std::vector<uint32_t>& outIndexNodes);
+
+			void		AddToReport(const N_DedupReport& report);
+
+			const N_DedupReport& GetReport();//accumulated since the index was created
+
+		private:
+
+			std::unordered_map<uint32_t, uint64_t> mFingerprints;//by i-node
+			std::unordered_multimap<uint64_t, uint32_t> mFiles;//by fingerprint
+			N_DedupReport mReport;
+		};
+	}
+}
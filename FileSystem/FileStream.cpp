@@ -0,0 +1,178 @@
+/***********************************************************************
+
+									cppFile Stream
+
+************************************************************************/
+
+#include "Noise3D.h"
+
+using namespace Noise3D::Core;
+
+const uint64_t CFileReadStream::c_MaxReadAheadSize;//(bound to const& by std::min)
+const uint64_t CFileWriteStream::c_MaxGrowAheadSize;
+
+CFileReadStream::CFileReadStream(IFile * pFile, uint64_t startOffset) :
+	m_pFile(pFile),
+	mCursor(startOffset),
+	mSequentialReadCount(0),
+	mReadAheadEnd(startOffset),
+	mReadAheadSize(0)
+{
+}
+
+uint64_t CFileReadStream::Read(char * pOutData, uint64_t size)
+{
+	uint64_t fileSize = m_pFile->GetFileSize();
+	if (mCursor >= fileSize || size == 0)return 0;
+
+	size = std::min(size, fileSize - mCursor);
+	mFunction_ReadAhead(size);
+	m_pFile->Read(pOutData, mCursor, size);
+	mCursor += size;
+	++mSequentialReadCount;
+	return size;
+}
+
+void CFileReadStream::Seek(uint64_t offset)
+{
+	if (offset == mCursor)return;
+	mCursor = offset;
+	mSequentialReadCount = 0;
+	mReadAheadEnd = offset;
+	mReadAheadSize = 0;
+}
+
+uint64_t CFileReadStream::Tell() const
+{
+	return mCursor;
+}
+
+bool CFileReadStream::IsEnd()
+{
+	return mCursor >= m_pFile->GetFileSize();
+}
+
+/***********************************************************
+
+								P R I V A T E
+
+***********************************************************/
+
+void CFileReadStream::mFunction_ReadAhead(uint64_t readSize)
+{
+	//the first read after a seek may be a random one, nothing is read ahead for it
+	if (mSequentialReadCount == 0)return;
+
+	//window is issued again when the read gets within half a window of its end, so
+	//that the next window is on its way while this one is consumed
+	uint64_t fileSize = m_pFile->GetFileSize();
+	uint64_t readEnd = mCursor + readSize;
+	mReadAheadEnd = std::max(mReadAheadEnd, mCursor);
+	while (mReadAheadEnd < fileSize && mReadAheadEnd < readEnd + mReadAheadSize / 2)
+	{
+		mReadAheadSize = (mReadAheadSize == 0) ? c_MinReadAheadSize : std::min(mReadAheadSize * 2, c_MaxReadAheadSize);
+		uint64_t prefetchSize = std::min(mReadAheadSize, fileSize - mReadAheadEnd);
+		m_pFile->Prefetch(mReadAheadEnd, prefetchSize);
+		mReadAheadEnd += prefetchSize;
+	}
+}
+
+/***********************************************************
+
+								WRITE STREAM
+
+***********************************************************/
+
+CFileWriteStream::CFileWriteStream(IFile * pFile, uint64_t startOffset) :
+	m_pFile(pFile),
+	mCursor(startOffset),
+	mDataEnd(pFile->GetFileSize())
+{
+	mBuffer.reserve(size_t(c_WriteBehindSize));
+}
+
+CFileWriteStream::~CFileWriteStream()
+{
+	Flush();
+}
+
+bool CFileWriteStream::Write(const char * pData, uint64_t size)
+{
+	//small writes are gathered till buffer is full
+	if (mBuffer.size() + size < c_WriteBehindSize)
+	{
+		mBuffer.insert(mBuffer.end(), pData, pData + size);
+		mCursor += size;
+		return true;
+	}
+
+	//buffered bytes go first, then a large write goes straight to file
+	if (!mFunction_WriteBuffer())return false;
+	if (size >= c_WriteBehindSize)
+	{
+		if (!mFunction_WriteToFile(pData, mCursor, size))return false;
+		mCursor += size;
+		return true;
+	}
+	mBuffer.insert(mBuffer.end(), pData, pData + size);
+	mCursor += size;
+	return true;
+}
+
+bool CFileWriteStream::Flush()
+{
+	bool isSucceeded = mFunction_WriteBuffer();
+	if (m_pFile->GetFileSize() > mDataEnd)isSucceeded = m_pFile->Resize(mDataEnd) && isSucceeded;
+	return isSucceeded;
+}
+
+bool CFileWriteStream::Seek(uint64_t offset)
+{
+	bool isSucceeded = Flush();
+	mCursor = offset;
+	return isSucceeded;
+}
+
+uint64_t CFileWriteStream::Tell() const
+{
+	return mCursor;
+}
+
+/***********************************************************
+
+								P R I V A T E
+
+***********************************************************/
+
+bool CFileWriteStream::mFunction_WriteBuffer()
+{
+	if (mBuffer.empty())return true;
+
+	//(bytes that can't be written are dropped)
+	uint64_t bufferStart = mCursor - mBuffer.size();
+	bool isSucceeded = mFunction_WriteToFile(&mBuffer.at(0), bufferStart, mBuffer.size());
+	if (!isSucceeded)mCursor = bufferStart;
+	mBuffer.clear();
+	return isSucceeded;
+}
+
+bool CFileWriteStream::mFunction_WriteToFile(const char * pData, uint64_t startIndex, uint64_t size)
+{
+	//file is grown ahead of the cursor, so that a stream of appends doesn't move the extent every time
+	uint64_t endIndex = startIndex + size;
+	uint64_t fileSize = m_pFile->GetFileSize();
+	if (endIndex > fileSize)
+	{
+		uint64_t grownSize = std::max(endIndex, fileSize + std::min(fileSize / 2, c_MaxGrowAheadSize));
+		if (!m_pFile->Resize(grownSize) && !m_pFile->Resize(endIndex))
+		{
+			ERROR_MSG("FileWriteStream : write failure! file can't be grown.");
+			return false;
+		}
+	}
+
+	//(no write access, or a shared extent can't be copied : data end doesn't move)
+	if (!m_pFile->Write(const_cast<char*>(pData), startIndex, size))return false;
+	mDataEnd = std::max(mDataEnd, endIndex);
+	return true;
+}
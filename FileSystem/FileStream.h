@@ -0,0 +1,84 @@
+/***********************************************************************
+
+									hFile Stream
+
+			Desc: sequential reader / writer over an opened IFile, with
+			a cursor of their own. reader tells sequential access from
+			random one and reads ahead of the cursor (the window doubles
+			up to 4MB, Seek starts over), so that pages of a mapped image
+			are fetched before they are touched. writer gathers small
+			writes into 64KB writes (write-behind) and grows the file as
+			the cursor passes its end.
+
+************************************************************************/
+
+#pragma once
+
+namespace Noise3D
+{
+	namespace Core
+	{
+		class /*_declspec(dllexport)*/ CFileReadStream
+		{
+		public:
+
+			CFileReadStream(IFile* pFile, uint64_t startOffset = 0);
+
+			uint64_t	Read(char* pOutData, uint64_t size);//bytes read (less than size at the end of file)
+
+			void			Seek(uint64_t offset);
+
+			uint64_t	Tell() const;
+
+			bool			IsEnd();
+
+			static const uint64_t c_MinReadAheadSize = 128 * 1024;
+			static const uint64_t c_MaxReadAheadSize = 4 * 1024 * 1024;
+
+		private:
+
+			void			mFunction_ReadAhead(uint64_t readSize);
+
+			IFile* m_pFile;
+			uint64_t mCursor;
+			uint64_t mSequentialReadCount;//reads since construction or Seek
+			uint64_t mReadAheadEnd;//bytes before it are prefetched already
+			uint64_t mReadAheadSize;//window of last read ahead
+		};
+
+		//buffered bytes are written when buffer is full, on Flush/Seek and on destruction, so the
+		//stream must be flushed or destroyed before its file is closed
+		class /*_declspec(dllexport)*/ CFileWriteStream
+		{
+		public:
+
+			CFileWriteStream(IFile* pFile, uint64_t startOffset = 0);
+
+			~CFileWriteStream();
+
+			bool			Write(const char* pData, uint64_t size);//false if file can't be grown or written
+
+			//buffered bytes are written, and file is cut to the last byte written (it's grown
+			//ahead of the cursor by a half of its size, so that growing is amortized)
+			bool			Flush();
+
+			bool			Seek(uint64_t offset);//(flushed first)
+
+			uint64_t	Tell() const;
+
+			static const uint64_t c_WriteBehindSize = 64 * 1024;
+			static const uint64_t c_MaxGrowAheadSize = 64 * 1024 * 1024;
+
+		private:
+
+			bool			mFunction_WriteBuffer();
+
+			bool			mFunction_WriteToFile(const char* pData, uint64_t startIndex, uint64_t size);//grown if needed
+
+			IFile* m_pFile;
+			uint64_t mCursor;//buffered bytes lie right before it
+			std::vector<char> mBuffer;
+			uint64_t mDataEnd;//file size as written through stream (file may be grown ahead of it)
+		};
+	}
+}
@@ -19,21 +19,56 @@ IFile::IFile() :
 	mAccessMode_Write(false),
 	mFileIndexNodeNumber(0xffffffff),
 	mFileSize(0),
-	m_pFileBuffer(nullptr)
+	m_pFileBuffer(nullptr),
+	m_pChunkCache(nullptr),
+	mChunkUseTime(0),
+	m_pFileSystem(nullptr),
+	m_pTraceRecorder(nullptr),
+	mTraceFileHandle(0)
 {
 
 }
 
 IFile::~IFile()
 {
+	if (m_pChunkCache != nullptr)delete m_pChunkCache;
 }
 
-UINT IFile::GetFileSize()
+uint64_t IFile::GetFileSize()
 {
 	return mFileSize;
 }
 
-void IFile::Read(char* pOutData, uint32_t startIndex, uint32_t size)
+void IFile::Read(char* pOutData, uint64_t startIndex, uint64_t size)
+{
+	CTraceScope trace(m_pTraceRecorder, NOISE_TRACE_OP_FILE_READ, "", startIndex, size, mTraceFileHandle);
+	mFunction_Read(pOutData, startIndex, size);
+}
+
+bool IFile::Write(char * pSrcData, uint64_t startIndex, uint64_t size)
+{
+	CTraceScope trace(m_pTraceRecorder, NOISE_TRACE_OP_FILE_WRITE, "", startIndex, size, mTraceFileHandle);
+	return trace.Result(mFunction_Write(pSrcData, startIndex, size));
+}
+
+bool IFile::Resize(uint64_t newSize)
+{
+	CTraceScope trace(m_pTraceRecorder, NOISE_TRACE_OP_FILE_RESIZE, "", newSize, 0, mTraceFileHandle);
+	if (!mIsFileOpened || m_pFileSystem == nullptr)
+	{
+		ERROR_MSG("IFile : 'Resize' failure! File is not opened!");
+		return trace.Result(false);
+	}
+	return trace.Result(m_pFileSystem->mFunction_ResizeFile(this, newSize));
+}
+
+void IFile::Prefetch(uint64_t startIndex, uint64_t size)
+{
+	if (!mIsFileOpened || m_pFileSystem == nullptr || startIndex >= mFileSize)return;
+	m_pFileSystem->mFunction_PrefetchFile(this, startIndex, std::min(size, mFileSize - startIndex));
+}
+
+void IFile::mFunction_Read(char* pOutData, uint64_t startIndex, uint64_t size)
 {
 	if (!mAccessMode_Read)
 	{
@@ -47,11 +82,18 @@ void IFile::Read(char* pOutData, uint32_t startIndex, uint32_t size)
 		return;
 	}
 
-	if (startIndex + size <= mFileSize)
+	if (startIndex <= mFileSize && size <= mFileSize - startIndex)
 	{
-		uint32_t remainSize = size - startIndex;
+		//compressed file : only touched chunks are decompressed
+		if (m_pChunkCache != nullptr)
+		{
+			if (!m_pFileSystem->mFunction_ReadCompressedFile(this, pOutData, startIndex, size))
+				ERROR_MSG("IFile : 'Read' failure! compressed data is broken, run fsck.");
+			return;
+		}
+
 		//copy 
-		memcpy_s(pOutData, remainSize, m_pFileBuffer + startIndex, remainSize);
+		memcpy_s(pOutData, size_t(size), m_pFileBuffer + startIndex, size_t(size));
 	}
 	else
 	{
@@ -59,29 +101,37 @@ void IFile::Read(char* pOutData, uint32_t startIndex, uint32_t size)
 	}
 }
 
-void IFile::Write(char * pSrcData, uint32_t startIndex, uint32_t size)
+bool IFile::mFunction_Write(char * pSrcData, uint64_t startIndex, uint64_t size)
 {
-	if (!mAccessMode_Read)
+	if (!mAccessMode_Write)
 	{
 		ERROR_MSG("IFile : 'Write' failure! No Authorization to write!");
-		return;
+		return false;
 	}//not allow to 
 
 	if (!mIsFileOpened)
 	{
 		ERROR_MSG("IFile : 'Write' failure! File is not opened!");
-		return;
+		return false;
 	}
 
-	if (startIndex + size <= mFileSize)
+	if (startIndex <= mFileSize && size <= mFileSize - startIndex)
 	{
-		uint32_t remainSize = size - startIndex;
+		//a cloned extent is copied before its first write
+		if (!m_pFileSystem->mFunction_PrepareFileWrite(this, startIndex, size))
+		{
+			ERROR_MSG("IFile : 'Write' failure! Not Enough space to copy shared data.");
+			return false;
+		}
+
 		//copy 
-		memcpy_s(m_pFileBuffer+startIndex, remainSize, pSrcData, remainSize);
+		memcpy_s(m_pFileBuffer+startIndex, size_t(size), pSrcData, size_t(size));
+		return true;
 	}
 	else
 	{
 		ERROR_MSG("IFile : 'Write' failure! Index out of boundary!");
+		return false;
 	}
 }
 
@@ -96,17 +146,31 @@ void IFile::Write(char * pSrcData, uint32_t startIndex, uint32_t size)
 IFileSystem::IFileSystem() :
 	IFactory<IFile>(131072),
 	m_pVirtualDiskFile(nullptr),
-	m_pFileAddressAllocator(nullptr),
-	m_pIndexNodeAllocator(nullptr),
 	m_pVirtualDiskImage(nullptr),
 	m_pIndexNodeList(nullptr),
-	m_pCurrentDirIndexNode(nullptr),
-	m_pCurrentWorkingDir(new std::string("")),
-	mIsVDiskInitialized(false),
-	mLoggedInAccountID(0xff),
+	m_pFreedRangeList(new std::vector<N_AddressRange>),
+	m_pWrittenBackFreeSegments(new std::vector<N_AddressRange>),
+	m_pVirtualDiskImagePath(new NFilePath),
 	mVDiskImageSize(0),
 	mVDiskCapacity(0),
-	mVDiskHeaderLength(0)
+	mVDiskHeaderLength(0),
+	mVDiskBlockSize(1),
+	m_pIndexNodeAllocator(nullptr),
+	m_pFileAddressAllocator(nullptr),
+	mIsVDiskInitialized(false),
+	mIsImageFileStale(false),
+	mIsFreedRangeListOverflowed(false),
+	mIsVDiskReadOnly(false),
+	mHostFileLockHandle(CHostFile::c_InvalidLockHandle),
+	mLoggedInAccountID(0xff),
+	m_pCurrentDirIndexNode(nullptr),
+	m_pCurrentWorkingDir(new std::string("")),
+	m_pTraceRecorder(nullptr),
+	m_pMetadataIndex(nullptr),
+	m_pSnapshot(nullptr),
+	m_pDedupIndex(nullptr),
+	m_pScrubber(nullptr),
+	m_pChecksumReport(new N_ChecksumReport)
 {
 }
 
@@ -114,52 +178,89 @@ IFileSystem::~IFileSystem()
 {
 #define deletePtr(ptr) if(ptr!=nullptr)delete ptr;
 	//if (mIsVDiskInitialized)UninstallVirtualDisk();
+	deletePtr(m_pScrubber);
 	deletePtr(m_pFileAddressAllocator);
 	deletePtr(m_pIndexNodeAllocator);
 	deletePtr(m_pIndexNodeList);
 	deletePtr(m_pCurrentWorkingDir);
+	deletePtr(m_pFreedRangeList);
+	deletePtr(m_pWrittenBackFreeSegments);
+	deletePtr(m_pVirtualDiskImagePath);
 	deletePtr(m_pVirtualDiskImage);
+	deletePtr(m_pTraceRecorder);
+	deletePtr(m_pMetadataIndex);
+	deletePtr(m_pSnapshot);
+	deletePtr(m_pDedupIndex);
+	deletePtr(m_pChecksumReport);
 }
 
 bool IFileSystem::CreateVirtualDisk(NFilePath filePath, NOISE_VIRTUAL_DISK_CAPACITY cap)
 {
-	DEBUG_MSG("********************************");
-	DEBUG_MSG("Creating Virtual Disk.....");
-
-	std::ofstream outFile(filePath.c_str(),std::ios::binary);
-	if (!outFile.is_open())
-	{
-		ERROR_MSG("FileSystem: Create virtual disk failed! file cannot be created.");
-		return false;
-	}
-
 	//select Virtual Disk capacity
-	N_VirtualDiskHeaderInfo headerInfo;
+	N_VirtualDiskFormatOptions options;
 	switch (cap)
 	{
 	default:
 	case NOISE_VIRTUAL_DISK_CAPACITY_128MB:
-		headerInfo.diskCapacity = 128 * 1024 * 1024;
-		headerInfo.indexNodeCount = 16384;
+		options.capacity = 128ull * 1024 * 1024;
+		options.indexNodeCount = 16384;
 		break;
 	case NOISE_VIRTUAL_DISK_CAPACITY_256MB:
-		headerInfo.diskCapacity = 256 * 1024 * 1024;
-		headerInfo.indexNodeCount = 32768;
+		options.capacity = 256ull * 1024 * 1024;
+		options.indexNodeCount = 32768;
 		break;
 	case NOISE_VIRTUAL_DISK_CAPACITY_512MB:
-		headerInfo.diskCapacity = 512 * 1024 * 1024;
-		headerInfo.indexNodeCount = 65536;
+		options.capacity = 512ull * 1024 * 1024;
+		options.indexNodeCount = 65536;
 		break;
 	case NOISE_VIRTUAL_DISK_CAPACITY_1GB:
-		headerInfo.diskCapacity = 1024 * 1024 * 1024;
-		headerInfo.indexNodeCount = 131072;
+		options.capacity = 1024ull * 1024 * 1024;
+		options.indexNodeCount = 131072;
 		break;
 	}
-	//disk header length (size of inode table included)
-	headerInfo.diskHeaderLength = sizeof(N_VirtualDiskHeaderInfo) + headerInfo.indexNodeCount * sizeof(N_IndexNode);
+	return CreateVirtualDisk(filePath, options);
+}
 
-	//header info
-	outFile.write((char*)&headerInfo, sizeof(headerInfo));
+bool IFileSystem::CreateVirtualDisk(NFilePath filePath, const N_VirtualDiskFormatOptions & options)
+{
+	DEBUG_MSG("********************************");
+	DEBUG_MSG("Creating Virtual Disk.....");
+
+	//block size must be a power of 2, and root dir file must fit in
+	if (options.blockSize == 0 || (options.blockSize & (options.blockSize - 1)) != 0)
+	{
+		ERROR_MSG("FileSystem: Create virtual disk failed! block size must be a power of 2.");
+		return false;
+	}
+
+	N_VirtualDiskHeaderInfo headerInfo;
+	headerInfo.blockSize = options.blockSize;
+	//capacity is rounded down to whole blocks
+	headerInfo.diskCapacity = options.capacity & ~uint64_t(options.blockSize - 1);
+	headerInfo.indexNodeCount = options.indexNodeCount;
+	if (headerInfo.indexNodeCount == 0)
+	{
+		//one i-node per 8KB of file space by default
+		uint64_t defaultCount = headerInfo.diskCapacity / 8192;
+		headerInfo.indexNodeCount = uint32_t(defaultCount > 0xfffffffe ? 0xfffffffe : (defaultCount < 16 ? 16 : defaultCount));
+	}
+
+	if (headerInfo.diskCapacity < headerInfo.blockSize || headerInfo.diskCapacity < 8)
+	{
+		ERROR_MSG("FileSystem: Create virtual disk failed! capacity is too small.");
+		return false;
+	}
+
+	std::ofstream outFile(filePath.c_str(),std::ios::binary);
+	if (!outFile.is_open())
+	{
+		ERROR_MSG("FileSystem: Create virtual disk failed! file cannot be created.");
+		return false;
+	}
+
+	//disk header length (size of inode table included)
+	headerInfo.diskHeaderLength = mFunction_GetHeaderLength(headerInfo.indexNodeCount);
+	headerInfo.checksumBlockSize = c_ChecksumBlockSize;
 
 	//Create root directory (index-node 0)
 	N_IndexNode rootDirIndexNode;
@@ -167,23 +268,47 @@ bool IFileSystem::CreateVirtualDisk(NFilePath filePath, NOISE_VIRTUAL_DISK_CAPAC
 	rootDirIndexNode.address = 0;//USER FILE ADDRESS SPACE
 	rootDirIndexNode.size =8;
 	rootDirIndexNode.ownerUserID = NOISE_FILE_OWNER_ROOT;
-	outFile.write((char*)&rootDirIndexNode, sizeof(rootDirIndexNode));
+
+	//checksums of i-node table (root i-node, then zero) and of the only allocated block (root dir file, zero)
+	std::vector<char> zeroBlock(c_ChecksumBlockSize, 0);
+	headerInfo.indexNodeTableChecksum = CChecksum::CRC32C((char*)&rootDirIndexNode, sizeof(rootDirIndexNode));
+	for (uint64_t leftBytes = uint64_t(headerInfo.indexNodeCount - 1) * sizeof(N_IndexNode); leftBytes > 0;)
+	{
+		uint64_t byteCount = std::min<uint64_t>(leftBytes, zeroBlock.size());
+		headerInfo.indexNodeTableChecksum = CChecksum::CRC32C(&zeroBlock.at(0), byteCount, headerInfo.indexNodeTableChecksum);
+		leftBytes -= byteCount;
+	}
+	uint32_t rootBlockChecksum = CChecksum::CRC32C(&zeroBlock.at(0), std::min<uint64_t>(c_ChecksumBlockSize, headerInfo.diskCapacity));
 
 	//i-node table (except the Root i-node 0) and other part can be initialized as 0
-	//std::vector<char> emptyBuffer(headerInfo.diskCapacity - sizeof(headerInfo) - sizeof(N_IndexNode), 0);
 	//(2017.7.27)capacity only indicates file space, not including index node table
-	std::vector<char> emptyBuffer((headerInfo.indexNodeCount-1) *sizeof(N_IndexNode) +  headerInfo.diskCapacity);
-	outFile.write((char*)&emptyBuffer[0], emptyBuffer.size());
+	//(the rest of the image is zero-filled by extending the file instead of writing a
+	//zero buffer, which makes multi-GB images cheap to create on sparse file systems)
+	uint64_t checksumAreaOffset = headerInfo.diskHeaderLength + headerInfo.diskCapacity;
+	outFile.seekp(std::streamoff(checksumAreaOffset + mFunction_GetChecksumAreaSize(headerInfo.diskCapacity) - 1));
+	outFile.put(0);
+
+	//header info, then checksum of the first block (behind user space)
+	outFile.seekp(0);
+	outFile.write((char*)&headerInfo, sizeof(headerInfo));
+	outFile.write((char*)&rootDirIndexNode, sizeof(rootDirIndexNode));
+	outFile.seekp(std::streamoff(checksumAreaOffset));
+	outFile.write((char*)&rootBlockChecksum, sizeof(rootBlockChecksum));
 
+	if (!outFile.good())
+	{
+		ERROR_MSG("FileSystem: Create virtual disk failed! image can't be written.");
+		return false;
+	}
 	outFile.close();
 
 	return true;
 }
 
-bool IFileSystem::InstallVirtualDisk(NFilePath virtualDiskImagePath)
+bool IFileSystem::InstallVirtualDisk(NFilePath virtualDiskImagePath, bool isReadOnly)
 {
 	DEBUG_MSG("********************************");
-	DEBUG_MSG("Installing Virtual Disk....");
+	DEBUG_MSG("Installing Virtual Disk...." << (isReadOnly ? "(read-only)" : ""));
 
 	if (mIsVDiskInitialized)
 	{
@@ -191,26 +316,62 @@ bool IFileSystem::InstallVirtualDisk(NFilePath virtualDiskImagePath)
 		return false;
 	}
 
-	m_pVirtualDiskFile = new std::fstream(virtualDiskImagePath, std::ios::binary | std::ios::in | std::ios::out);
+	//one writer, or any count of read-only installs (in any process)
+	if (!CHostFile::LockFile(virtualDiskImagePath, !isReadOnly, mHostFileLockHandle))
+	{
+		ERROR_MSG("Install Virtual Disk failure: virtual disk image is " << (isReadOnly ? "installed for writing" : "in use") << " somewhere else !");
+		return false;
+	}
+
+	mIsVDiskReadOnly = isReadOnly;
+	if (mFunction_InstallVirtualDisk(virtualDiskImagePath))return true;
+
+	//half installed state is dropped
+	if (m_pVirtualDiskFile != nullptr)delete m_pVirtualDiskFile;
+	if (m_pVirtualDiskImage != nullptr)delete m_pVirtualDiskImage;
+	m_pVirtualDiskFile = nullptr;
+	m_pVirtualDiskImage = nullptr;
+	CHostFile::UnlockFile(mHostFileLockHandle);
+	mHostFileLockHandle = CHostFile::c_InvalidLockHandle;
+	mIsVDiskReadOnly = false;
+	return false;
+}
+
+bool IFileSystem::mFunction_InstallVirtualDisk(const NFilePath& virtualDiskImagePath)
+{
+	std::ios::openmode openMode = mIsVDiskReadOnly ? (std::ios::binary | std::ios::in) : (std::ios::binary | std::ios::in | std::ios::out);
+	m_pVirtualDiskFile = new std::fstream(virtualDiskImagePath, openMode);
 	if (m_pVirtualDiskFile == nullptr || m_pVirtualDiskFile->is_open() == false)
 	{
 		ERROR_MSG("Install Virtual Disk failure: virtual disk image open failed !");
 		return false;
 	}
 
+	*m_pVirtualDiskImagePath = virtualDiskImagePath;
+	m_pFreedRangeList->clear();
+	mIsFreedRangeListOverflowed = false;
+
 	//load the whole file into memory
 	m_pVirtualDiskFile->seekg(0, std::ios::end);
-	uint32_t fileSize = uint32_t(m_pVirtualDiskFile->tellg());
-	if (fileSize<20)
+	uint64_t fileSize = uint64_t(m_pVirtualDiskFile->tellg());
+	if (fileSize<sizeof(N_VirtualDiskHeaderInfo))
 	{
 		ERROR_MSG("Install Virtual Disk failure: corrupted Virtual disk image!");
 		return false;
 	}
 
 
+	//(chunks are read by several threads with positional I/O, through fstream if that fails).
+	//a read-only install maps the file instead, pages are shared in host page cache
 	m_pVirtualDiskFile->seekg(0);
-	m_pVirtualDiskImage= new std::vector<char>(fileSize);
-	m_pVirtualDiskFile->read((char*)&m_pVirtualDiskImage->at(0), fileSize);
+	m_pVirtualDiskImage = mIsVDiskReadOnly ? new CImageBuffer(virtualDiskImagePath, fileSize) : new CImageBuffer(fileSize);
+	if (!m_pVirtualDiskImage->IsValid())
+	{
+		ERROR_MSG("Install Virtual Disk failure: " << (mIsVDiskReadOnly ? "virtual disk image can't be mapped!" : "not enough memory for virtual disk image!"));
+		return false;
+	}
+	if (!mIsVDiskReadOnly && !CHostFile::ParallelRead(virtualDiskImagePath, &m_pVirtualDiskImage->at(0), std::vector<N_AddressRange>(1, N_AddressRange(0, fileSize))))
+		m_pVirtualDiskFile->read((char*)&m_pVirtualDiskImage->at(0), std::streamsize(fileSize));
 
 	//init the header
 	N_VirtualDiskHeaderInfo headerInfo;
@@ -237,23 +398,27 @@ bool IFileSystem::InstallVirtualDisk(NFilePath virtualDiskImagePath)
 	//(header and i-node table are skipped)
 	mVDiskHeaderLength = headerInfo.diskHeaderLength;
 
-	if (fileSize != mVDiskHeaderLength + mVDiskCapacity)
+	//allocation granularity of user file space
+	mVDiskBlockSize = headerInfo.blockSize;
+
+	//(there is at least the i-node of root directory)
+	if (mVDiskBlockSize == 0 || (mVDiskBlockSize & (mVDiskBlockSize - 1)) != 0 || headerInfo.checksumBlockSize != c_ChecksumBlockSize ||
+		headerInfo.indexNodeCount == 0 || mVDiskHeaderLength != mFunction_GetHeaderLength(headerInfo.indexNodeCount) ||
+		fileSize < mVDiskHeaderLength + mVDiskCapacity + mFunction_GetChecksumAreaSize(mVDiskCapacity))
 	{
 		//simple error check about the data size
 		ERROR_MSG("Install Virtual Disk failure: corrupted Virtual disk image!");
 		return false;
 	}
 
-	//init the i-node table
+	//(a longer file is left by a grow that was interrupted before its header was written, the
+	//tail is cut when the image is written back)
+	mVDiskImageSize = mVDiskHeaderLength + mVDiskCapacity + mFunction_GetChecksumAreaSize(mVDiskCapacity);
+
+	//init the i-node table (copied in one pass)
 	uint32_t inodeCount = headerInfo.indexNodeCount;
 	m_pIndexNodeList = new std::vector<N_IndexNode>(inodeCount);
-	for (uint32_t i = 0; i < inodeCount; ++i)
-	{
-		mFunction_ReadData(sizeof(N_VirtualDiskHeaderInfo) + i * sizeof(N_IndexNode), m_pIndexNodeList->at(i));
-	}
-
-	//offset that skips header & i-node table
-	mVDiskHeaderLength = sizeof(N_VirtualDiskHeaderInfo) + inodeCount * sizeof(N_IndexNode);
+	memcpy(&m_pIndexNodeList->at(0), &m_pVirtualDiskImage->at(sizeof(N_VirtualDiskHeaderInfo)), size_t(inodeCount) * sizeof(N_IndexNode));
 
 
 	//init i-node of current working dir with root
@@ -261,20 +426,44 @@ bool IFileSystem::InstallVirtualDisk(NFilePath virtualDiskImagePath)
 	*m_pCurrentWorkingDir = "\\";
 
 	//init the ALLOCATOR of I-NODE and  Free User Space
+	//(a shared extent is allocated once, and referred once more by every other clone)
 	m_pIndexNodeAllocator = new CAllocator(inodeCount);
 	m_pFileAddressAllocator = new CAllocator(mVDiskCapacity);
+	std::unordered_set<uint64_t> sharedExtents;
 	for (uint32_t i = 0; i < m_pIndexNodeList->size(); ++i)
 	{
 		N_IndexNode& inode =m_pIndexNodeList->at(i);
-		if(inode.ownerUserID!=NOISE_FILE_OWNER_NULL)m_pIndexNodeAllocator->Allocate(i, 1);
-		m_pFileAddressAllocator->Allocate(inode.address, inode.size);
+		if (inode.ownerUserID == NOISE_FILE_OWNER_NULL)continue;
+		m_pIndexNodeAllocator->Allocate(i, 1);
+		if (inode.isInline())continue;
+		if ((inode.flags & NOISE_INDEX_NODE_FLAG_SHARED) && !sharedExtents.insert(inode.address).second)
+			m_pFileAddressAllocator->AddReference(inode.address);
+		else
+			m_pFileAddressAllocator->Allocate(inode.address, mFunction_GetAllocationSize(inode.extentSize()));
 	}
 
 
+	m_pFileAddressAllocator->GetFreeSegments(*m_pWrittenBackFreeSegments);
+
 	mIsVDiskInitialized = true;
+	mIsImageFileStale = false;
+	DEBUG_MSG("Install Virtual Disk : " << GetVDiskImageHugePageSize() << " of " << fileSize << " bytes of image memory in huge pages.");
+
+	//corruption is reported, but the image is still installed (so that fsck can run)
+	*m_pChecksumReport = N_ChecksumReport();
+	mFunction_VerifyChecksums();
+
+	if (m_pMetadataIndex != nullptr)mFunction_RebuildMetadataIndex();
 	return true;
 }
 
+bool IFileSystem::mFunction_IsWritable(const std::string & operationName)
+{
+	if (!mIsVDiskReadOnly)return true;
+	ERROR_MSG("FileSystem :" + operationName + " failed. virtual disk is installed read-only.");
+	return false;
+}
+
 void IFileSystem::UninstallVirtualDisk()
 {
 	DEBUG_MSG("********************************");
@@ -287,26 +476,26 @@ void IFileSystem::UninstallVirtualDisk()
 	}
 
 	//close all opened files(in case the user forget to close)
-	uint32_t openedFileCount =  IFactory<IFile>::GetObjectCount();
-	for (uint32_t i = 0; i < openedFileCount; ++i)
+	//(CloseFile destroys the file object, so always close the first one)
+	while (IFactory<IFile>::GetObjectCount() > 0)
 	{	
-		IFileSystem::CloseFile(IFactory<IFile>::GetObjectPtr(i));//forced hard disk write
+		IFileSystem::CloseFile(IFactory<IFile>::GetObjectPtr(UINT(0)));//forced hard disk write
 	}
 	IFactory<IFile>::DestroyAllObject();
 
-	//update i-node table
-	uint32_t inodeCount = m_pIndexNodeList->size();
-	for (uint32_t i = 0; i < inodeCount; ++i)
-	{
-		mFunction_WriteData(sizeof(N_VirtualDiskHeaderInfo) + i * sizeof(N_IndexNode), m_pIndexNodeList->at(i));
-	}
+	//trace, snapshot and scrubber belong to the installed image
+	StopTraceRecording();
+	ReleaseSnapshot();
+	StopScrubber();
 
-	//write the image of VD to hard disk
-	m_pVirtualDiskFile->seekp(0);
-	m_pVirtualDiskFile->write((char*)&m_pVirtualDiskImage->at(0), m_pVirtualDiskImage->size());
+	//write the image of VD to hard disk, then host storage of freed space is given back
+	//(a read-only install has nothing to write)
+	if (!mIsVDiskReadOnly && mFunction_WriteBackImage())Trim();
 
+	//(memory of the image is given back, huge pages are scarce)
 	m_pVirtualDiskFile->close();
-	m_pVirtualDiskImage->clear();
+	delete m_pVirtualDiskImage;
+	m_pVirtualDiskImage = nullptr;
 	delete m_pVirtualDiskFile;
 	m_pVirtualDiskFile = nullptr;
 
@@ -314,9 +503,209 @@ void IFileSystem::UninstallVirtualDisk()
 	m_pIndexNodeAllocator->ReleaseAllSpace();
 
 	mIsVDiskInitialized = false;
+	mIsImageFileStale = false;
+	mIsVDiskReadOnly = false;
+	CHostFile::UnlockFile(mHostFileLockHandle);
+	mHostFileLockHandle = CHostFile::c_InvalidLockHandle;
+	if (m_pMetadataIndex != nullptr)m_pMetadataIndex->Clear();
+	if (m_pDedupIndex != nullptr)m_pDedupIndex->Clear();
+}
+
+bool IFileSystem::GrowVirtualDisk(uint64_t newCapacity, uint32_t newIndexNodeCount)
+{
+	DEBUG_MSG("********************************");
+	DEBUG_MSG("Growing Virtual Disk....");
+
+	if (!mIsVDiskInitialized)
+	{
+		ERROR_MSG("Grow Virtual Disk failure: virtual disk was not installed !!");
+		return false;
+	}
+	if (mIsVDiskReadOnly)
+	{
+		ERROR_MSG("Grow Virtual Disk failure: virtual disk is installed read-only !");
+		return false;
+	}
+
+	//capacity is rounded down to whole blocks
+	newCapacity &= ~uint64_t(mVDiskBlockSize - 1);
+	uint32_t oldIndexNodeCount = uint32_t(m_pIndexNodeList->size());
+	if (newIndexNodeCount == 0)
+	{
+		uint64_t proportionalCount = uint64_t(oldIndexNodeCount) * (newCapacity / mVDiskBlockSize) / (mVDiskCapacity / mVDiskBlockSize);
+		newIndexNodeCount = uint32_t(std::min<uint64_t>(std::max<uint64_t>(proportionalCount, oldIndexNodeCount), 0xfffffffe));
+	}
+
+	if (newCapacity < mVDiskCapacity || newIndexNodeCount < oldIndexNodeCount)
+	{
+		ERROR_MSG("Grow Virtual Disk failure: virtual disk can't shrink !");
+		return false;
+	}
+	if (newCapacity == mVDiskCapacity && newIndexNodeCount == oldIndexNodeCount)return true;
+
+	uint64_t oldCapacity = mVDiskCapacity;
+	uint64_t oldImageSize = mVDiskImageSize;
+	uint64_t newImageSize = mFunction_GetHeaderLength(newIndexNodeCount) + newCapacity + mFunction_GetChecksumAreaSize(newCapacity);
+
+	//memory image is enlarged first, nothing has changed if it fails
+	if (!m_pVirtualDiskImage->resize(newImageSize))
+	{
+		ERROR_MSG("Grow Virtual Disk failure: not enough memory for virtual disk image !");
+		return false;
+	}
+
+	//then host file is extended sparsely, so that a full host disk is reported before the image changes
+	//(scrubber is kept out of the image file till the grown image is written back)
+	std::unique_lock<std::mutex> imageFileLock;
+	if (m_pScrubber != nullptr)imageFileLock = std::unique_lock<std::mutex>(m_pScrubber->GetImageFileMutex());
+	m_pVirtualDiskFile->flush();
+	if (!CHostFile::SetFileSize(*m_pVirtualDiskImagePath, newImageSize))
+	{
+		CHostFile::SetFileSize(*m_pVirtualDiskImagePath, oldImageSize);
+		m_pVirtualDiskImage->resize(oldImageSize);//(if it fails, the tail is just unused)
+		ERROR_MSG("Grow Virtual Disk failure: host file can't be extended !");
+		return false;
+	}
+
+	//the grown image is written back at once. a grow that is interrupted before its header is
+	//written leaves the old image and a longer file, which is still installed
+	mFunction_RelayoutImage(newCapacity, newIndexNodeCount);
+	if (!mFunction_WriteBackImage())
+	{
+		//old layout is written back into a file of old size (user space is at old offsets again)
+		mFunction_RelayoutImage(oldCapacity, oldIndexNodeCount);
+		bool isRestored = CHostFile::SetFileSize(*m_pVirtualDiskImagePath, oldImageSize) && mFunction_WriteBackImage();
+		m_pVirtualDiskImage->resize(oldImageSize);
+		ERROR_MSG("Grow Virtual Disk failure: grown image can't be written back" << (isRestored ? "" : ", image file is stale till it is written back") << " !");
+		return false;
+	}
+
+	//host file still holds stale data in new free space (old checksums, or all user data at old
+	//offsets if user space moved), it is trimmed later
+	uint64_t staleStart = (newIndexNodeCount != oldIndexNodeCount) ? 0 : oldCapacity;
+	mFunction_QueueFreedRange(staleStart, newCapacity - staleStart);
+	return true;
+}
+
+bool IFileSystem::Trim(bool isAllFreeSpaceTrimmed)
+{
+	if (!mIsVDiskInitialized)
+	{
+		ERROR_MSG("Trim failure: virtual disk was not installed !!");
+		return false;
+	}
+	if (mIsVDiskReadOnly)
+	{
+		ERROR_MSG("Trim failure: virtual disk is installed read-only !");
+		return false;
+	}
+	if (mIsImageFileStale)
+	{
+		ERROR_MSG("Trim failure: image file is stale till it is written back !");
+		return false;
+	}
+
+	//candidate ranges (some of the freed ranges may have been re-allocated since)
+	std::vector<N_AddressRange> candidates;
+	if (isAllFreeSpaceTrimmed || mIsFreedRangeListOverflowed)candidates.push_back(N_AddressRange(0, mVDiskCapacity));
+	else candidates.swap(*m_pFreedRangeList);
+	m_pFreedRangeList->clear();
+	mIsFreedRangeListOverflowed = false;
+	std::sort(candidates.begin(), candidates.end(), [](const N_AddressRange& a, const N_AddressRange& b) {return a.start < b.start; });
+
+	//holes = intersection of candidates and free segments (both sorted by address). a free piece
+	//that wasn't free when the image file was written back is still referred to by its i-nodes
+	//and directories, it is queued again (it lies in one free segment of image file if it was free)
+	std::vector<N_AddressRange> freeSegments;
+	m_pFileAddressAllocator->GetFreeSegments(freeSegments);
+	const std::vector<N_AddressRange>& writtenBackFreeSegments = *m_pWrittenBackFreeSegments;
+	auto isWrittenBackFree = [&](uint64_t start, uint64_t end)
+	{
+		auto pSeg = std::upper_bound(writtenBackFreeSegments.begin(), writtenBackFreeSegments.end(), start,
+			[](uint64_t address, const N_AddressRange& seg) {return address < seg.start; });
+		return pSeg != writtenBackFreeSegments.begin() && (pSeg - 1)->start + (pSeg - 1)->size >= end;
+	};
+	std::vector<N_AddressRange> holes;
+	uint64_t holeEnd = 0;//candidates may overlap, bytes before holeEnd are punched already
+	auto pSeg = freeSegments.begin();
+	for (auto& c : candidates)
+	{
+		uint64_t cStart = std::max(c.start, holeEnd);
+		uint64_t cEnd = c.start + c.size;
+		while (pSeg != freeSegments.end() && pSeg->start + pSeg->size <= cStart)++pSeg;
+		for (auto pIter = pSeg; pIter != freeSegments.end() && pIter->start < cEnd; ++pIter)
+		{
+			uint64_t pieceStart = std::max(cStart, pIter->start);
+			uint64_t pieceEnd = std::min(cEnd, pIter->start + pIter->size);
+			if (!isWrittenBackFree(pieceStart, pieceEnd))
+			{
+				mFunction_QueueFreedRange(pieceStart, pieceEnd - pieceStart);
+				continue;
+			}
+
+			//only whole checksum blocks are punched, so that partly allocated blocks still match their checksums
+			uint64_t start = (pieceStart + c_ChecksumBlockSize - 1) / c_ChecksumBlockSize * c_ChecksumBlockSize;
+			uint64_t end = pieceEnd;
+			if (end != mVDiskCapacity)end = end / c_ChecksumBlockSize * c_ChecksumBlockSize;
+			if (end > start)holes.push_back(N_AddressRange(start, end - start));
+		}
+		holeEnd = std::max(holeEnd, cEnd);
+	}
+	if (holes.empty())return true;
+
+	//memory image must agree with host file (which reads zero in holes), so must checksums of punched blocks
+	std::vector<char> zeroBlock(c_ChecksumBlockSize, 0);
+	uint32_t zeroBlockChecksum = CChecksum::CRC32C(&zeroBlock.at(0), c_ChecksumBlockSize);
+	uint64_t checksumAreaOffset = mFunction_GetChecksumAreaOffset();
+	uint64_t punchedBytes = 0;
+	for (auto& h : holes)
+	{
+		mFunction_PreserveSnapshot(h.start, h.size);
+		memset(&m_pVirtualDiskImage->at(size_t(mVDiskHeaderLength + h.start)), 0, size_t(h.size));
+		for (uint64_t blockStart = h.start; blockStart < h.start + h.size; blockStart += c_ChecksumBlockSize)
+		{
+			uint64_t blockSize = std::min<uint64_t>(c_ChecksumBlockSize, mVDiskCapacity - blockStart);
+			uint32_t checksum = (blockSize == c_ChecksumBlockSize) ? zeroBlockChecksum : CChecksum::CRC32C(&zeroBlock.at(0), blockSize);
+			memcpy(&m_pVirtualDiskImage->at(size_t(checksumAreaOffset + blockStart / c_ChecksumBlockSize * sizeof(uint32_t))), &checksum, sizeof(checksum));
+		}
+		punchedBytes += h.size;
+	}
+
+	//scrubber doesn't read host file while it is modified
+	std::unique_lock<std::mutex> imageFileLock;
+	if (m_pScrubber != nullptr)imageFileLock = std::unique_lock<std::mutex>(m_pScrubber->GetImageFileMutex());
+	for (auto& h : holes)
+	{
+		uint64_t checksumOffset = checksumAreaOffset + h.start / c_ChecksumBlockSize * sizeof(uint32_t);
+		m_pVirtualDiskFile->seekp(std::streamoff(checksumOffset));
+		m_pVirtualDiskFile->write(&m_pVirtualDiskImage->at(size_t(checksumOffset)), std::streamsize((h.size + c_ChecksumBlockSize - 1) / c_ChecksumBlockSize * sizeof(uint32_t)));
+		h.start += mVDiskHeaderLength;//host file offset
+	}
+
+	m_pVirtualDiskFile->flush();
+	if (CHostFile::PunchHoles(*m_pVirtualDiskImagePath, holes))
+	{
+		DEBUG_MSG("Trim : " << punchedBytes << " bytes given back to host file system.");
+		return true;
+	}
+
+	//holes can't be punched, but those ranges still have to read as zero
+	for (auto& h : holes)
+	{
+		m_pVirtualDiskFile->seekp(std::streamoff(h.start));
+		m_pVirtualDiskFile->write(&m_pVirtualDiskImage->at(size_t(h.start)), std::streamsize(h.size));
+	}
+	m_pVirtualDiskFile->flush();
+	return false;
 }
 
 bool IFileSystem::Login(std::string userName, std::string password)
+{
+	CTraceScope trace(m_pTraceRecorder, NOISE_TRACE_OP_LOGIN, userName);
+	return trace.Result(mFunction_Login(userName, password));
+}
+
+bool IFileSystem::mFunction_Login(std::string userName, std::string password)
 {
 	DEBUG_MSG("********************************");
 	DEBUG_MSG("Logging in....");
@@ -347,6 +736,12 @@ bool IFileSystem::Login(std::string userName, std::string password)
 }
 
 bool IFileSystem::SetWorkingDir(std::string dir)
+{
+	CTraceScope trace(m_pTraceRecorder, NOISE_TRACE_OP_SET_WORKING_DIR, dir);
+	return trace.Result(mFunction_SetWorkingDir(dir));
+}
+
+bool IFileSystem::mFunction_SetWorkingDir(std::string dir)
 {
 	DEBUG_MSG("********************************");
 	DEBUG_MSG("Setting working directory to:" + dir);
@@ -354,81 +749,171 @@ bool IFileSystem::SetWorkingDir(std::string dir)
 	//decide if a character is delimiter of a path
 	auto isDelim = [](char c) ->bool{return c == '\\' || c == '/'; };
 
-	//analyze directory folders hierarchies
-	std::vector<std::string> intermediateFolders;
 	if (dir.size() == 0) { ERROR_MSG("IFileSystem: SetWorkingDir failure: empty argument."); return false; }
 	if(!isDelim(dir.at(0))){ ERROR_MSG("IFileSystem: SetWorkingDir failure: path must start with \\ or /"); return false; }
 
-	//split path into folder name with delimiter
-	for (uint32_t i = 0; i < dir.size();++i)
+	//iterate from root i-node (working dir is kept when failure occur)
+	uint32_t targetIndexNodeNum = 0;
+	if (!mFunction_ResolveDirectory(dir, targetIndexNodeNum))
 	{
-		if (isDelim(dir.at(i)))
-		{
-			intermediateFolders.push_back("");
-		}
-		else
-		{
-			intermediateFolders.back().push_back(dir.at(i));
-		}
+		ERROR_MSG("IFileSystem: SetWorkingDir failure: No such directory .");
+		return false;
 	}
+	m_pCurrentDirIndexNode = &m_pIndexNodeList->at(targetIndexNodeNum);
 
-	//delimiter could occur at the back of a string, eliminate it.
-	if (intermediateFolders.back() == "")intermediateFolders.pop_back();
+	//SUCCEED
+	*m_pCurrentWorkingDir = dir;
+	if (m_pCurrentWorkingDir->back() != '/')m_pCurrentWorkingDir->push_back('/');
+	return true;
+}
 
-	//iterate from root i-node
-	N_IndexNode*		pOriginIndexNode = m_pCurrentDirIndexNode;//restore when failure occur
-	m_pCurrentDirIndexNode = &m_pIndexNodeList->at(0);
+std::string IFileSystem::GetWorkingDir()
+{
+	return *m_pCurrentWorkingDir;
+}
 
-	for (auto& folderName: intermediateFolders)
+bool IFileSystem::Walk(std::string startDir, const N_FileSystemWalkOptions & options, N_WalkPredicate predicate, N_WalkCallback callback)
+{
+	CTraceScope trace(m_pTraceRecorder, NOISE_TRACE_OP_WALK, startDir, options.maxDepth);
+	uint64_t matchCount = 0;
+	bool result = mFunction_Walk(startDir, options, predicate, callback, matchCount);
+	trace.SetArgs(options.maxDepth, matchCount);
+	return trace.Result(result);
+}
+
+bool IFileSystem::mFunction_Walk(const std::string & startDir, const N_FileSystemWalkOptions & options, const N_WalkPredicate & predicate, const N_WalkCallback & callback, uint64_t & outMatchCount)
+{
+	outMatchCount = 0;
+	uint32_t startIndexNodeNum = 0;
+	if (!mFunction_ResolveDirectory(startDir, startIndexNodeNum))
 	{
+		ERROR_MSG("IFileSystem: Walk failure: No such directory .");
+		return false;
+	}
 
-		uint32_t folderCount = 0, fileCount = 0;
-		std::vector<N_DirFileRecord> subFolderINT;//i-node number list
-		std::vector<N_DirFileRecord> subFilesINT;//i-node number list
+	//paths of walked folders always end with '/'
+	std::string startPath = startDir;
+	std::replace(startPath.begin(), startPath.end(), '\\', '/');
+	if (startPath.back() != '/')startPath.push_back('/');
 
-		mFunction_ReadDirectoryFile(m_pCurrentDirIndexNode->address, folderCount, fileCount, subFolderINT, subFilesINT);
+	//a path is worth descending/reporting if it agrees with the prefix limit on their common part
+	const std::string& prefix = options.pathPrefix;
+	auto isPrefixCompatible = [&prefix](const std::string& path) ->bool
+	{
+		size_t commonLength = std::min(path.size(), prefix.size());
+		return path.compare(0, commonLength, prefix, 0, commonLength) == 0;
+	};
+	if (!isPrefixCompatible(startPath))return true;
 
-		for (auto& existingFolder: subFolderINT)
+	//shared state of worker threads : one folder per task
+	struct N_WalkTask
+	{
+		uint32_t indexNodeId;
+		std::string path;
+		uint32_t depth;
+	};
+	std::vector<N_WalkTask> taskStack(1, N_WalkTask{ startIndexNodeNum, startPath, 0 });
+	std::mutex taskLock;
+	std::condition_variable taskCondition;
+	uint32_t activeWorkerCount = 0;
+	std::mutex callbackLock;
+	std::atomic<uint64_t> matchCount(0);
+
+	auto workerLoop = [&]()
+	{
+		uint32_t folderCount = 0, fileCount = 0;
+		std::vector<N_DirFileRecord> subFolderINT;
+		std::vector<N_DirFileRecord> subFilesINT;
+		std::vector<N_WalkTask> newTasks;
+		while (true)
 		{
-			//match existing child folder
-			if (folderName == existingFolder.name)
+			N_WalkTask task;
+			{
+				//quit when no task is left and no worker can produce one
+				std::unique_lock<std::mutex> lock(taskLock);
+				taskCondition.wait(lock, [&]() {return !taskStack.empty() || activeWorkerCount == 0; });
+				if (taskStack.empty())return;
+				task = std::move(taskStack.back());
+				taskStack.pop_back();
+				++activeWorkerCount;
+			}
+
+			mFunction_ReadDirectoryFile(m_pIndexNodeList->at(task.indexNodeId), folderCount, fileCount, subFolderINT, subFilesINT);
+
+			//below the prefix limit every child is compatible, paths are only built for matches then
+			bool isPrefixChecked = (task.path.size() < prefix.size());
+			bool isDescended = (task.depth + 1 < options.maxDepth);
+			auto visit = [&](const N_DirFileRecord& record, bool isFolder)
 			{
-				m_pCurrentDirIndexNode = &m_pIndexNodeList->at(existingFolder.indexNodeId);
-				goto nextLevel;
+				if (record.indexNodeId >= m_pIndexNodeList->size())return;//(broken record, see fsck)
+				const N_IndexNode& node = m_pIndexNodeList->at(record.indexNodeId);
+				std::string path;
+				if (isPrefixChecked)
+				{
+					path = task.path + record.name + (isFolder ? "/" : "");
+					if (!isPrefixCompatible(path))return;
+				}
+
+				if ((!isFolder || options.isFolderReported) && (!isPrefixChecked || path.size() >= prefix.size()) && (!predicate || predicate(record.name, node, isFolder)))
+				{
+					++matchCount;
+					if (callback)
+					{
+						if (path.empty())path = task.path + record.name + (isFolder ? "/" : "");
+						std::lock_guard<std::mutex> lock(callbackLock);
+						callback(path, node, isFolder);
+					}
+				}
+
+				if (isFolder && isDescended)
+				{
+					if (path.empty())path = task.path + record.name + "/";
+					newTasks.push_back(N_WalkTask{ record.indexNodeId, std::move(path), task.depth + 1 });
+				}
 			};
-		}
+			for (auto& record : subFolderINT)visit(record, true);
+			for (auto& record : subFilesINT)visit(record, false);
 
-		//loop-ed through folder names of current level, no match
-		m_pCurrentDirIndexNode = pOriginIndexNode;//restore former i-node
-		ERROR_MSG("IFileSystem: SetWorkingDir failure: No such directory .");
-		return false;
+			{
+				std::lock_guard<std::mutex> lock(taskLock);
+				for (auto& newTask : newTasks)taskStack.push_back(std::move(newTask));
+				--activeWorkerCount;
+			}
+			newTasks.clear();
+			taskCondition.notify_all();
+		}
+	};
 
-	nextLevel:;
-	}
+	uint32_t threadCount = options.threadCount != 0 ? options.threadCount : std::max(1u, std::thread::hardware_concurrency());
+	std::vector<std::thread> workers;
+	for (uint32_t i = 1; i < threadCount; ++i)workers.push_back(std::thread(workerLoop));
+	workerLoop();//calling thread is a worker too
+	for (auto& worker : workers)worker.join();
 
-	//SUCCEED
-	*m_pCurrentWorkingDir = dir;
-	if (m_pCurrentWorkingDir->back() != '/')m_pCurrentWorkingDir->push_back('/');
+	outMatchCount = matchCount;
 	return true;
 }
 
-std::string IFileSystem::GetWorkingDir()
+bool IFileSystem::CreateFolder(std::string folderName)
 {
-	return *m_pCurrentWorkingDir;
+	CTraceScope trace(m_pTraceRecorder, NOISE_TRACE_OP_CREATE_FOLDER, folderName);
+	return trace.Result(mFunction_CreateFolder(folderName));
 }
 
-bool IFileSystem::CreateFolder(std::string folderName)
+bool IFileSystem::mFunction_CreateFolder(std::string folderName)
 {
 	DEBUG_MSG("********************************");
 	DEBUG_MSG("Creating Folder:" + *m_pCurrentWorkingDir + folderName);
 
+	if (!mFunction_IsWritable("Create folder"))return false;
+
 	if (!mFunction_NameValidation(folderName))
 	{
 		ERROR_MSG("FileSystem :Create folder failed.");
 		return false;
 	}
 	
-	if (m_pFileAddressAllocator->GetFreeSpace() < sizeof(N_DirFileRecord))
+	if (m_pFileAddressAllocator->GetFreeSpace() < mFunction_GetAllocationSize(sizeof(N_DirFileRecord)))
 	{
 		ERROR_MSG("FileSystem :Create folder failed. the entire address space has been occupied.");
 		return false;
@@ -440,29 +925,27 @@ bool IFileSystem::CreateFolder(std::string folderName)
 		return false;
 	}
 
+	//CHECK repetition
+	uint32_t existingIndexNodeNum = 0;
+	if (mFunction_FindInDirectory(*m_pCurrentDirIndexNode, folderName, true, existingIndexNodeNum))
+	{
+		ERROR_MSG("FileSystem :Create folder failed. Folder already exist.");
+		return false;
+	}
+
 	//read dir info about
 	uint32_t folderCount = 0, fileCount = 0;
 	std::vector<N_DirFileRecord> subFolderINT;//i-node number list
 	std::vector<N_DirFileRecord> subFilesINT;//i-node number list
-	mFunction_ReadDirectoryFile(m_pCurrentDirIndexNode->address, folderCount, fileCount, subFolderINT, subFilesINT);
-
-	//CHECK repetition
-	for (auto& folder : subFolderINT)
-	{
-		if (folder.name == folderName)
-		{
-			ERROR_MSG("FileSystem :Create folder failed. Folder already exist.");
-			return false;
-		}
-	}
+	mFunction_ReadDirectoryFile(*m_pCurrentDirIndexNode, folderCount, fileCount, subFolderINT, subFilesINT);
 
 
 	//Create dir-file for child folder :
 	//---1, create i-node
 	//---2, allocate space
 	//---3, init data
-	uint32_t childDirFileAddr = m_pFileAddressAllocator->Allocate(2*sizeof(uint32_t));
-	uint32_t childDirFileINodeNum = m_pIndexNodeAllocator->Allocate(1);
+	uint64_t childDirFileAddr = mFunction_AllocateFileSpace(2*sizeof(uint32_t));
+	uint32_t childDirFileINodeNum = uint32_t(m_pIndexNodeAllocator->Allocate(1));
 
 	N_IndexNode inode = m_pIndexNodeList->at(childDirFileINodeNum);
 	inode.accessMode = NOISE_FILE_ACCESS_MODE_OWNER_RW;
@@ -472,23 +955,21 @@ bool IFileSystem::CreateFolder(std::string folderName)
 	m_pIndexNodeList->at(childDirFileINodeNum) = inode;//assign value to allocated i-node
 
 	uint32_t zeroCount = 0;
+	mFunction_PreserveSnapshot(childDirFileAddr, 2 * sizeof(uint32_t));
 	mFunction_WriteData(mVDiskHeaderLength + childDirFileAddr + 0, zeroCount);//folder count
 	mFunction_WriteData(mVDiskHeaderLength + childDirFileAddr + 4, zeroCount);//file count
 
 
 #pragma region MODIFY DIR FILE FOR CREATE CHILD FILES
 
-	//resize of current directory file
-	++folderCount;
-	m_pFileAddressAllocator->Release(m_pCurrentDirIndexNode->address, m_pCurrentDirIndexNode->size);
-	uint32_t newSize = 8 + (folderCount + fileCount) * sizeof(N_DirFileRecord);
-	uint32_t newAddress = m_pFileAddressAllocator->Allocate(newSize);
-	m_pCurrentDirIndexNode->address = newAddress;
-	m_pCurrentDirIndexNode->size = newSize;
-
 	//OBTAIN new i-node number !!! UPDATE resized current dir file
 	subFolderINT.push_back(N_DirFileRecord(folderName, childDirFileINodeNum));
-	mFunction_WriteDirectoryFile(m_pCurrentDirIndexNode->address, folderCount, fileCount, subFolderINT, subFilesINT);
+	if (!mFunction_UpdateDirectoryFile(m_pCurrentDirIndexNode, subFolderINT, subFilesINT))
+	{
+		mFunction_ReleaseFileSpace(childDirFileINodeNum);
+		ERROR_MSG("FileSystem :Create folder failed. Not Enough space.");
+		return false;
+	}
 
 #pragma endregion
 
@@ -497,9 +978,17 @@ bool IFileSystem::CreateFolder(std::string folderName)
 
 bool IFileSystem::DeleteFolder(std::string folderName)
 {
-	DEBUG_MSG("********************************");
+	CTraceScope trace(m_pTraceRecorder, NOISE_TRACE_OP_DELETE_FOLDER, folderName);
+	return trace.Result(mFunction_DeleteFolder(folderName));
+}
+
+bool IFileSystem::mFunction_DeleteFolder(std::string folderName)
+{
+	DEBUG_MSG("********************************");
 	DEBUG_MSG("Deleting Folder:" + *m_pCurrentWorkingDir + folderName);
 
+	if (!mFunction_IsWritable("Delete folder"))return false;
+
 	if (!mFunction_NameValidation(folderName))
 	{
 		ERROR_MSG("FileSystem :Delete folder failed.");
@@ -520,7 +1009,7 @@ bool IFileSystem::DeleteFolder(std::string folderName)
 	uint32_t folderCount = 0, fileCount = 0;
 	std::vector<N_DirFileRecord> subFolderINT;//i-node number list
 	std::vector<N_DirFileRecord> subFilesINT;//i-node number list
-	mFunction_ReadDirectoryFile(m_pCurrentDirIndexNode->address, folderCount, fileCount, subFolderINT, subFilesINT);
+	mFunction_ReadDirectoryFile(*m_pCurrentDirIndexNode, folderCount, fileCount, subFolderINT, subFilesINT);
 
 	//check if target directory exist 
 	bool isFolderFound = false;
@@ -545,15 +1034,8 @@ bool IFileSystem::DeleteFolder(std::string folderName)
 			};
 
 			//resize of CURRENT LEVEL directory file
-			--folderCount;
-			m_pFileAddressAllocator->Release(m_pCurrentDirIndexNode->address, m_pCurrentDirIndexNode->size);
-			uint32_t newAddress = m_pFileAddressAllocator->Allocate(m_pCurrentDirIndexNode->size);
-			m_pCurrentDirIndexNode->address = newAddress;
-			m_pCurrentDirIndexNode->size = 8 + (folderCount + fileCount) * sizeof(N_DirFileRecord);
-
-			//then update resized dir file
 			subFolderINT.erase(pIter);
-			mFunction_WriteDirectoryFile(m_pCurrentDirIndexNode->address, folderCount, fileCount, subFolderINT, subFilesINT);
+			mFunction_UpdateDirectoryFile(m_pCurrentDirIndexNode, subFolderINT, subFilesINT);
 
 
 			break;
@@ -571,11 +1053,18 @@ bool IFileSystem::DeleteFolder(std::string folderName)
 }
 
 void IFileSystem::EnumerateFilesAndDirs(N_FileSystemEnumResult & outResult)
+{
+	CTraceScope trace(m_pTraceRecorder, NOISE_TRACE_OP_ENUMERATE);
+	mFunction_EnumerateFilesAndDirs(outResult);
+	trace.SetArgs(uint32_t(outResult.folderList.size()), uint32_t(outResult.fileList.size()));
+}
+
+void IFileSystem::mFunction_EnumerateFilesAndDirs(N_FileSystemEnumResult & outResult)
 {
 	//read directory file
 	uint32_t folderCount = 0, fileCount = 0;
 	std::vector<N_DirFileRecord> folderList, fileList;
-	mFunction_ReadDirectoryFile(m_pCurrentDirIndexNode->address, folderCount, fileCount, folderList,fileList);
+	mFunction_ReadDirectoryFile(*m_pCurrentDirIndexNode, folderCount, fileCount, folderList,fileList);
 
 	//output files and dirs
 	outResult.folderList.reserve(folderCount);
@@ -589,7 +1078,8 @@ void IFileSystem::EnumerateFilesAndDirs(N_FileSystemEnumResult & outResult)
 		{
 			N_FileEnumInfo fileInfo;
 			fileInfo.accessMode = pNode->accessMode;
-			fileInfo.address = pNode->address;
+			fileInfo.isInline = pNode->isInline();
+			fileInfo.address = pNode->isInline() ? 0 : pNode->address;
 			fileInfo.name = file.name;
 			fileInfo.ownerUserID = pNode->ownerUserID;
 			fileInfo.size = pNode->size;
@@ -598,29 +1088,53 @@ void IFileSystem::EnumerateFilesAndDirs(N_FileSystemEnumResult & outResult)
 	}
 }
 
-bool IFileSystem::CreateFile(std::string fileName, uint32_t byteSize, NOISE_FILE_ACCESS_MODE acMode)
+bool IFileSystem::CreateFile(std::string fileName, uint64_t byteSize, NOISE_FILE_ACCESS_MODE acMode)
+{
+	CTraceScope trace(m_pTraceRecorder, NOISE_TRACE_OP_CREATE_FILE, fileName, byteSize, acMode);
+	return trace.Result(mFunction_CreateFile(fileName, byteSize, acMode));
+}
+
+bool IFileSystem::mFunction_CreateFile(std::string fileName, uint64_t byteSize, NOISE_FILE_ACCESS_MODE acMode)
 {
 	DEBUG_MSG("********************************");
 	DEBUG_MSG("Creating File:" + *m_pCurrentWorkingDir + fileName);
 
+	if (!mFunction_IsWritable("Create File"))return false;
+
 	if (!mFunction_NameValidation(fileName))
 	{
 		ERROR_MSG("FileSystem :Create File failed.");
 		return false;
 	}
 
-	//new file space
-	uint32_t childFileAddr = m_pFileAddressAllocator->Allocate(byteSize);
-	if (childFileAddr == c_invalid_alloc_address || m_pFileAddressAllocator->GetFreeSpace()<sizeof(N_DirFileRecord))
+	//CHECK repetition
+	uint32_t existingIndexNodeNum = 0;
+	if (mFunction_FindInDirectory(*m_pCurrentDirIndexNode, fileName, false, existingIndexNodeNum))
+	{
+		ERROR_MSG("FileSystem :Create File failed. File Name already exist.");
+		return false;
+	}
+
+	//new file space (tiny files are stored inline in i-node, no extent is needed)
+	bool isInline = (byteSize <= c_IndexNodeInlineDataMaxSize);
+	uint64_t extentSize = isInline ? 0 : byteSize;
+	uint64_t childFileAddr = isInline ? 0 : mFunction_AllocateFileSpace(extentSize);
+	if (childFileAddr == c_invalid_alloc_address)
+	{
+		ERROR_MSG("FileSystem :Create File failed.Not Enough space.");
+		return false;
+	}
+	if (m_pFileAddressAllocator->GetFreeSpace() < mFunction_GetAllocationSize(sizeof(N_DirFileRecord)))
 	{
+		mFunction_ReleaseFileSpace(childFileAddr, extentSize);
 		ERROR_MSG("FileSystem :Create File failed.Not Enough space.");
 		return false;
 	}
 
-	uint32_t childFileINodeNum = m_pIndexNodeAllocator->Allocate(1);
-	if (childFileINodeNum == c_invalid_alloc_address )
+	uint32_t childFileINodeNum = uint32_t(m_pIndexNodeAllocator->Allocate(1));
+	if (childFileINodeNum == uint32_t(c_invalid_alloc_address))
 	{
-		m_pFileAddressAllocator->Release(childFileAddr, byteSize);//release file space for failing to create file
+		mFunction_ReleaseFileSpace(childFileAddr, extentSize);//release file space for failing to create file
 		ERROR_MSG("FileSystem :Create File failed. Not Enough index nodes.");
 		return false;
 	}
@@ -629,39 +1143,28 @@ bool IFileSystem::CreateFile(std::string fileName, uint32_t byteSize, NOISE_FILE
 	uint32_t folderCount = 0, fileCount = 0;
 	std::vector<N_DirFileRecord> subFolderINT;//i-node number list
 	std::vector<N_DirFileRecord> subFilesINT;//i-node number list
-	mFunction_ReadDirectoryFile(m_pCurrentDirIndexNode->address, folderCount, fileCount, subFolderINT, subFilesINT);
-
-	//CHECK repetition
-	for (auto& file : subFilesINT)
-	{
-		if (file.name == fileName)
-		{
-			ERROR_MSG("FileSystem :Create File failed. File Name already exist.");
-			return false;
-		}
-	}
+	mFunction_ReadDirectoryFile(*m_pCurrentDirIndexNode, folderCount, fileCount, subFolderINT, subFilesINT);
 
 	//new INDEX NODE the file
 	N_IndexNode newFileIndexNode;
 	newFileIndexNode.accessMode = acMode;
-	newFileIndexNode.address = childFileAddr;
+	if (isInline)newFileIndexNode.flags |= NOISE_INDEX_NODE_FLAG_INLINE;
+	else newFileIndexNode.address = childFileAddr;
 	newFileIndexNode.ownerUserID = mLoggedInAccountID;
 	newFileIndexNode.size = byteSize;
 	m_pIndexNodeList->at(childFileINodeNum) = newFileIndexNode;
 
 
 
-	//resize of current directory file
-	++fileCount;
-	m_pFileAddressAllocator->Release(m_pCurrentDirIndexNode->address, m_pCurrentDirIndexNode->size);
-	uint32_t newSize = 8 + (folderCount + fileCount) * sizeof(N_DirFileRecord);
-	uint32_t newAddress = m_pFileAddressAllocator->Allocate(newSize);
-	m_pCurrentDirIndexNode->address = newAddress;
-	m_pCurrentDirIndexNode->size = newSize;
-
 	//OBTAIN new i-node number !!! UPDATE resized wroking dir's  dir  file
 	subFilesINT.push_back(N_DirFileRecord(fileName, childFileINodeNum));
-	mFunction_WriteDirectoryFile(m_pCurrentDirIndexNode->address, folderCount, fileCount, subFolderINT, subFilesINT);
+	if (!mFunction_UpdateDirectoryFile(m_pCurrentDirIndexNode, subFolderINT, subFilesINT))
+	{
+		mFunction_ReleaseFileSpace(childFileINodeNum);
+		ERROR_MSG("FileSystem :Create File failed. Not Enough space.");
+		return false;
+	}
+	if (m_pMetadataIndex != nullptr)m_pMetadataIndex->Insert(childFileINodeNum, newFileIndexNode);
 
 #pragma endregion
 
@@ -669,10 +1172,18 @@ bool IFileSystem::CreateFile(std::string fileName, uint32_t byteSize, NOISE_FILE
 }
 
 bool IFileSystem::DeleteFile(std::string fileName)
+{
+	CTraceScope trace(m_pTraceRecorder, NOISE_TRACE_OP_DELETE_FILE, fileName);
+	return trace.Result(mFunction_DeleteFile(fileName));
+}
+
+bool IFileSystem::mFunction_DeleteFile(std::string fileName)
 {
 	DEBUG_MSG("********************************");
 	DEBUG_MSG("Deleting File:" + *m_pCurrentWorkingDir + fileName);
 
+	if (!mFunction_IsWritable("Delete file"))return false;
+
 	if (!mFunction_NameValidation(fileName))
 	{
 		ERROR_MSG("FileSystem :Delete file failed.");
@@ -683,7 +1194,7 @@ bool IFileSystem::DeleteFile(std::string fileName)
 	uint32_t folderCount = 0, fileCount = 0;
 	std::vector<N_DirFileRecord> subFolderINT;//i-node number list
 	std::vector<N_DirFileRecord> subFilesINT;//i-node number list
-	mFunction_ReadDirectoryFile(m_pCurrentDirIndexNode->address, folderCount, fileCount, subFolderINT, subFilesINT);
+	mFunction_ReadDirectoryFile(*m_pCurrentDirIndexNode, folderCount, fileCount, subFolderINT, subFilesINT);
 
 	//try to find target file
 	bool isFileFound = false;
@@ -716,18 +1227,27 @@ bool IFileSystem::DeleteFile(std::string fileName)
 
 
 	//resize of current directory file
-	--fileCount;
-	m_pFileAddressAllocator->Release(m_pCurrentDirIndexNode->address, m_pCurrentDirIndexNode->size);
-	uint32_t newSize = 8 + (folderCount + fileCount) * sizeof(N_DirFileRecord);
-	uint32_t newAddress = m_pFileAddressAllocator->Allocate(newSize);
-	m_pCurrentDirIndexNode->address = newAddress;
-	m_pCurrentDirIndexNode->size = newSize;
-	mFunction_WriteDirectoryFile(m_pCurrentDirIndexNode->address, folderCount, fileCount, subFolderINT, subFilesINT);
+	mFunction_UpdateDirectoryFile(m_pCurrentDirIndexNode, subFolderINT, subFilesINT);
 
 	return true;
 }
 
 IFile * IFileSystem::OpenFile(std::string fileName)
+{
+	CTraceScope trace(m_pTraceRecorder, NOISE_TRACE_OP_OPEN_FILE, fileName);
+	IFile* pFile = mFunction_OpenFile(fileName);
+
+	//opened file is identified by handle in trace
+	if (pFile != nullptr && m_pTraceRecorder != nullptr)
+	{
+		pFile->m_pTraceRecorder = m_pTraceRecorder;
+		pFile->mTraceFileHandle = m_pTraceRecorder->AllocateFileHandle();
+		trace.SetFileHandle(pFile->mTraceFileHandle);
+	}
+	return trace.Result(pFile);
+}
+
+IFile * IFileSystem::mFunction_OpenFile(std::string fileName)
 {
 	DEBUG_MSG("********************************");
 	DEBUG_MSG("Opening File:" + *m_pCurrentWorkingDir + fileName);
@@ -735,194 +1255,1999 @@ IFile * IFileSystem::OpenFile(std::string fileName)
 	if (!mFunction_NameValidation(fileName))
 	{
 		ERROR_MSG("FileSystem :Open file failed.");
-		return false;
+		return nullptr;
 	}
 
-	//read dir info about
-	uint32_t folderCount = 0, fileCount = 0;
-	std::vector<N_DirFileRecord> subFolderINT;//i-node number list
-	std::vector<N_DirFileRecord> subFilesINT;//i-node number list
-	mFunction_ReadDirectoryFile(m_pCurrentDirIndexNode->address, folderCount, fileCount, subFolderINT, subFilesINT);
-
-	//try to find target file
-	for (auto pIter = subFolderINT.begin(); pIter != subFolderINT.end(); ++pIter)
+	//try to find target file (searched in place)
+	uint32_t targetIndexNodeNum = 0;
+	if (mFunction_FindInDirectory(*m_pCurrentDirIndexNode, fileName, false, targetIndexNodeNum))
 	{
-		//match existing child folder
-		if (fileName == pIter->name)
+		N_IndexNode* pINode = &m_pIndexNodeList->at(targetIndexNodeNum);
+		if (pINode->isFileOpened)
 		{
-			uint32_t targetIndexNodeNum = pIter->indexNodeId;
-			N_IndexNode* pINode = &m_pIndexNodeList->at(targetIndexNodeNum);
-			if (pINode->isFileOpened)
-			{
-				ERROR_MSG("FileSystem :Open file failed. file is already OPEN-ED.");
-				return false;
-			}
-
-
-			//create new file interface and init
-			IFile* pNewFile =IFactory<IFile>::CreateObject(fileName);
-			pNewFile->mFileIndexNodeNumber = targetIndexNodeNum;
-			pNewFile->m_pFileBuffer = &m_pVirtualDiskImage->at(mVDiskHeaderLength + pINode->address);
-			pNewFile->mFileSize = pINode->size;
-			pNewFile->mIsFileOpened = true;
-			pNewFile->mAccessMode_Write = pINode->accessMode & NOISE_FILE_ACCESS_MODE_OWNER_WRITE;
-			pNewFile->mAccessMode_Read = pINode->accessMode & NOISE_FILE_ACCESS_MODE_OWNER_READ;
-
-			return pNewFile;
-		};
+			ERROR_MSG("FileSystem :Open file failed. file is already OPEN-ED.");
+			return nullptr;
+		}
+		//create new file interface and init (keyed by i-node, files in different folders can share a name)
+		IFile* pNewFile =IFactory<IFile>::CreateObject(std::to_string(targetIndexNodeNum));
+		if (pNewFile == nullptr)
+		{
+			ERROR_MSG("FileSystem :Open file failed. file object can't be created.");
+			return nullptr;
+		}
+		pINode->isFileOpened = true;
+		if (m_pDedupIndex != nullptr)m_pDedupIndex->Erase(targetIndexNodeNum);//fingerprint is stale once the file may be written
+
+		pNewFile->mFileIndexNodeNumber = targetIndexNodeNum;
+		pNewFile->m_pFileBuffer = mFunction_GetFileBuffer(*pINode);
+		if (pINode->isCompressed())pNewFile->m_pChunkCache = new std::vector<N_DecompressedChunk>;
+		pNewFile->m_pFileSystem = this;
+		pNewFile->mFileSize = pINode->size;
+		pNewFile->mIsFileOpened = true;
+		pNewFile->mAccessMode_Write = (pINode->accessMode & NOISE_FILE_ACCESS_MODE_OWNER_WRITE) && !mIsVDiskReadOnly;
+		pNewFile->mAccessMode_Read = pINode->accessMode & NOISE_FILE_ACCESS_MODE_OWNER_READ;
+
+		return pNewFile;
 	}
 
 	ERROR_MSG("FileSystem : Open file failed. file not found. ");
 	return nullptr;
 }
 
-bool IFileSystem::CloseFile(IFile * pFile)
+bool IFileSystem::Rename(std::string oldPath, std::string newPath)
+{
+	CTraceScope trace(m_pTraceRecorder, NOISE_TRACE_OP_RENAME, oldPath + '\0' + newPath);
+	return trace.Result(mFunction_Rename(oldPath, newPath));
+}
+
+bool IFileSystem::mFunction_Rename(const std::string & oldPath, const std::string & newPath)
 {
 	DEBUG_MSG("********************************");
-	DEBUG_MSG("Closing File : index number = "+pFile->mFileIndexNodeNumber);
+	DEBUG_MSG("Renaming:" + oldPath + " to " + newPath);
 
-	pFile->mIsFileOpened = false;
+	if (!mFunction_IsWritable("Rename"))return false;
 
-	N_IndexNode* pINode = &m_pIndexNodeList->at(pFile->mFileIndexNodeNumber);
-	pINode->isFileOpened = false;
+	//split both paths into parent folders & name
+	std::vector<std::string> srcFolders, dstFolders;
+	mFunction_GetPathFolders(oldPath, srcFolders);
+	mFunction_GetPathFolders(newPath, dstFolders);
+	if (srcFolders.empty() || dstFolders.empty())
+	{
+		ERROR_MSG("FileSystem :Rename failed. root folder can't be renamed or replaced.");
+		return false;
+	}
+	std::string oldName = srcFolders.back();
+	std::string newName = dstFolders.back();
+	srcFolders.pop_back();
+	dstFolders.pop_back();
+	if (!mFunction_NameValidation(newName))
+	{
+		ERROR_MSG("FileSystem :Rename failed.");
+		return false;
+	}
 
-	IFactory<IFile>::DestroyObject(pFile);
+	auto joinPath = [](const std::vector<std::string>& folders) ->std::string
+	{
+		std::string path = "/";
+		for (auto& folder : folders)path += folder + "/";
+		return path;
+	};
+	uint32_t srcDirINodeNum = 0, dstDirINodeNum = 0;
+	if (!mFunction_ResolveDirectory(joinPath(srcFolders), srcDirINodeNum) || !mFunction_ResolveDirectory(joinPath(dstFolders), dstDirINodeNum))
+	{
+		ERROR_MSG("FileSystem :Rename failed. No such directory .");
+		return false;
+	}
 
-	return false;
-}
+	//renamed item is matched as a file first, then as a folder
+	uint32_t targetIndexNodeNum = 0;
+	bool isFolder = false;
+	if (!mFunction_FindInDirectory(m_pIndexNodeList->at(srcDirINodeNum), oldName, false, targetIndexNodeNum))
+	{
+		if (!mFunction_FindInDirectory(m_pIndexNodeList->at(srcDirINodeNum), oldName, true, targetIndexNodeNum))
+		{
+			ERROR_MSG("FileSystem :Rename failed. file or folder not found. ");
+			return false;
+		}
+		isFolder = true;
+	}
 
-uint32_t IFileSystem::GetVDiskCapacity()
-{
-	return mVDiskCapacity;
-}
+	uint32_t existingIndexNodeNum = 0;
+	if (mFunction_FindInDirectory(m_pIndexNodeList->at(dstDirINodeNum), newName, isFolder, existingIndexNodeNum))
+	{
+		if (existingIndexNodeNum == targetIndexNodeNum)return true;//renamed to itself
+		ERROR_MSG("FileSystem :Rename failed. target name already exist.");
+		return false;
+	}
 
-uint32_t IFileSystem::GetVDiskUsedSize()
-{
-	return mVDiskCapacity-m_pFileAddressAllocator->GetFreeSpace();
+	if (isFolder)
+	{
+		//moving into own subtree is told by path (the subtree is never walked)
+		srcFolders.push_back(oldName);
+		if (dstFolders.size() >= srcFolders.size() && std::equal(srcFolders.begin(), srcFolders.end(), dstFolders.begin()))
+		{
+			ERROR_MSG("FileSystem :Rename failed. a folder can't be moved into itself.");
+			return false;
+		}
+	}
+	else if (m_pIndexNodeList->at(targetIndexNodeNum).isFileOpened)
+	{
+		ERROR_MSG("FileSystem :Rename failed. file is OPEN-ED.");
+		return false;
+	}
+
+	//rewrite directory entries : destination gets the entry first, so a failure changes nothing
+	uint32_t folderCount = 0, fileCount = 0;
+	std::vector<N_DirFileRecord> srcSubFolders, srcSubFiles;
+	mFunction_ReadDirectoryFile(m_pIndexNodeList->at(srcDirINodeNum), folderCount, fileCount, srcSubFolders, srcSubFiles);
+	std::vector<N_DirFileRecord>& srcRecords = isFolder ? srcSubFolders : srcSubFiles;
+	auto pRecordIter = std::find_if(srcRecords.begin(), srcRecords.end(), [&oldName](const N_DirFileRecord& record) {return oldName == record.name; });
+	if (pRecordIter == srcRecords.end())
+	{
+		ERROR_MSG("FileSystem :Rename failed. source directory file is broken, run fsck.");
+		return false;
+	}
+
+	if (srcDirINodeNum == dstDirINodeNum)
+	{
+		*pRecordIter = N_DirFileRecord(newName, targetIndexNodeNum);
+		if (!mFunction_UpdateDirectoryFile(&m_pIndexNodeList->at(srcDirINodeNum), srcSubFolders, srcSubFiles))
+		{
+			ERROR_MSG("FileSystem :Rename failed. Not Enough space.");
+			return false;
+		}
+	}
+	else
+	{
+		std::vector<N_DirFileRecord> dstSubFolders, dstSubFiles;
+		mFunction_ReadDirectoryFile(m_pIndexNodeList->at(dstDirINodeNum), folderCount, fileCount, dstSubFolders, dstSubFiles);
+		(isFolder ? dstSubFolders : dstSubFiles).push_back(N_DirFileRecord(newName, targetIndexNodeNum));
+		if (!mFunction_UpdateDirectoryFile(&m_pIndexNodeList->at(dstDirINodeNum), dstSubFolders, dstSubFiles))
+		{
+			ERROR_MSG("FileSystem :Rename failed. Not Enough space.");
+			return false;
+		}
+
+		//(source directory file only shrinks, it always fits)
+		srcRecords.erase(pRecordIter);
+		mFunction_UpdateDirectoryFile(&m_pIndexNodeList->at(srcDirINodeNum), srcSubFolders, srcSubFiles);
+	}
+
+	//working dir in the moved folder keeps its i-node, only its path changes
+	if (isFolder)
+	{
+		std::vector<std::string> workingDirFolders;
+		mFunction_GetPathFolders(*m_pCurrentWorkingDir, workingDirFolders);
+		if (workingDirFolders.size() >= srcFolders.size() && std::equal(srcFolders.begin(), srcFolders.end(), workingDirFolders.begin()))
+		{
+			dstFolders.push_back(newName);
+			dstFolders.insert(dstFolders.end(), workingDirFolders.begin() + srcFolders.size(), workingDirFolders.end());
+			*m_pCurrentWorkingDir = joinPath(dstFolders);
+		}
+	}
+
+	return true;
 }
 
-uint32_t IFileSystem::GetVDiskFreeSize()
+bool IFileSystem::CloneFile(std::string srcPath, std::string dstPath)
 {
-	return m_pFileAddressAllocator->GetFreeSpace();
+	CTraceScope trace(m_pTraceRecorder, NOISE_TRACE_OP_CLONE_FILE, srcPath + '\0' + dstPath);
+	return trace.Result(mFunction_CloneFile(srcPath, dstPath));
 }
 
-const uint32_t IFileSystem::GetNameMaxLength()
+bool IFileSystem::mFunction_CloneFile(const std::string & srcPath, const std::string & dstPath)
 {
-	return c_FileAndDirNameMaxLength;
-}
+	DEBUG_MSG("********************************");
+	DEBUG_MSG("Cloning File:" + srcPath + " to " + dstPath);
 
+	if (!mFunction_IsWritable("Clone File"))return false;
 
-/**********************************************
+	std::vector<std::string> srcFolders, dstFolders;
+	mFunction_GetPathFolders(srcPath, srcFolders);
+	mFunction_GetPathFolders(dstPath, dstFolders);
+	if (srcFolders.empty() || dstFolders.empty())
+	{
+		ERROR_MSG("FileSystem :Clone File failed. file name is empty.");
+		return false;
+	}
+	std::string srcName = srcFolders.back();
+	std::string dstName = dstFolders.back();
+	srcFolders.pop_back();
+	dstFolders.pop_back();
+	if (!mFunction_NameValidation(dstName))
+	{
+		ERROR_MSG("FileSystem :Clone File failed.");
+		return false;
+	}
 
-							PRIVATE
+	auto joinPath = [](const std::vector<std::string>& folders) ->std::string
+	{
+		std::string path = "/";
+		for (auto& folder : folders)path += folder + "/";
+		return path;
+	};
+	uint32_t srcDirINodeNum = 0, dstDirINodeNum = 0;
+	if (!mFunction_ResolveDirectory(joinPath(srcFolders), srcDirINodeNum) || !mFunction_ResolveDirectory(joinPath(dstFolders), dstDirINodeNum))
+	{
+		ERROR_MSG("FileSystem :Clone File failed. No such directory .");
+		return false;
+	}
 
-************************************************/
+	uint32_t srcIndexNodeNum = 0, existingIndexNodeNum = 0;
+	if (!mFunction_FindInDirectory(m_pIndexNodeList->at(srcDirINodeNum), srcName, false, srcIndexNodeNum))
+	{
+		ERROR_MSG("FileSystem :Clone File failed. source file not found. ");
+		return false;
+	}
+	if (mFunction_FindInDirectory(m_pIndexNodeList->at(dstDirINodeNum), dstName, false, existingIndexNodeNum))
+	{
+		ERROR_MSG("FileSystem :Clone File failed. File Name already exist.");
+		return false;
+	}
+	if (m_pFileAddressAllocator->GetFreeSpace() < mFunction_GetAllocationSize(sizeof(N_DirFileRecord)))
+	{
+		ERROR_MSG("FileSystem :Clone File failed.Not Enough space.");
+		return false;
+	}
 
-template<typename T>
-inline void IFileSystem::mFunction_ReadData(uint32_t srcOffset, T & destData)
-{
-	memcpy_s(&destData,sizeof(T), &m_pVirtualDiskImage->at(srcOffset),sizeof(T));
-}
+	uint32_t cloneINodeNum = uint32_t(m_pIndexNodeAllocator->Allocate(1));
+	if (cloneINodeNum == uint32_t(c_invalid_alloc_address))
+	{
+		ERROR_MSG("FileSystem :Clone File failed. Not Enough index nodes.");
+		return false;
+	}
 
-template<typename T>
-inline void IFileSystem::mFunction_WriteData(uint32_t destOffset, T& srcData)
-{
-	memcpy_s(&m_pVirtualDiskImage->at(destOffset), sizeof(T), &srcData, sizeof(T));
-}
+	//clone i-node refers to the same extent (inline data is simply copied)
+	N_IndexNode cloneNode = m_pIndexNodeList->at(srcIndexNodeNum);
+	cloneNode.ownerUserID = mLoggedInAccountID;
+	cloneNode.isFileOpened = false;
+	if (!cloneNode.isInline())cloneNode.flags |= NOISE_INDEX_NODE_FLAG_SHARED;
+	m_pIndexNodeList->at(cloneINodeNum) = cloneNode;
 
-bool IFileSystem::mFunction_NameValidation(const std::string & name)
-{
-	if (name.size() > 120)
+	uint32_t folderCount = 0, fileCount = 0;
+	std::vector<N_DirFileRecord> subFolders, subFiles;
+	mFunction_ReadDirectoryFile(m_pIndexNodeList->at(dstDirINodeNum), folderCount, fileCount, subFolders, subFiles);
+	subFiles.push_back(N_DirFileRecord(dstName, cloneINodeNum));
+	if (!mFunction_UpdateDirectoryFile(&m_pIndexNodeList->at(dstDirINodeNum), subFolders, subFiles))
 	{
-		ERROR_MSG("IFileSystem : the length of a name exceed max length! ");
+		m_pIndexNodeAllocator->Release(cloneINodeNum, 1);
+		m_pIndexNodeList->at(cloneINodeNum).reset();
+		ERROR_MSG("FileSystem :Clone File failed. Not Enough space.");
 		return false;
 	}
-	
-	if (name.find('\\', 0) != std::string::npos || name.find('/', 0) != std::string::npos)
+
+	if (!cloneNode.isInline())
 	{
-		ERROR_MSG("IFileSystem :  Character '\\' and '/' are not permitted in a NAME .");
-		return false;
+		m_pIndexNodeList->at(srcIndexNodeNum).flags |= NOISE_INDEX_NODE_FLAG_SHARED;
+		m_pFileAddressAllocator->AddReference(cloneNode.address);
 	}
+	if (m_pMetadataIndex != nullptr)m_pMetadataIndex->Insert(cloneINodeNum, cloneNode);
+	uint64_t fingerprint = 0;
+	if (m_pDedupIndex != nullptr && m_pDedupIndex->GetFingerprint(srcIndexNodeNum, fingerprint))m_pDedupIndex->Insert(cloneINodeNum, fingerprint);
+
+	return true;
+}
+
+bool IFileSystem::mFunction_PrepareFileWrite(IFile * pFile, uint64_t startIndex, uint64_t size)
+{
+	if (!mFunction_DecompressFile(pFile) || !mFunction_UnshareExtent(pFile))return false;
+	N_IndexNode& node = m_pIndexNodeList->at(pFile->mFileIndexNodeNumber);
+	if (!node.isInline())mFunction_PreserveSnapshot(node.address + startIndex, size);
 	return true;
 }
 
-void IFileSystem::mFunction_ReadDirectoryFile(uint32_t dirFileAddress, uint32_t & outFolderCount, uint32_t & outFileCount, std::vector<N_DirFileRecord>& outChildFolders, std::vector<N_DirFileRecord>& outChildFiles)
+bool IFileSystem::mFunction_DecompressFile(IFile * pFile)
 {
+	N_IndexNode& node = m_pIndexNodeList->at(pFile->mFileIndexNodeNumber);
+	if (!node.isCompressed())return true;
+
+	uint64_t newAddress = mFunction_AllocateFileSpace(node.size);
+	if (newAddress == c_invalid_alloc_address)return false;
+	mFunction_PreserveSnapshot(newAddress, node.size);
+	char* pNewData = &m_pVirtualDiskImage->at(size_t(mVDiskHeaderLength + newAddress));
+	const char* pExtent = mFunction_GetFileBuffer(node);
+	uint32_t chunkCount = CCompression::GetChunkCount(node.size);
+	for (uint32_t i = 0; i < chunkCount; ++i)
+	{
+		if (!CCompression::DecompressChunk(pExtent, node.storedSize, node.size, i, pNewData + uint64_t(i) * c_CompressionChunkSize))
+		{
+			ERROR_MSG("FileSystem :Decompress file failed. compressed data is broken, run fsck.");
+			mFunction_ReleaseFileSpace(newAddress, node.size);
+			return false;
+		}
+	}
 
-	mFunction_ReadData(mVDiskHeaderLength + dirFileAddress + 0, outFolderCount);
-	mFunction_ReadData(mVDiskHeaderLength + dirFileAddress + 4, outFileCount);
+	mFunction_ReleaseFileSpace(node.address, node.storedSize);
+	node.address = newAddress;
+	node.storedSize = 0;
+	node.flags &= ~uint32_t(NOISE_INDEX_NODE_FLAG_COMPRESSED | NOISE_INDEX_NODE_FLAG_SHARED);
+	pFile->m_pFileBuffer = mFunction_GetFileBuffer(node);
+	delete pFile->m_pChunkCache;
+	pFile->m_pChunkCache = nullptr;
+	return true;
+}
 
-	outChildFolders.resize(outFolderCount);
-	outChildFiles.resize(outFileCount);
+bool IFileSystem::mFunction_ReadCompressedFile(IFile * pFile, char * pOutData, uint64_t startIndex, uint64_t size)
+{
+	N_IndexNode& node = m_pIndexNodeList->at(pFile->mFileIndexNodeNumber);
+	const char* pExtent = mFunction_GetFileBuffer(node);
+	std::vector<N_DecompressedChunk>& cache = *pFile->m_pChunkCache;
+	while (size > 0)
+	{
+		uint32_t chunkIndex = uint32_t(startIndex / c_CompressionChunkSize);
+		uint64_t offsetInChunk = startIndex % c_CompressionChunkSize;
 
-	for (uint32_t i = 0; i < outFolderCount; ++i)
-		mFunction_ReadData(mVDiskHeaderLength + dirFileAddress + 8 + i * sizeof(N_DirFileRecord), outChildFolders.at(i));
+		//least recently used chunk is replaced when cache is full
+		auto pChunk = std::find_if(cache.begin(), cache.end(), [chunkIndex](const N_DecompressedChunk& c) {return c.chunkIndex == chunkIndex; });
+		if (pChunk == cache.end())
+		{
+			if (cache.size() < c_DecompressedChunkCacheSize)pChunk = cache.insert(cache.end(), N_DecompressedChunk());
+			else pChunk = std::min_element(cache.begin(), cache.end(), [](const N_DecompressedChunk& a, const N_DecompressedChunk& b) {return a.lastUseTime < b.lastUseTime; });
+			pChunk->chunkIndex = chunkIndex;
+			pChunk->data.resize(size_t(std::min<uint64_t>(c_CompressionChunkSize, node.size - uint64_t(chunkIndex) * c_CompressionChunkSize)));
+			if (!CCompression::DecompressChunk(pExtent, node.storedSize, node.size, chunkIndex, &pChunk->data.at(0)))
+			{
+				cache.erase(pChunk);
+				return false;
+			}
+		}
+		pChunk->lastUseTime = ++pFile->mChunkUseTime;
 
-	for (uint32_t i = 0; i < outFileCount; ++i)
-		mFunction_ReadData(mVDiskHeaderLength + dirFileAddress + 8 + (i + outFolderCount) * sizeof(N_DirFileRecord), outChildFiles.at(i));
+		uint64_t copySize = std::min<uint64_t>(size, pChunk->data.size() - offsetInChunk);
+		memcpy(pOutData, &pChunk->data.at(size_t(offsetInChunk)), size_t(copySize));
+		pOutData += copySize;
+		startIndex += copySize;
+		size -= copySize;
+	}
+	return true;
 }
 
-void IFileSystem::mFunction_WriteDirectoryFile(uint32_t dirFileAddress, uint32_t inFolderCount, uint32_t inFileCount, std::vector<N_DirFileRecord>& inChildFolders, std::vector<N_DirFileRecord>& inChildFiles)
+void IFileSystem::mFunction_PrefetchFile(IFile * pFile, uint64_t startIndex, uint64_t size)
 {
-	mFunction_WriteData(mVDiskHeaderLength + dirFileAddress + 0, inFolderCount);
-	mFunction_WriteData(mVDiskHeaderLength + dirFileAddress + 4, inFileCount);
-
-	for (uint32_t i = 0; i < inFolderCount; ++i)
-		mFunction_WriteData(mVDiskHeaderLength + dirFileAddress + 8 + i * sizeof(N_DirFileRecord), inChildFolders.at(i));
+	//only extents of a mapped image may not be in memory (compressed chunks are decompressed on read)
+	N_IndexNode& node = m_pIndexNodeList->at(pFile->mFileIndexNodeNumber);
+	if (node.isInline() || pFile->m_pChunkCache != nullptr)return;
+	m_pVirtualDiskImage->Prefetch(mVDiskHeaderLength + node.address + startIndex, size);
+}
 
-	for (uint32_t i = 0; i < inFileCount; ++i)
-		mFunction_WriteData(mVDiskHeaderLength + dirFileAddress + 8 + (i + inFolderCount) * sizeof(N_DirFileRecord), inChildFiles.at(i));
+void IFileSystem::mFunction_DeduplicateFile(uint32_t fileIndexNodeNum, CDedupIndex & index, N_DedupReport & report)
+{
+	//opened files keep a pointer to their extent, inline files have no extent
+	N_IndexNode& node = m_pIndexNodeList->at(fileIndexNodeNum);
+	if (node.isFileOpened || node.isInline() || node.isCompressed() || node.size == 0)return;
+
+	const char* pData = mFunction_GetFileBuffer(node);
+	uint64_t fingerprint = CDedupIndex::Hash(pData, node.size);
+	++report.scannedFileCount;
+	report.hashedBytes += node.size;
+
+	//equal fingerprint is only a hint, data is compared
+	std::vector<uint32_t> candidates;
+	index.GetCandidates(fingerprint, candidates);
+	for (uint32_t candidateNum : candidates)
+	{
+		N_IndexNode& candidate = m_pIndexNodeList->at(candidateNum);
+		if (candidateNum == fileIndexNodeNum || candidate.isInline() || candidate.isCompressed() || candidate.size != node.size)continue;
+		if (candidate.address == node.address)break;//shared already
+		if (memcmp(mFunction_GetFileBuffer(candidate), pData, size_t(node.size)) != 0)continue;
+
+		//extent is released (the last reference frees it), then the candidate's one is shared
+		if (m_pFileAddressAllocator->GetReferenceCount(node.address) == 1)report.savedBytes += mFunction_GetAllocationSize(node.size);
+		mFunction_ReleaseFileSpace(node.address, node.size);
+		node.address = candidate.address;
+		node.flags |= NOISE_INDEX_NODE_FLAG_SHARED;
+		candidate.flags |= NOISE_INDEX_NODE_FLAG_SHARED;
+		m_pFileAddressAllocator->AddReference(candidate.address);
+		++report.dedupedFileCount;
+		break;
+	}
+	index.Insert(fileIndexNodeNum, fingerprint);
 }
 
-void IFileSystem::mFunction_ReleaseFileSpace(uint32_t fileIndexNodeNum)
+bool IFileSystem::mFunction_ResolveParent(const std::string & path, uint32_t & outDirIndexNodeId, std::string & outName)
 {
-	//release file storage and index node
-	N_IndexNode* pFileINode = &m_pIndexNodeList->at(fileIndexNodeNum);
-	m_pFileAddressAllocator->Release(pFileINode->address, pFileINode->size);
-	m_pIndexNodeAllocator->Release(fileIndexNodeNum, 1);
-	pFileINode->reset();
+	std::vector<std::string> folders;
+	mFunction_GetPathFolders(path, folders);
+	if (folders.empty())return false;
+	outName = folders.back();
+	folders.pop_back();
+
+	std::string dir = "/";
+	for (auto& folder : folders)dir += folder + "/";
+	return mFunction_ResolveDirectory(dir, outDirIndexNodeId);
 }
 
-bool IFileSystem::mFunction_RecursiveFolderDelete(uint32_t dirFileIndexNodeNum)
+bool IFileSystem::mFunction_ResolveFolderPath(const std::string & path, uint32_t & outIndexNodeId)
 {
-	//desc : delete all child-folders and files under this folder including the folder itself
+	std::vector<std::string> folders;
+	mFunction_GetPathFolders(path, folders);
 
-	uint32_t folderCount = 0, fileCount = 0;
-	std::vector<N_DirFileRecord> subFolderINT;//i-node number list
-	std::vector<N_DirFileRecord> subFilesINT;//i-node number list
-	N_IndexNode* pNode = &m_pIndexNodeList->at(dirFileIndexNodeNum);
+	std::string dir = "/";
+	for (auto& folder : folders)dir += folder + "/";
+	return mFunction_ResolveDirectory(dir, outIndexNodeId);
+}
 
-	mFunction_ReadDirectoryFile(pNode->address, folderCount, fileCount, subFilesINT, subFilesINT);
+bool IFileSystem::mFunction_RunInDirectory(uint32_t dirIndexNodeId, const std::function<bool()>& operation)
+{
+	N_IndexNode* pWorkingDirINode = m_pCurrentDirIndexNode;
+	m_pCurrentDirIndexNode = &m_pIndexNodeList->at(dirIndexNodeId);
+	bool result = operation();
+	m_pCurrentDirIndexNode = pWorkingDirINode;
+	return result;
+}
 
-	//delete files under current directory
-	for (auto& existingChildFiles : subFilesINT)
+bool IFileSystem::mFunction_ImportEntry(uint32_t dirIndexNodeId, const std::string & name, bool isFolder, uint64_t byteSize, uint32_t & outIndexNodeId)
+{
+	bool isCreated = mFunction_RunInDirectory(dirIndexNodeId, [&]()
 	{
-		uint32_t fileINodeNum = existingChildFiles.indexNodeId;
-		N_IndexNode* pINode = &m_pIndexNodeList->at(fileINodeNum);
-		//if an opened file is found
-		if (pINode->isFileOpened)
-		{
-			DEBUG_MSG("IFileSystem :Delete folder failed. a file under this folder is opened. Deletion procedure terminated.");
-			DEBUG_MSG("IFileSystem :Opened file name:" << existingChildFiles.name);
-			return false;
-		}
+		return isFolder ? mFunction_CreateFolder(name) : mFunction_CreateFile(name, byteSize, NOISE_FILE_ACCESS_MODE_OWNER_RW);
+	});
+	if (!isCreated || !mFunction_FindInDirectory(m_pIndexNodeList->at(dirIndexNodeId), name, isFolder, outIndexNodeId))
+	{
+		ERROR_MSG("FileSystem :Import failed. " << name << " can't be created.");
+		return false;
+	}
+
+	//(new extent is about to be written)
+	N_IndexNode& node = m_pIndexNodeList->at(outIndexNodeId);
+	if (!isFolder && !node.isInline())mFunction_PreserveSnapshot(node.address, byteSize);
+	return true;
+}
 
-		mFunction_ReleaseFileSpace(fileINodeNum);
+bool IFileSystem::mFunction_CreateSubtree(const std::vector<N_ArchiveEntry>& entries, const std::vector<std::string>& names, std::vector<uint32_t>& outINodeNums, std::vector<N_AddressRange>& outAllocatedRanges, bool & outIsContiguous)
+{
+	outINodeNums.clear();
+	outAllocatedRanges.clear();
+	outIsContiguous = false;
+	if (m_pIndexNodeAllocator->GetFreeSpace() < entries.size())
+	{
+		ERROR_MSG("FileSystem :Import failed. Not Enough index nodes.");
+		return false;
 	}
+	for (size_t i = 0; i < entries.size(); ++i)outINodeNums.push_back(uint32_t(m_pIndexNodeAllocator->Allocate(1)));
 
-	for (auto& existingChildFolder : subFolderINT)
+	std::vector<std::vector<N_DirFileRecord>> childFolders(entries.size());
+	std::vector<std::vector<N_DirFileRecord>> childFiles(entries.size());
+	for (size_t i = 1; i < entries.size(); ++i)
 	{
-		uint32_t dirFileINodeNum = existingChildFolder.indexNodeId;
+		N_DirFileRecord record(names[i], outINodeNums[i]);
+		(entries[i].isFolder() ? childFolders : childFiles).at(entries[i].parentEntry).push_back(record);
+	}
 
-		//recursive  deletion
-		mFunction_RecursiveFolderDelete(dirFileINodeNum);
-		
+	//extents are laid out as one run : file data in entry order (as it is streamed), then directory files
+	auto isInlineEntry = [](const N_ArchiveEntry& entry) {return !entry.isFolder() && !entry.isCompressed() && entry.size <= c_IndexNodeInlineDataMaxSize; };
+	std::vector<uint64_t> extentSizes(entries.size(), 0);
+	std::vector<uint64_t> extentAddresses(entries.size(), 0);
+	std::vector<uint32_t> extentOrder;
+	for (size_t i = 0; i < entries.size(); ++i)
+		if (!entries[i].isFolder() && !isInlineEntry(entries[i]))extentOrder.push_back(uint32_t(i));
+	for (size_t i = 0; i < entries.size(); ++i)
+		if (entries[i].isFolder())extentOrder.push_back(uint32_t(i));
+	uint64_t runSize = 0;
+	for (uint32_t i : extentOrder)
+	{
+		extentSizes[i] = entries[i].isFolder() ? mFunction_GetDirectoryFileSize(childFolders[i], childFiles[i]) : entries[i].storedSize;
+		runSize += mFunction_GetAllocationSize(extentSizes[i]);
+	}
 
-		mFunction_ReleaseFileSpace(dirFileINodeNum);
+	uint64_t runAddress = m_pFileAddressAllocator->Allocate(runSize);
+	outIsContiguous = (runAddress != c_invalid_alloc_address);
+	if (outIsContiguous)
+	{
+		outAllocatedRanges.push_back(N_AddressRange(runAddress, runSize));
+		for (uint32_t i : extentOrder)
+		{
+			extentAddresses[i] = runAddress;
+			runAddress += mFunction_GetAllocationSize(extentSizes[i]);
+		}
 	}
-		
-	mFunction_ReleaseFileSpace(dirFileIndexNodeNum);
+	else
+	{
+		//(user space is fragmented) extents are allocated one by one
+		for (uint32_t i : extentOrder)
+		{
+			extentAddresses[i] = mFunction_AllocateFileSpace(extentSizes[i]);
+			if (extentAddresses[i] == c_invalid_alloc_address)
+			{
+				mFunction_ReleaseSubtree(outINodeNums, outAllocatedRanges);
+				ERROR_MSG("FileSystem :Import failed. Not Enough space.");
+				return false;
+			}
+			outAllocatedRanges.push_back(N_AddressRange(extentAddresses[i], extentSizes[i]));
+		}
+	}
+	for (uint32_t i : extentOrder)mFunction_PreserveSnapshot(extentAddresses[i], extentSizes[i]);
 
+	//i-nodes & directory files of the detached subtree
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		N_IndexNode node;
+		node.accessMode = entries[i].accessMode;
+		node.ownerUserID = entries[i].ownerUserID;
+		node.size = entries[i].isFolder() ? extentSizes[i] : entries[i].size;
+		if (isInlineEntry(entries[i]))node.flags |= NOISE_INDEX_NODE_FLAG_INLINE;
+		else node.address = extentAddresses[i];
+		if (entries[i].isCompressed())
+		{
+			node.flags |= NOISE_INDEX_NODE_FLAG_COMPRESSED;
+			node.storedSize = entries[i].storedSize;
+		}
+		m_pIndexNodeList->at(outINodeNums[i]) = node;
+		if (entries[i].isFolder())
+			mFunction_WriteDirectoryFile(extentAddresses[i], uint32_t(childFolders[i].size()), uint32_t(childFiles[i].size()), childFolders[i], childFiles[i]);
+	}
 	return true;
 }
 
+void IFileSystem::mFunction_ReleaseSubtree(std::vector<uint32_t>& iNodeNums, std::vector<N_AddressRange>& allocatedRanges)
+{
+	for (auto& range : allocatedRanges)mFunction_ReleaseFileSpace(range.start, range.size);
+	for (uint32_t iNodeNum : iNodeNums)
+	{
+		m_pIndexNodeAllocator->Release(iNodeNum, 1);
+		m_pIndexNodeList->at(iNodeNum).reset();
+	}
+	iNodeNums.clear();
+	allocatedRanges.clear();
+}
+
+bool IFileSystem::mFunction_LinkSubtree(uint32_t parentINodeNum, const std::string & dirName, const std::vector<N_ArchiveEntry>& entries, const std::vector<uint32_t>& iNodeNums)
+{
+	uint32_t folderCount = 0, fileCount = 0;
+	std::vector<N_DirFileRecord> subFolderINT;
+	std::vector<N_DirFileRecord> subFilesINT;
+	N_IndexNode* pParentINode = &m_pIndexNodeList->at(parentINodeNum);
+	mFunction_ReadDirectoryFile(*pParentINode, folderCount, fileCount, subFolderINT, subFilesINT);
+	subFolderINT.push_back(N_DirFileRecord(dirName, iNodeNums[0]));
+	if (!mFunction_UpdateDirectoryFile(pParentINode, subFolderINT, subFilesINT))return false;
+
+	if (m_pMetadataIndex != nullptr)
+	{
+		for (size_t i = 1; i < entries.size(); ++i)
+			if (!entries[i].isFolder())m_pMetadataIndex->Insert(iNodeNums[i], m_pIndexNodeList->at(iNodeNums[i]));
+	}
+	return true;
+}
+
+void IFileSystem::mFunction_PreserveSnapshot(uint64_t address, uint64_t size)
+{
+	if (m_pSnapshot != nullptr)m_pSnapshot->PreserveBlocks(address, size, &m_pVirtualDiskImage->at(size_t(mVDiskHeaderLength)));
+}
+
+bool IFileSystem::mFunction_UnshareExtent(IFile * pFile)
+{
+	N_IndexNode& node = m_pIndexNodeList->at(pFile->mFileIndexNodeNumber);
+	if (!(node.flags & NOISE_INDEX_NODE_FLAG_SHARED))return true;
+
+	//the last holder of a shared extent owns it alone
+	if (node.isInline() || m_pFileAddressAllocator->GetReferenceCount(node.address) == 1)
+	{
+		node.flags &= ~uint32_t(NOISE_INDEX_NODE_FLAG_SHARED);
+		return true;
+	}
+
+	uint64_t newAddress = mFunction_AllocateFileSpace(node.extentSize());
+	if (newAddress == c_invalid_alloc_address)return false;
+	mFunction_PreserveSnapshot(newAddress, node.extentSize());
+	memcpy(&m_pVirtualDiskImage->at(size_t(mVDiskHeaderLength + newAddress)), mFunction_GetFileBuffer(node), size_t(node.extentSize()));
+	m_pFileAddressAllocator->Release(node.address, mFunction_GetAllocationSize(node.extentSize()));//(only a reference is dropped)
+	node.address = newAddress;
+	node.flags &= ~uint32_t(NOISE_INDEX_NODE_FLAG_SHARED);
+	pFile->m_pFileBuffer = mFunction_GetFileBuffer(node);
+	return true;
+}
+
+void IFileSystem::mFunction_GetPathFolders(const std::string & path, std::vector<std::string>& outFolders)
+{
+	auto isDelim = [](char c) ->bool {return c == '\\' || c == '/'; };
+	std::string fullPath = (!path.empty() && isDelim(path.at(0))) ? path : (*m_pCurrentWorkingDir + "/" + path);
+
+	outFolders.clear();
+	std::string folderName;
+	for (char c : fullPath)
+	{
+		if (!isDelim(c))
+		{
+			folderName.push_back(c);
+			continue;
+		}
+		if (!folderName.empty())outFolders.push_back(folderName);
+		folderName.clear();
+	}
+	if (!folderName.empty())outFolders.push_back(folderName);
+}
+
+bool IFileSystem::CloseFile(IFile * pFile)
+{
+	CTraceScope trace(m_pTraceRecorder, NOISE_TRACE_OP_CLOSE_FILE, "", 0, 0, pFile == nullptr ? 0 : pFile->mTraceFileHandle);
+	return trace.Result(mFunction_CloseFile(pFile));
+}
+
+bool IFileSystem::mFunction_CloseFile(IFile * pFile)
+{
+	if (pFile == nullptr)
+	{
+		ERROR_MSG("FileSystem : Close file failed. file pointer is null.");
+		return false;
+	}
+
+	DEBUG_MSG("********************************");
+	DEBUG_MSG("Closing File : index number = " << pFile->mFileIndexNodeNumber);
+
+	pFile->mIsFileOpened = false;
+
+	N_IndexNode* pINode = &m_pIndexNodeList->at(pFile->mFileIndexNodeNumber);
+	pINode->isFileOpened = false;
+	if (m_pDedupIndex != nullptr && !mIsVDiskReadOnly)
+	{
+		N_DedupReport report;
+		mFunction_DeduplicateFile(pFile->mFileIndexNodeNumber, *m_pDedupIndex, report);
+		m_pDedupIndex->AddToReport(report);
+	}
+
+	IFactory<IFile>::DestroyObject(pFile);
+
+	return true;
+}
+
+bool IFileSystem::ImportFile(NFilePath hostFilePath, std::string filePath)
+{
+	CTraceScope trace(m_pTraceRecorder, NOISE_TRACE_OP_IMPORT_FILE, hostFilePath + '\0' + filePath);
+	return trace.Result(mFunction_ImportFile(hostFilePath, filePath));
+}
+
+bool IFileSystem::mFunction_ImportFile(const NFilePath & hostFilePath, const std::string & filePath)
+{
+	DEBUG_MSG("********************************");
+	DEBUG_MSG("Importing File:" + hostFilePath + " to " + filePath);
+
+	if (!mIsVDiskInitialized)
+	{
+		ERROR_MSG("FileSystem :Import File failed. virtual disk was not installed.");
+		return false;
+	}
+	if (!mFunction_IsWritable("Import File"))return false;
+
+	std::ifstream hostFile(hostFilePath.c_str(), std::ios::binary | std::ios::ate);
+	if (!hostFile.is_open())
+	{
+		ERROR_MSG("FileSystem :Import File failed. host file can't be opened.");
+		return false;
+	}
+	uint64_t fileSize = uint64_t(hostFile.tellg());
+	hostFile.close();
+
+	uint32_t dirINodeNum = 0, fileINodeNum = 0;
+	std::string fileName;
+	if (!mFunction_ResolveParent(filePath, dirINodeNum, fileName))
+	{
+		ERROR_MSG("FileSystem :Import File failed. No such directory .");
+		return false;
+	}
+	if (!mFunction_ImportEntry(dirINodeNum, fileName, false, fileSize, fileINodeNum))return false;
+
+	N_IndexNode& node = m_pIndexNodeList->at(fileINodeNum);
+	std::vector<N_HostFileTransfer> transfers(1, N_HostFileTransfer(&hostFilePath, mFunction_GetFileBuffer(node), 0, fileSize));
+	if (!CHostFile::ParallelTransfer(transfers, false))
+	{
+		mFunction_RunInDirectory(dirINodeNum, [&]() {return mFunction_DeleteFile(fileName); });
+		ERROR_MSG("FileSystem :Import File failed. host file can't be read.");
+		return false;
+	}
+	return true;
+}
+
+bool IFileSystem::ExportFile(std::string filePath, NFilePath hostFilePath)
+{
+	CTraceScope trace(m_pTraceRecorder, NOISE_TRACE_OP_EXPORT_FILE, filePath + '\0' + hostFilePath);
+	return trace.Result(mFunction_ExportFile(filePath, hostFilePath));
+}
+
+bool IFileSystem::mFunction_ExportFile(const std::string & filePath, const NFilePath & hostFilePath)
+{
+	DEBUG_MSG("********************************");
+	DEBUG_MSG("Exporting File:" + filePath + " to " + hostFilePath);
+
+	if (!mIsVDiskInitialized)
+	{
+		ERROR_MSG("FileSystem :Export File failed. virtual disk was not installed.");
+		return false;
+	}
+
+	uint32_t dirINodeNum = 0, fileINodeNum = 0;
+	std::string fileName;
+	if (!mFunction_ResolveParent(filePath, dirINodeNum, fileName) ||
+		!mFunction_FindInDirectory(m_pIndexNodeList->at(dirINodeNum), fileName, false, fileINodeNum))
+	{
+		ERROR_MSG("FileSystem :Export File failed. file not found. ");
+		return false;
+	}
+	N_IndexNode& node = m_pIndexNodeList->at(fileINodeNum);
+
+	//compressed file is decompressed first, other data is written right from image
+	std::vector<char> decompressedData;
+	char* pData = mFunction_GetFileBuffer(node);
+	if (node.isCompressed())
+	{
+		decompressedData.resize(size_t(node.size));
+		for (uint32_t chunkIndex = 0; uint64_t(chunkIndex) * c_CompressionChunkSize < node.size; ++chunkIndex)
+		{
+			if (!CCompression::DecompressChunk(pData, node.storedSize, node.size, chunkIndex, &decompressedData.at(size_t(chunkIndex) * c_CompressionChunkSize)))
+			{
+				ERROR_MSG("FileSystem :Export File failed. compressed data is broken, run fsck.");
+				return false;
+			}
+		}
+		pData = decompressedData.empty() ? nullptr : &decompressedData.at(0);
+	}
+
+	//host file is created (or cut) before data is written in place
+	std::ofstream hostFile(hostFilePath.c_str(), std::ios::binary | std::ios::trunc);
+	if (!hostFile.is_open())
+	{
+		ERROR_MSG("FileSystem :Export File failed. host file can't be created.");
+		return false;
+	}
+	hostFile.close();
+
+	std::vector<N_HostFileTransfer> transfers(1, N_HostFileTransfer(&hostFilePath, pData, 0, node.size));
+	if (!CHostFile::ParallelTransfer(transfers, true))
+	{
+		ERROR_MSG("FileSystem :Export File failed. host file can't be written.");
+		return false;
+	}
+	return true;
+}
+
+bool IFileSystem::ImportDirectory(NFilePath hostDirPath, std::string dirPath)
+{
+	CTraceScope trace(m_pTraceRecorder, NOISE_TRACE_OP_IMPORT_DIRECTORY, hostDirPath + '\0' + dirPath);
+	return trace.Result(mFunction_ImportDirectory(hostDirPath, dirPath));
+}
+
+bool IFileSystem::mFunction_ImportDirectory(const NFilePath & hostDirPath, const std::string & dirPath)
+{
+	DEBUG_MSG("********************************");
+	DEBUG_MSG("Importing Folder:" + hostDirPath + " to " + dirPath);
+
+	if (!mIsVDiskInitialized)
+	{
+		ERROR_MSG("FileSystem :Import Folder failed. virtual disk was not installed.");
+		return false;
+	}
+	if (!mFunction_IsWritable("Import Folder"))return false;
+
+	uint32_t parentINodeNum = 0, existingINodeNum = 0;
+	std::string dirName;
+	if (!mFunction_ResolveParent(dirPath, parentINodeNum, dirName) || !mFunction_NameValidation(dirName))
+	{
+		ERROR_MSG("FileSystem :Import Folder failed. No such directory .");
+		return false;
+	}
+	if (mFunction_FindInDirectory(m_pIndexNodeList->at(parentINodeNum), dirName, true, existingINodeNum))
+	{
+		ERROR_MSG("FileSystem :Import Folder failed. Folder already exist.");
+		return false;
+	}
+
+	//the host tree is listed first (folder by folder, a parent comes before its children),
+	//then it's built at once like an imported archive
+	std::vector<N_ArchiveEntry> entries(1);
+	std::vector<std::string> names(1, dirName);
+	std::vector<NFilePath> hostPaths(1, hostDirPath);
+	entries[0].flags = NOISE_ARCHIVE_ENTRY_FLAG_FOLDER;
+	entries[0].accessMode = NOISE_FILE_ACCESS_MODE_OWNER_RW;
+	entries[0].ownerUserID = NOISE_FILE_OWNER_ROOT;
+	std::vector<N_HostDirEntry> hostEntries;
+	uint32_t folderCount = 0;
+	uint64_t byteCount = 0;
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		if (!entries[i].isFolder())continue;
+		if (!CHostFile::ListDirectory(hostPaths[i], hostEntries))
+		{
+			ERROR_MSG("FileSystem :Import Folder failed. host folder can't be read.");
+			return false;
+		}
+		for (auto& hostEntry : hostEntries)
+		{
+			if (!mFunction_NameValidation(hostEntry.name))
+			{
+				ERROR_MSG("FileSystem :Import Folder failed. " << hostEntry.name << " can't be imported.");
+				return false;
+			}
+			N_ArchiveEntry entry;
+			entry.parentEntry = uint32_t(i);
+			entry.flags = hostEntry.isFolder ? NOISE_ARCHIVE_ENTRY_FLAG_FOLDER : 0;
+			entry.size = hostEntry.isFolder ? 0 : hostEntry.size;
+			entry.storedSize = entry.size;
+			entry.accessMode = NOISE_FILE_ACCESS_MODE_OWNER_RW;
+			entry.ownerUserID = hostEntry.isFolder ? uint8_t(NOISE_FILE_OWNER_ROOT) : mLoggedInAccountID;
+			entry.nameLength = uint8_t(hostEntry.name.size());
+			entries.push_back(entry);
+			names.push_back(hostEntry.name);
+			hostPaths.push_back(hostPaths[i] + "/" + hostEntry.name);
+			if (hostEntry.isFolder)++folderCount;
+			else byteCount += entry.size;
+		}
+	}
+
+	//nothing is linked into the tree till the end, so a failure only gives back what is allocated
+	std::vector<uint32_t> entryINodeNums;
+	std::vector<N_AddressRange> allocatedRanges;
+	bool isContiguous = false;
+	if (!mFunction_CreateSubtree(entries, names, entryINodeNums, allocatedRanges, isContiguous))
+	{
+		ERROR_MSG("FileSystem :Import Folder failed.");
+		return false;
+	}
+
+	//then data of every file is read at once
+	std::vector<N_HostFileTransfer> transfers;
+	for (size_t i = 1; i < entries.size(); ++i)
+	{
+		if (entries[i].isFolder())continue;
+		N_IndexNode& node = m_pIndexNodeList->at(entryINodeNums[i]);
+		transfers.push_back(N_HostFileTransfer(&hostPaths[i], mFunction_GetFileBuffer(node), 0, node.size));
+	}
+	if (!CHostFile::ParallelTransfer(transfers, false))
+	{
+		mFunction_ReleaseSubtree(entryINodeNums, allocatedRanges);
+		ERROR_MSG("FileSystem :Import Folder failed. host files can't be read.");
+		return false;
+	}
+
+	//the subtree is linked to its parent at last
+	if (!mFunction_LinkSubtree(parentINodeNum, dirName, entries, entryINodeNums))
+	{
+		mFunction_ReleaseSubtree(entryINodeNums, allocatedRanges);
+		ERROR_MSG("FileSystem :Import Folder failed. Not Enough space.");
+		return false;
+	}
+
+	DEBUG_MSG("Import Folder : " << folderCount << " folders, " << transfers.size() << " files, " << byteCount << " bytes imported" << (isContiguous ? " into one contiguous run." : "."));
+	return true;
+}
+
+bool IFileSystem::ExportArchive(std::string dirPath, NFilePath archivePath)
+{
+	CTraceScope trace(m_pTraceRecorder, NOISE_TRACE_OP_EXPORT_ARCHIVE, dirPath + '\0' + archivePath);
+	return trace.Result(mFunction_ExportArchive(dirPath, archivePath));
+}
+
+bool IFileSystem::mFunction_ExportArchive(const std::string & dirPath, const NFilePath & archivePath)
+{
+	DEBUG_MSG("********************************");
+	DEBUG_MSG("Exporting Archive:" + dirPath + " to " + archivePath);
+
+	if (!mIsVDiskInitialized)
+	{
+		ERROR_MSG("FileSystem :Export Archive failed. virtual disk was not installed.");
+		return false;
+	}
+
+	uint32_t rootINodeNum = 0;
+	if (!mFunction_ResolveFolderPath(dirPath, rootINodeNum))
+	{
+		ERROR_MSG("FileSystem :Export Archive failed. No such directory .");
+		return false;
+	}
+
+	//entries in breadth-first order (a parent comes before its children), with their i-nodes
+	std::vector<std::string> folders;
+	mFunction_GetPathFolders(dirPath, folders);
+	N_ArchiveHeader header;
+	std::vector<N_ArchiveEntry> entries;
+	std::vector<uint32_t> entryINodeNums;
+	std::string nameArea;
+	auto addEntry = [&](uint32_t parentEntry, const char* pName, uint32_t indexNodeNum, bool isFolder)
+	{
+		const N_IndexNode& node = m_pIndexNodeList->at(indexNodeNum);
+		N_ArchiveEntry entry;
+		entry.parentEntry = parentEntry;
+		entry.flags = isFolder ? NOISE_ARCHIVE_ENTRY_FLAG_FOLDER : (node.isCompressed() ? NOISE_ARCHIVE_ENTRY_FLAG_COMPRESSED : 0);
+		entry.size = isFolder ? 0 : node.size;
+		entry.storedSize = isFolder ? 0 : node.extentSize();
+		entry.accessMode = node.accessMode;
+		entry.ownerUserID = node.ownerUserID;
+		entry.nameLength = uint8_t(strnlen(pName, c_FileAndDirNameMaxLength));
+		nameArea.append(pName, entry.nameLength);
+		header.dataSize += entry.storedSize;
+		entries.push_back(entry);
+		entryINodeNums.push_back(indexNodeNum);
+	};
+	addEntry(0, folders.empty() ? "" : folders.back().c_str(), rootINodeNum, true);
+
+	uint32_t folderCount = 0, fileCount = 0;
+	std::vector<N_DirFileRecord> subFolderINT;
+	std::vector<N_DirFileRecord> subFilesINT;
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		if (!entries[i].isFolder())continue;
+		if (!mFunction_ReadDirectoryFile(m_pIndexNodeList->at(entryINodeNums[i]), folderCount, fileCount, subFolderINT, subFilesINT))
+		{
+			ERROR_MSG("FileSystem :Export Archive failed. directory file is broken, run fsck.");
+			return false;
+		}
+		for (auto& folder : subFolderINT)addEntry(uint32_t(i), folder.name, folder.indexNodeId, true);
+		for (auto& file : subFilesINT)addEntry(uint32_t(i), file.name, file.indexNodeId, false);
+	}
+	header.entryCount = uint32_t(entries.size());
+	header.nameAreaSize = uint32_t(nameArea.size());
+
+	//metadata, then data of files right from their extents
+	CArchiveWriter writer;
+	if (!writer.Open(archivePath))
+	{
+		ERROR_MSG("FileSystem :Export Archive failed. archive file can't be created.");
+		return false;
+	}
+	bool isWritten = writer.Write(reinterpret_cast<char*>(&header), sizeof(header)) &&
+		writer.Write(reinterpret_cast<char*>(&entries.at(0)), entries.size() * sizeof(N_ArchiveEntry)) &&
+		writer.Write(nameArea.c_str(), nameArea.size());
+	for (size_t i = 1; i < entries.size() && isWritten; ++i)
+	{
+		if (entries[i].isFolder())continue;
+		isWritten = writer.Write(mFunction_GetFileBuffer(m_pIndexNodeList->at(entryINodeNums[i])), entries[i].storedSize);
+	}
+	if (!writer.Close() || !isWritten)
+	{
+		std::remove(archivePath.c_str());
+		ERROR_MSG("FileSystem :Export Archive failed. archive file can't be written.");
+		return false;
+	}
+
+	DEBUG_MSG("Export Archive : " << entries.size() << " entries, " << header.dataSize << " bytes of data archived.");
+	return true;
+}
+
+bool IFileSystem::ImportArchive(NFilePath archivePath, std::string dirPath)
+{
+	CTraceScope trace(m_pTraceRecorder, NOISE_TRACE_OP_IMPORT_ARCHIVE, archivePath + '\0' + dirPath);
+	return trace.Result(mFunction_ImportArchive(archivePath, dirPath));
+}
+
+bool IFileSystem::mFunction_ImportArchive(const NFilePath & archivePath, const std::string & dirPath)
+{
+	DEBUG_MSG("********************************");
+	DEBUG_MSG("Importing Archive:" + archivePath + " to " + dirPath);
+
+	if (!mIsVDiskInitialized)
+	{
+		ERROR_MSG("FileSystem :Import Archive failed. virtual disk was not installed.");
+		return false;
+	}
+	if (!mFunction_IsWritable("Import Archive"))return false;
+
+	uint32_t parentINodeNum = 0, existingINodeNum = 0;
+	std::string dirName;
+	if (!mFunction_ResolveParent(dirPath, parentINodeNum, dirName) || !mFunction_NameValidation(dirName))
+	{
+		ERROR_MSG("FileSystem :Import Archive failed. No such directory .");
+		return false;
+	}
+	if (mFunction_FindInDirectory(m_pIndexNodeList->at(parentINodeNum), dirName, true, existingINodeNum))
+	{
+		ERROR_MSG("FileSystem :Import Archive failed. Folder already exist.");
+		return false;
+	}
+
+	//metadata of the whole subtree is read (and checked) first
+	CArchiveReader reader;
+	if (!reader.Open(archivePath))
+	{
+		ERROR_MSG("FileSystem :Import Archive failed. archive file can't be opened.");
+		return false;
+	}
+	N_ArchiveHeader header;
+	std::vector<N_ArchiveEntry> entries;
+	std::string nameArea;
+	bool isValid = reader.Read(reinterpret_cast<char*>(&header), sizeof(header)) &&
+		header.magicNumber == c_ArchiveMagicNumber && header.versionNumber == c_ArchiveVersion &&
+		header.entryCount != 0 && header.entryCount <= m_pIndexNodeList->size() &&
+		uint64_t(header.nameAreaSize) <= uint64_t(header.entryCount) * c_FileAndDirNameMaxLength;
+	if (isValid)
+	{
+		entries.resize(header.entryCount);
+		nameArea.resize(header.nameAreaSize);
+		isValid = reader.Read(reinterpret_cast<char*>(&entries.at(0)), entries.size() * sizeof(N_ArchiveEntry)) &&
+			reader.Read(&nameArea[0], nameArea.size());
+	}
+
+	//(a name must be valid and unique among folders or files of its parent, nothing is allocated yet)
+	std::vector<std::string> names(entries.size());
+	std::unordered_set<std::string> childNames;//parent entry + kind + name
+	uint64_t nameAreaSize = 0, dataSize = 0;
+	for (size_t i = 0; i < entries.size() && isValid; ++i)
+	{
+		const N_ArchiveEntry& entry = entries[i];
+		uint64_t nameOffset = nameAreaSize;
+		nameAreaSize += entry.nameLength;
+		dataSize += entry.storedSize;
+		bool isParentValid = (i == 0) || (entry.parentEntry < i && entries[entry.parentEntry].isFolder());
+		bool isNameValid = (i == 0) || (entry.nameLength != 0 && nameAreaSize <= nameArea.size());
+		if (i != 0 && isNameValid)
+		{
+			names[i] = nameArea.substr(size_t(nameOffset), entry.nameLength);
+			isNameValid = mFunction_NameValidation(names[i]) &&
+				childNames.insert(std::to_string(entry.parentEntry) + (entry.isFolder() ? '/' : ':') + names[i]).second;
+		}
+		bool isSizeValid = entry.isFolder() ? (entry.size == 0 && entry.storedSize == 0 && !entry.isCompressed()) :
+			(entry.isCompressed() ? entry.storedSize != 0 : entry.storedSize == entry.size);
+		isValid = isParentValid && isNameValid && isSizeValid && entry.ownerUserID != NOISE_FILE_OWNER_NULL;//(NULL owner is a free i-node)
+	}
+	if (!isValid || !entries[0].isFolder() || nameAreaSize != header.nameAreaSize || dataSize != header.dataSize)
+	{
+		ERROR_MSG("FileSystem :Import Archive failed. archive is broken.");
+		return false;
+	}
+
+	//nothing is linked into the tree till the end, so a failure only gives back what is allocated
+	std::vector<uint32_t> entryINodeNums;
+	std::vector<N_AddressRange> allocatedRanges;
+	bool isContiguous = false;
+	if (!mFunction_CreateSubtree(entries, names, entryINodeNums, allocatedRanges, isContiguous))
+	{
+		ERROR_MSG("FileSystem :Import Archive failed.");
+		return false;
+	}
+
+	//data is streamed into extents in entry order (one sequential read of archive)
+	bool isRead = true;
+	for (size_t i = 1; i < entries.size() && isRead; ++i)
+	{
+		if (entries[i].isFolder())continue;
+		isRead = reader.Read(mFunction_GetFileBuffer(m_pIndexNodeList->at(entryINodeNums[i])), entries[i].storedSize);
+	}
+	if (!reader.Close() || !isRead)
+	{
+		mFunction_ReleaseSubtree(entryINodeNums, allocatedRanges);
+		ERROR_MSG("FileSystem :Import Archive failed. archive is broken (checksum mismatch or truncated).");
+		return false;
+	}
+
+	//the subtree is linked to its parent at last
+	if (!mFunction_LinkSubtree(parentINodeNum, dirName, entries, entryINodeNums))
+	{
+		mFunction_ReleaseSubtree(entryINodeNums, allocatedRanges);
+		ERROR_MSG("FileSystem :Import Archive failed. Not Enough space.");
+		return false;
+	}
+
+	DEBUG_MSG("Import Archive : " << entries.size() << " entries, " << header.dataSize << " bytes of data imported" << (isContiguous ? " into one contiguous run." : "."));
+	return true;
+}
+
+uint64_t IFileSystem::GetVDiskCapacity()
+{
+	return mVDiskCapacity;
+}
+
+uint64_t IFileSystem::GetVDiskUsedSize()
+{
+	return mVDiskCapacity-m_pFileAddressAllocator->GetFreeSpace();
+}
+
+uint64_t IFileSystem::GetVDiskFreeSize()
+{
+	return m_pFileAddressAllocator->GetFreeSpace();
+}
+
+uint64_t IFileSystem::GetVDiskImageHugePageSize()
+{
+	if (!mIsVDiskInitialized)return 0;
+	return m_pVirtualDiskImage->GetHugePageBackedSize();
+}
+
+bool IFileSystem::IsVDiskReadOnly()
+{
+	return mIsVDiskInitialized && mIsVDiskReadOnly;
+}
+
+uint32_t IFileSystem::GetVDiskBlockSize()
+{
+	return mVDiskBlockSize;
+}
+
+const uint32_t IFileSystem::GetNameMaxLength()
+{
+	return c_FileAndDirNameMaxLength;
+}
+
+bool IFileSystem::EnableMetadataIndex(bool isEnabled)
+{
+	if (!isEnabled)
+	{
+		if (m_pMetadataIndex != nullptr)delete m_pMetadataIndex;
+		m_pMetadataIndex = nullptr;
+		return true;
+	}
+
+	if (m_pMetadataIndex != nullptr)return true;
+	m_pMetadataIndex = new CMetadataIndex;
+	if (mIsVDiskInitialized)mFunction_RebuildMetadataIndex();
+	return true;
+}
+
+CMetadataIndex * IFileSystem::GetMetadataIndex()
+{
+	return m_pMetadataIndex;
+}
+
+bool IFileSystem::CompressFile(std::string fileName)
+{
+	CTraceScope trace(m_pTraceRecorder, NOISE_TRACE_OP_COMPRESS_FILE, fileName);
+	return trace.Result(mFunction_CompressFile(fileName));
+}
+
+bool IFileSystem::mFunction_CompressFile(std::string fileName)
+{
+	DEBUG_MSG("********************************");
+	DEBUG_MSG("Compressing File:" + *m_pCurrentWorkingDir + fileName);
+
+	if (!mFunction_IsWritable("Compress file"))return false;
+
+	if (!mFunction_NameValidation(fileName))
+	{
+		ERROR_MSG("FileSystem :Compress file failed.");
+		return false;
+	}
+
+	uint32_t targetIndexNodeNum = 0;
+	if (!mFunction_FindInDirectory(*m_pCurrentDirIndexNode, fileName, false, targetIndexNodeNum))
+	{
+		ERROR_MSG("FileSystem :Compress file failed. file not found. ");
+		return false;
+	}
+	N_IndexNode& node = m_pIndexNodeList->at(targetIndexNodeNum);
+	if (node.isFileOpened)
+	{
+		ERROR_MSG("FileSystem :Compress file failed. file is OPEN-ED.");
+		return false;
+	}
+	if (node.isInline() || node.isCompressed())return true;//nothing to do
+
+	//file stays uncompressed unless it gives back at least one allocation block
+	std::vector<char> compressedExtent;
+	CCompression::CompressChunks(mFunction_GetFileBuffer(node), node.size, compressedExtent);
+	if (mFunction_GetAllocationSize(compressedExtent.size()) >= mFunction_GetAllocationSize(node.size))
+	{
+		DEBUG_MSG("FileSystem :Compress file : data is not compressible, file is kept uncompressed.");
+		return true;
+	}
+
+	uint64_t newAddress = mFunction_AllocateFileSpace(compressedExtent.size());
+	if (newAddress == c_invalid_alloc_address)
+	{
+		ERROR_MSG("FileSystem :Compress file failed. Not Enough space.");
+		return false;
+	}
+	mFunction_PreserveSnapshot(newAddress, compressedExtent.size());
+	memcpy(&m_pVirtualDiskImage->at(size_t(mVDiskHeaderLength + newAddress)), &compressedExtent.at(0), compressedExtent.size());
+
+	//(a shared extent only loses a reference)
+	mFunction_ReleaseFileSpace(node.address, node.size);
+	node.address = newAddress;
+	node.storedSize = compressedExtent.size();
+	node.flags = (node.flags | NOISE_INDEX_NODE_FLAG_COMPRESSED) & ~uint32_t(NOISE_INDEX_NODE_FLAG_SHARED);
+	if (m_pDedupIndex != nullptr)m_pDedupIndex->Erase(targetIndexNodeNum);
+
+	DEBUG_MSG("FileSystem :Compress file : " << node.size << " bytes are stored in " << node.storedSize << " bytes.");
+	return true;
+}
+
+bool IFileSystem::EnableDeduplication(bool isEnabled)
+{
+	if (!isEnabled)
+	{
+		if (m_pDedupIndex != nullptr)delete m_pDedupIndex;
+		m_pDedupIndex = nullptr;
+		return true;
+	}
+
+	//files closed from now on are indexed (DeduplicateFiles indexes the others)
+	if (m_pDedupIndex == nullptr)m_pDedupIndex = new CDedupIndex;
+	return true;
+}
+
+CDedupIndex * IFileSystem::GetDedupIndex()
+{
+	return m_pDedupIndex;
+}
+
+bool IFileSystem::DeduplicateFiles(N_DedupReport & outReport)
+{
+	outReport = N_DedupReport();
+	if (!mIsVDiskInitialized)
+	{
+		ERROR_MSG("Deduplicate Files failure: virtual disk was not installed !!");
+		return false;
+	}
+	if (mIsVDiskReadOnly)
+	{
+		ERROR_MSG("Deduplicate Files failure: virtual disk is installed read-only !");
+		return false;
+	}
+
+	//the whole tree is fingerprinted into the inline index (or a temporary one)
+	CDedupIndex tmpIndex;
+	CDedupIndex& index = (m_pDedupIndex != nullptr) ? *m_pDedupIndex : tmpIndex;
+	index.Clear();
+	std::vector<uint32_t> dirStack(1, 0);
+	uint32_t folderCount = 0, fileCount = 0;
+	std::vector<N_DirFileRecord> subFolders, subFiles;
+	while (!dirStack.empty())
+	{
+		uint32_t dirINodeNum = dirStack.back();
+		dirStack.pop_back();
+		mFunction_ReadDirectoryFile(m_pIndexNodeList->at(dirINodeNum), folderCount, fileCount, subFolders, subFiles);
+		for (auto& file : subFiles)mFunction_DeduplicateFile(file.indexNodeId, index, outReport);
+		for (auto& folder : subFolders)dirStack.push_back(folder.indexNodeId);
+	}
+	index.AddToReport(outReport);
+
+	DEBUG_MSG("Deduplicate Files : " << outReport.dedupedFileCount << " of " << outReport.scannedFileCount << " files deduplicated, " << outReport.savedBytes << " bytes saved.");
+	return true;
+}
+
+bool IFileSystem::CreateSnapshot()
+{
+	if (!mIsVDiskInitialized)
+	{
+		ERROR_MSG("Create Snapshot failure: virtual disk was not installed !!");
+		return false;
+	}
+	if (m_pSnapshot != nullptr)
+	{
+		ERROR_MSG("Create Snapshot failure: a snapshot is taken already, release it first.");
+		return false;
+	}
+
+	//header and i-node table as they are now (i-node table in image is only updated on un-install)
+	std::vector<char> frozenHeader(&m_pVirtualDiskImage->at(0), &m_pVirtualDiskImage->at(0) + sizeof(N_VirtualDiskHeaderInfo));
+	frozenHeader.resize(size_t(mVDiskHeaderLength));
+	N_IndexNode* pFrozenINodes = reinterpret_cast<N_IndexNode*>(&frozenHeader.at(sizeof(N_VirtualDiskHeaderInfo)));
+	memcpy(pFrozenINodes, &m_pIndexNodeList->at(0), m_pIndexNodeList->size() * sizeof(N_IndexNode));
+	for (uint32_t i = 0; i < m_pIndexNodeList->size(); ++i)pFrozenINodes[i].isFileOpened = false;
+
+	std::vector<N_AddressRange> freeSegments;
+	N_VirtualDiskHeaderInfo* pFrozenHeaderInfo = reinterpret_cast<N_VirtualDiskHeaderInfo*>(&frozenHeader.at(0));
+	pFrozenHeaderInfo->indexNodeTableChecksum = CChecksum::CRC32C(reinterpret_cast<char*>(pFrozenINodes), m_pIndexNodeList->size() * sizeof(N_IndexNode));
+
+	m_pFileAddressAllocator->GetFreeSegments(freeSegments);
+	m_pSnapshot = new CSnapshot(frozenHeader, mVDiskCapacity, freeSegments);
+	return true;
+}
+
+bool IFileSystem::WriteSnapshot(NFilePath imageFilePath)
+{
+	if (m_pSnapshot == nullptr)
+	{
+		ERROR_MSG("Write Snapshot failure: no snapshot is taken.");
+		return false;
+	}
+	if (imageFilePath == *m_pVirtualDiskImagePath)
+	{
+		ERROR_MSG("Write Snapshot failure: snapshot can't overwrite the installed image.");
+		return false;
+	}
+
+	bool isWritten = m_pSnapshot->WriteToFile(imageFilePath, &m_pVirtualDiskImage->at(size_t(mVDiskHeaderLength)));
+	DEBUG_MSG("Snapshot : " << m_pSnapshot->GetPreservedBytes() << " bytes were copied since the snapshot was taken.");
+	return isWritten;
+}
+
+void IFileSystem::ReleaseSnapshot()
+{
+	if (m_pSnapshot != nullptr)delete m_pSnapshot;
+	m_pSnapshot = nullptr;
+}
+
+bool IFileSystem::StartScrubber(uint64_t bytesPerSecond)
+{
+	if (!mIsVDiskInitialized)
+	{
+		ERROR_MSG("Start Scrubber failure: virtual disk was not installed !!");
+		return false;
+	}
+	if (m_pScrubber != nullptr)
+	{
+		ERROR_MSG("Start Scrubber failure: scrubber is running already.");
+		return false;
+	}
+	if (mIsImageFileStale)
+	{
+		ERROR_MSG("Start Scrubber failure: image file is stale till it is written back.");
+		return false;
+	}
+
+	m_pVirtualDiskFile->flush();
+	m_pScrubber = new CScrubber(*m_pVirtualDiskImagePath, bytesPerSecond, *m_pChecksumReport);
+	return true;
+}
+
+void IFileSystem::StopScrubber()
+{
+	if (m_pScrubber != nullptr)delete m_pScrubber;
+	m_pScrubber = nullptr;
+}
+
+void IFileSystem::GetChecksumReport(N_ChecksumReport & outReport)
+{
+	if (m_pScrubber != nullptr)m_pScrubber->CopyReport(outReport);
+	else outReport = *m_pChecksumReport;
+}
+
+bool IFileSystem::StartTraceRecording(NFilePath traceFilePath)
+{
+	if (m_pTraceRecorder != nullptr)
+	{
+		ERROR_MSG("IFileSystem : StartTraceRecording failure! trace is already being recorded.");
+		return false;
+	}
+
+	CTraceRecorder* pRecorder = new CTraceRecorder;
+	if (!pRecorder->Open(traceFilePath, mVDiskCapacity, uint32_t(m_pIndexNodeList->size()), mVDiskBlockSize))
+	{
+		delete pRecorder;
+		return false;
+	}
+	m_pTraceRecorder = pRecorder;
+	return true;
+}
+
+void IFileSystem::StopTraceRecording()
+{
+	if (m_pTraceRecorder == nullptr)return;
+
+	//files that are still opened shouldn't refer to the recorder any more
+	for (uint32_t i = 0; i < IFactory<IFile>::GetObjectCount(); ++i)
+	{
+		IFactory<IFile>::GetObjectPtr(i)->m_pTraceRecorder = nullptr;
+	}
+
+	m_pTraceRecorder->Close();
+	delete m_pTraceRecorder;
+	m_pTraceRecorder = nullptr;
+}
+
+
+/**********************************************
+
+							PRIVATE
+
+************************************************/
+
+template<typename T>
+inline void IFileSystem::mFunction_ReadData(uint64_t srcOffset, T & destData)
+{
+	memcpy_s(&destData,sizeof(T), &m_pVirtualDiskImage->at(size_t(srcOffset)),sizeof(T));
+}
+
+template<typename T>
+inline void IFileSystem::mFunction_WriteData(uint64_t destOffset, T& srcData)
+{
+	memcpy_s(&m_pVirtualDiskImage->at(size_t(destOffset)), sizeof(T), &srcData, sizeof(T));
+}
+
+uint64_t IFileSystem::mFunction_GetAllocationSize(uint64_t byteSize)
+{
+	//(block size is a power of 2)
+	return (byteSize + mVDiskBlockSize - 1) & ~uint64_t(mVDiskBlockSize - 1);
+}
+
+uint64_t IFileSystem::mFunction_AllocateFileSpace(uint64_t byteSize)
+{
+	return m_pFileAddressAllocator->Allocate(mFunction_GetAllocationSize(byteSize));
+}
+
+void IFileSystem::mFunction_ReleaseFileSpace(uint64_t address, uint64_t byteSize)
+{
+	uint64_t allocationSize = mFunction_GetAllocationSize(byteSize);
+	if (allocationSize == 0)return;
+	m_pFileAddressAllocator->Release(address, allocationSize);
+	mFunction_QueueFreedRange(address, allocationSize);
+}
+
+void IFileSystem::mFunction_QueueFreedRange(uint64_t start, uint64_t size)
+{
+	//(a long mount frees many ranges, the ones next to the last freed range are merged into it)
+	if (mIsFreedRangeListOverflowed)return;
+	if (!m_pFreedRangeList->empty())
+	{
+		N_AddressRange& last = m_pFreedRangeList->back();
+		if (last.start + last.size == start) { last.size += size; return; }
+		if (start + size == last.start) { last.start = start; last.size += size; return; }
+	}
+	if (m_pFreedRangeList->size() >= c_FreedRangeListMaxSize)
+	{
+		m_pFreedRangeList->clear();
+		m_pFreedRangeList->shrink_to_fit();
+		mIsFreedRangeListOverflowed = true;
+		return;
+	}
+	m_pFreedRangeList->push_back(N_AddressRange(start, size));
+}
+
+bool IFileSystem::mFunction_NameValidation(const std::string & name)
+{
+	if (name.size() > 120)
+	{
+		ERROR_MSG("IFileSystem : the length of a name exceed max length! ");
+		return false;
+	}
+	
+	if (name.find('\\', 0) != std::string::npos || name.find('/', 0) != std::string::npos)
+	{
+		ERROR_MSG("IFileSystem :  Character '\\' and '/' are not permitted in a NAME .");
+		return false;
+	}
+	return true;
+}
+
+bool IFileSystem::mFunction_ResolveDirectory(const std::string & dir, uint32_t & outIndexNodeId)
+{
+	auto isDelim = [](char c) ->bool {return c == '\\' || c == '/'; };
+	if (dir.size() == 0 || !isDelim(dir.at(0)))return false;
+
+	//folder names between delimiters are matched level by level (a delimiter may end the path)
+	uint32_t indexNodeNum = 0;
+	std::string folderName;
+	for (size_t i = 1; i <= dir.size(); ++i)
+	{
+		if (i < dir.size() && !isDelim(dir.at(i)))
+		{
+			folderName.push_back(dir.at(i));
+			continue;
+		}
+		if (i == dir.size() && folderName.empty())break;
+		if (!mFunction_FindInDirectory(m_pIndexNodeList->at(indexNodeNum), folderName, true, indexNodeNum))return false;
+		folderName.clear();
+	}
+
+	outIndexNodeId = indexNodeNum;
+	return true;
+}
+
+uint32_t IFileSystem::mFunction_HashName(const char * pName, uint32_t length)
+{
+	//FNV-1a
+	uint32_t hash = 2166136261u;
+	for (uint32_t i = 0; i < length; ++i)
+	{
+		hash ^= uint8_t(pName[i]);
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+uint64_t IFileSystem::mFunction_GetDirectoryFileSize(const std::vector<N_DirFileRecord>& childFolders, const std::vector<N_DirFileRecord>& childFiles)
+{
+	//counts, then hash/i-node/name offset (12 bytes) and length-prefixed name per record
+	uint64_t size = 8;
+	for (auto& record : childFolders)size += 12 + 1 + strnlen(record.name, c_FileAndDirNameMaxLength);
+	for (auto& record : childFiles)size += 12 + 1 + strnlen(record.name, c_FileAndDirNameMaxLength);
+	return size;
+}
+
+bool IFileSystem::mFunction_ReadDirectoryFile(const N_IndexNode& dirNode, uint32_t & outFolderCount, uint32_t & outFileCount, std::vector<N_DirFileRecord>& outChildFolders, std::vector<N_DirFileRecord>& outChildFiles)
+{
+	outFolderCount = 0;
+	outFileCount = 0;
+	outChildFolders.clear();
+	outChildFiles.clear();
+	if (dirNode.size < 8)return false;
+
+	//(records are not aligned, fields are copied out)
+	const char* pDirFile = &m_pVirtualDiskImage->at(size_t(mVDiskHeaderLength + dirNode.address));
+	auto readU32 = [pDirFile](uint64_t offset) ->uint32_t {uint32_t v; memcpy(&v, pDirFile + offset, sizeof(v)); return v; };
+	uint32_t folderCount = readU32(0);
+	uint32_t fileCount = readU32(4);
+	uint64_t recordCount = uint64_t(folderCount) + fileCount;
+	if (8 + recordCount * 12 > dirNode.size)return false;
+
+	outChildFolders.reserve(folderCount);
+	outChildFiles.reserve(fileCount);
+	for (uint64_t i = 0; i < recordCount; ++i)
+	{
+		//a broken record ends the directory, records before it are still returned
+		uint64_t nameOffset = readU32(8 + recordCount * 8 + i * 4);
+		if (nameOffset >= dirNode.size)return false;
+		uint8_t nameLength = uint8_t(pDirFile[nameOffset]);
+		if (nameLength > c_FileAndDirNameMaxLength || nameOffset + 1 + nameLength > dirNode.size)return false;
+
+		N_DirFileRecord record;
+		memcpy(record.name, pDirFile + nameOffset + 1, nameLength);
+		record.indexNodeId = readU32(8 + recordCount * 4 + i * 4);
+		if (i < folderCount)outChildFolders.push_back(record);
+		else outChildFiles.push_back(record);
+	}
+
+	outFolderCount = folderCount;
+	outFileCount = fileCount;
+	return true;
+}
+
+void IFileSystem::mFunction_WriteDirectoryFile(uint64_t dirFileAddress, uint32_t inFolderCount, uint32_t inFileCount, std::vector<N_DirFileRecord>& inChildFolders, std::vector<N_DirFileRecord>& inChildFiles)
+{
+	if (m_pSnapshot != nullptr)mFunction_PreserveSnapshot(dirFileAddress, mFunction_GetDirectoryFileSize(inChildFolders, inChildFiles));
+	char* pDirFile = &m_pVirtualDiskImage->at(size_t(mVDiskHeaderLength + dirFileAddress));
+	auto writeU32 = [pDirFile](uint64_t offset, uint32_t v) {memcpy(pDirFile + offset, &v, sizeof(v)); };
+	uint64_t recordCount = uint64_t(inFolderCount) + inFileCount;
+	writeU32(0, inFolderCount);
+	writeU32(4, inFileCount);
+
+	uint64_t nameOffset = 8 + recordCount * 12;
+	for (uint64_t i = 0; i < recordCount; ++i)
+	{
+		const N_DirFileRecord& record = (i < inFolderCount) ? inChildFolders.at(size_t(i)) : inChildFiles.at(size_t(i - inFolderCount));
+		uint32_t nameLength = uint32_t(strnlen(record.name, c_FileAndDirNameMaxLength));
+		writeU32(8 + i * 4, mFunction_HashName(record.name, nameLength));
+		writeU32(8 + recordCount * 4 + i * 4, record.indexNodeId);
+		writeU32(8 + recordCount * 8 + i * 4, uint32_t(nameOffset));
+		pDirFile[nameOffset] = char(nameLength);
+		memcpy(pDirFile + nameOffset + 1, record.name, nameLength);
+		nameOffset += 1 + nameLength;
+	}
+}
+
+bool IFileSystem::mFunction_UpdateDirectoryFile(N_IndexNode * pDirNode, std::vector<N_DirFileRecord>& childFolders, std::vector<N_DirFileRecord>& childFiles)
+{
+	//directory file is re-allocated with its new size
+	uint64_t oldAddress = pDirNode->address;
+	uint64_t oldSize = pDirNode->size;
+	mFunction_ReleaseFileSpace(oldAddress, oldSize);
+	uint64_t newSize = mFunction_GetDirectoryFileSize(childFolders, childFiles);
+	uint64_t newAddress = mFunction_AllocateFileSpace(newSize);
+	if (newAddress == c_invalid_alloc_address)
+	{
+		//directory file stays where it was (that space is free just now)
+		m_pFileAddressAllocator->Allocate(oldAddress, mFunction_GetAllocationSize(oldSize));
+		return false;
+	}
+
+	pDirNode->address = newAddress;
+	pDirNode->size = newSize;
+	mFunction_WriteDirectoryFile(newAddress, uint32_t(childFolders.size()), uint32_t(childFiles.size()), childFolders, childFiles);
+	return true;
+}
+
+bool IFileSystem::mFunction_FindInDirectory(const N_IndexNode & dirNode, const std::string & name, bool isFolder, uint32_t & outIndexNodeId)
+{
+	if (dirNode.size < 8)return false;
+
+	const char* pDirFile = &m_pVirtualDiskImage->at(size_t(mVDiskHeaderLength + dirNode.address));
+	auto readU32 = [pDirFile](uint64_t offset) ->uint32_t {uint32_t v; memcpy(&v, pDirFile + offset, sizeof(v)); return v; };
+	uint32_t folderCount = readU32(0);
+	uint32_t fileCount = readU32(4);
+	uint64_t recordCount = uint64_t(folderCount) + fileCount;
+	if (8 + recordCount * 12 > dirNode.size)return false;
+
+	//hash array is scanned by the vectorized kernel, names are only compared on a hash hit
+	uint32_t targetHash = mFunction_HashName(name.c_str(), uint32_t(name.size()));
+	uint64_t first = isFolder ? 0 : folderCount;
+	uint64_t last = isFolder ? folderCount : recordCount;
+	for (uint64_t i = CNameMatcher::FindHash(pDirFile + 8, first, last, targetHash); i < last;
+		i = CNameMatcher::FindHash(pDirFile + 8, i + 1, last, targetHash))
+	{
+		uint64_t nameOffset = readU32(8 + recordCount * 8 + i * 4);
+		if (nameOffset >= dirNode.size)return false;
+		uint8_t nameLength = uint8_t(pDirFile[nameOffset]);
+		if (nameLength == name.size() && nameOffset + 1 + nameLength <= dirNode.size &&
+			memcmp(pDirFile + nameOffset + 1, name.c_str(), nameLength) == 0)
+		{
+			outIndexNodeId = readU32(8 + recordCount * 4 + i * 4);
+			return true;
+		}
+	}
+	return false;
+}
+
+void IFileSystem::mFunction_ReleaseFileSpace(uint32_t fileIndexNodeNum)
+{
+	//release file storage and index node
+	N_IndexNode* pFileINode = &m_pIndexNodeList->at(fileIndexNodeNum);
+	if (!pFileINode->isInline())mFunction_ReleaseFileSpace(pFileINode->address, pFileINode->extentSize());
+	m_pIndexNodeAllocator->Release(fileIndexNodeNum, 1);
+	if (m_pMetadataIndex != nullptr)m_pMetadataIndex->Erase(fileIndexNodeNum);
+	if (m_pDedupIndex != nullptr)m_pDedupIndex->Erase(fileIndexNodeNum);
+	pFileINode->reset();
+}
+
+char * IFileSystem::mFunction_GetFileBuffer(N_IndexNode & node)
+{
+	if (node.isInline())return node.inlineData;
+	return &m_pVirtualDiskImage->at(size_t(mVDiskHeaderLength + node.address));
+}
+
+bool IFileSystem::mFunction_ResizeFile(IFile * pFile, uint64_t newByteSize)
+{
+	N_IndexNode& node = m_pIndexNodeList->at(pFile->mFileIndexNodeNumber);
+	if (!pFile->mAccessMode_Write)
+	{
+		ERROR_MSG("IFile : 'Resize' failure! No Authorization to write!");
+		return false;
+	}
+
+	//data is resized uncompressed
+	if (!mFunction_DecompressFile(pFile))
+	{
+		ERROR_MSG("IFile : 'Resize' failure! compressed file can't be decompressed.");
+		return false;
+	}
+
+	uint64_t keptSize = std::min(node.size, newByteSize);
+	if (newByteSize <= c_IndexNodeInlineDataMaxSize)
+	{
+		//tiny file : data moves into i-node (if it isn't there)
+		char inlineData[c_IndexNodeInlineDataMaxSize] = { 0 };
+		memcpy(inlineData, mFunction_GetFileBuffer(node), size_t(keptSize));
+		if (!node.isInline())mFunction_ReleaseFileSpace(node.address, node.size);
+		memcpy(node.inlineData, inlineData, sizeof(inlineData));
+		node.flags = (node.flags | NOISE_INDEX_NODE_FLAG_INLINE) & ~uint32_t(NOISE_INDEX_NODE_FLAG_SHARED);
+	}
+	else if (!node.isInline() && mFunction_GetAllocationSize(newByteSize) == mFunction_GetAllocationSize(node.size))
+	{
+		//still fits in the allocated blocks (which are copied first if they are shared)
+		if (newByteSize > node.size && !mFunction_PrepareFileWrite(pFile, node.size, newByteSize - node.size))
+		{
+			ERROR_MSG("IFile : 'Resize' failure! Not Enough space.");
+			return false;
+		}
+		if (newByteSize > node.size)memset(mFunction_GetFileBuffer(node) + node.size, 0, size_t(newByteSize - node.size));
+	}
+	else
+	{
+		//promoted to (or moved to another) extent
+		uint64_t newAddress = mFunction_AllocateFileSpace(newByteSize);
+		if (newAddress == c_invalid_alloc_address)
+		{
+			ERROR_MSG("IFile : 'Resize' failure! Not Enough space.");
+			return false;
+		}
+		mFunction_PreserveSnapshot(newAddress, newByteSize);
+		char* pNewData = &m_pVirtualDiskImage->at(size_t(mVDiskHeaderLength + newAddress));
+		memcpy(pNewData, mFunction_GetFileBuffer(node), size_t(keptSize));
+		memset(pNewData + keptSize, 0, size_t(newByteSize - keptSize));
+		if (!node.isInline())mFunction_ReleaseFileSpace(node.address, node.size);
+		node.flags &= ~uint32_t(NOISE_INDEX_NODE_FLAG_INLINE | NOISE_INDEX_NODE_FLAG_SHARED);
+		memset(node.inlineData, 0, sizeof(node.inlineData));
+		node.address = newAddress;
+	}
+
+	node.size = newByteSize;
+	pFile->mFileSize = newByteSize;
+	pFile->m_pFileBuffer = mFunction_GetFileBuffer(node);
+	if (m_pMetadataIndex != nullptr)m_pMetadataIndex->Insert(pFile->mFileIndexNodeNumber, node);
+	return true;
+}
+
+void IFileSystem::mFunction_RelayoutImage(uint64_t capacity, uint32_t indexNodeCount)
+{
+	//image memory is large enough for both layouts. the part that moves up goes first when
+	//growing and last when shrinking, so that nothing is overwritten before it has moved
+	uint64_t oldHeaderLength = mVDiskHeaderLength;
+	uint64_t oldCapacity = mVDiskCapacity;
+	uint64_t headerLength = mFunction_GetHeaderLength(indexNodeCount);
+	uint64_t keptCapacity = std::min(oldCapacity, capacity);
+	uint64_t keptChecksumAreaSize = mFunction_GetChecksumAreaSize(keptCapacity);
+	bool isGrowing = (capacity >= oldCapacity && headerLength >= oldHeaderLength);
+	char* pImage = &m_pVirtualDiskImage->at(0);
+	auto moveChecksums = [&]() {memmove(pImage + headerLength + capacity, pImage + oldHeaderLength + oldCapacity, size_t(keptChecksumAreaSize)); };
+
+	//user space only moves when i-node table size changes. user space addresses are relative
+	//to the header length, so i-nodes and allocators are not touched by relocation
+	if (isGrowing)moveChecksums();
+	if (headerLength != oldHeaderLength)memmove(pImage + headerLength, pImage + oldHeaderLength, size_t(keptCapacity));
+	if (!isGrowing)moveChecksums();
+
+	//appended i-nodes, user space and block checksums are zero (checksums are computed when written back)
+	if (headerLength > oldHeaderLength)memset(pImage + oldHeaderLength, 0, size_t(headerLength - oldHeaderLength));
+	memset(pImage + headerLength + keptCapacity, 0, size_t(capacity - keptCapacity));
+	memset(pImage + headerLength + capacity + keptChecksumAreaSize, 0, size_t(mFunction_GetChecksumAreaSize(capacity) - keptChecksumAreaSize));
+
+	//i-node table (current dir i-node is re-pointed after re-allocation of the list)
+	size_t currentDirIndexNodeNum = m_pCurrentDirIndexNode - &m_pIndexNodeList->at(0);
+	m_pIndexNodeList->resize(indexNodeCount);
+	m_pCurrentDirIndexNode = &m_pIndexNodeList->at(currentDirIndexNodeNum);
+	if (isGrowing)
+	{
+		m_pIndexNodeAllocator->GrowAddressSpace(indexNodeCount);
+		m_pFileAddressAllocator->GrowAddressSpace(capacity);
+	}
+	else
+	{
+		m_pIndexNodeAllocator->ShrinkAddressSpace(indexNodeCount);
+		m_pFileAddressAllocator->ShrinkAddressSpace(capacity);
+	}
+
+	//update header
+	N_VirtualDiskHeaderInfo headerInfo;
+	mFunction_ReadData(0, headerInfo);
+	headerInfo.diskCapacity = capacity;
+	headerInfo.diskHeaderLength = headerLength;
+	headerInfo.indexNodeCount = indexNodeCount;
+	mFunction_WriteData(0, headerInfo);
+	mVDiskCapacity = capacity;
+	mVDiskHeaderLength = headerLength;
+	mVDiskImageSize = headerLength + capacity + mFunction_GetChecksumAreaSize(capacity);
+
+	//opened files refer to the re-allocated (and maybe relocated) image and i-node list
+	for (uint32_t i = 0; i < IFactory<IFile>::GetObjectCount(); ++i)
+	{
+		IFile* pFile = IFactory<IFile>::GetObjectPtr(i);
+		pFile->m_pFileBuffer = mFunction_GetFileBuffer(m_pIndexNodeList->at(pFile->mFileIndexNodeNumber));
+	}
+}
+
+bool IFileSystem::mFunction_WriteBackImage()
+{
+	//i-node table is copied in one pass (files that are open now aren't open in the image file)
+	N_IndexNode* pImageINodes = reinterpret_cast<N_IndexNode*>(&m_pVirtualDiskImage->at(sizeof(N_VirtualDiskHeaderInfo)));
+	memcpy(pImageINodes, &m_pIndexNodeList->at(0), m_pIndexNodeList->size() * sizeof(N_IndexNode));
+	for (uint32_t i = 0; i < IFactory<IFile>::GetObjectCount(); ++i)
+		pImageINodes[IFactory<IFile>::GetObjectPtr(i)->mFileIndexNodeNumber].isFileOpened = false;
+
+	//checksums of i-node table and of blocks that overlap allocated user space
+	std::vector<N_AddressRange> blockRanges;
+	mFunction_GetAllocatedBlocks(blockRanges);
+	char* pChecksums = &m_pVirtualDiskImage->at(size_t(mFunction_GetChecksumAreaOffset()));
+	for (auto& r : blockRanges)
+	{
+		for (uint64_t i = r.start; i < r.start + r.size; ++i)
+		{
+			uint64_t blockStart = i * c_ChecksumBlockSize;
+			uint32_t checksum = CChecksum::CRC32C(&m_pVirtualDiskImage->at(size_t(mVDiskHeaderLength + blockStart)), std::min<uint64_t>(c_ChecksumBlockSize, mVDiskCapacity - blockStart));
+			memcpy(pChecksums + i * sizeof(uint32_t), &checksum, sizeof(checksum));
+		}
+	}
+	N_VirtualDiskHeaderInfo headerInfo;
+	mFunction_ReadData(0, headerInfo);
+	headerInfo.indexNodeTableChecksum = CChecksum::CRC32C(&m_pVirtualDiskImage->at(sizeof(N_VirtualDiskHeaderInfo)), m_pIndexNodeList->size() * sizeof(N_IndexNode));
+	mFunction_WriteData(0, headerInfo);
+
+	//header & i-node table, block checksums, then allocated user space in whole blocks (so that
+	//they match their checksums). free space is never written, so that it stays sparse in host file
+	std::vector<N_AddressRange> fileRanges(1, N_AddressRange(0, mVDiskHeaderLength));
+	fileRanges.push_back(N_AddressRange(mFunction_GetChecksumAreaOffset(), mFunction_GetChecksumAreaSize(mVDiskCapacity)));
+	for (auto& r : blockRanges)
+	{
+		uint64_t start = r.start * c_ChecksumBlockSize;
+		uint64_t end = std::min<uint64_t>((r.start + r.size) * c_ChecksumBlockSize, mVDiskCapacity);
+		fileRanges.push_back(N_AddressRange(mVDiskHeaderLength + start, end - start));
+	}
+
+	//ranges are written by several threads with positional I/O (fstream is flushed first, so
+	//that nothing buffered in it lands afterwards), through fstream if that fails
+	m_pVirtualDiskFile->flush();
+	bool isWritten = CHostFile::ParallelWrite(*m_pVirtualDiskImagePath, &m_pVirtualDiskImage->at(0), fileRanges);
+	if (!isWritten)
+	{
+		m_pVirtualDiskFile->clear();
+		for (auto& r : fileRanges)
+		{
+			m_pVirtualDiskFile->seekp(std::streamoff(r.start));
+			m_pVirtualDiskFile->write(&m_pVirtualDiskImage->at(size_t(r.start)), std::streamsize(r.size));
+		}
+		m_pVirtualDiskFile->flush();
+		isWritten = m_pVirtualDiskFile->good();
+		m_pVirtualDiskFile->clear();
+	}
+
+	//(a longer host file is left by a grow that was interrupted)
+	if (!isWritten || !CHostFile::SetFileSize(*m_pVirtualDiskImagePath, mVDiskImageSize))
+	{
+		ERROR_MSG("IFileSystem : Write Back failure! image file can't be written.");
+		mIsImageFileStale = true;
+		return false;
+	}
+	m_pFileAddressAllocator->GetFreeSegments(*m_pWrittenBackFreeSegments);
+	mIsImageFileStale = false;
+	return true;
+}
+
+uint64_t IFileSystem::mFunction_GetHeaderLength(uint32_t indexNodeCount)
+{
+	return sizeof(N_VirtualDiskHeaderInfo) + uint64_t(indexNodeCount) * sizeof(N_IndexNode);
+}
+
+uint64_t IFileSystem::mFunction_GetChecksumAreaSize(uint64_t capacity)
+{
+	return (capacity + c_ChecksumBlockSize - 1) / c_ChecksumBlockSize * sizeof(uint32_t);
+}
+
+uint64_t IFileSystem::mFunction_GetChecksumAreaOffset()
+{
+	return mVDiskHeaderLength + mVDiskCapacity;
+}
+
+void IFileSystem::mFunction_GetAllocatedBlocks(std::vector<N_AddressRange>& outBlockRanges)
+{
+	//allocated user space lies between free segments, runs that touch the same block are merged
+	outBlockRanges.clear();
+	std::vector<N_AddressRange> freeSegments;
+	m_pFileAddressAllocator->GetFreeSegments(freeSegments);
+	freeSegments.push_back(N_AddressRange(mVDiskCapacity, 0));
+	uint64_t allocatedStart = 0;
+	for (auto& seg : freeSegments)
+	{
+		if (seg.start > allocatedStart)
+		{
+			uint64_t firstBlock = allocatedStart / c_ChecksumBlockSize;
+			uint64_t endBlock = (seg.start + c_ChecksumBlockSize - 1) / c_ChecksumBlockSize;
+			if (!outBlockRanges.empty() && outBlockRanges.back().start + outBlockRanges.back().size >= firstBlock)
+				outBlockRanges.back().size = endBlock - outBlockRanges.back().start;
+			else
+				outBlockRanges.push_back(N_AddressRange(firstBlock, endBlock - firstBlock));
+		}
+		allocatedStart = seg.start + seg.size;
+	}
+}
+
+void IFileSystem::mFunction_VerifyChecksums()
+{
+	N_VirtualDiskHeaderInfo headerInfo;
+	mFunction_ReadData(0, headerInfo);
+	uint64_t indexNodeTableSize = m_pIndexNodeList->size() * sizeof(N_IndexNode);
+	if (CChecksum::CRC32C(&m_pVirtualDiskImage->at(sizeof(N_VirtualDiskHeaderInfo)), indexNodeTableSize) != headerInfo.indexNodeTableChecksum)
+	{
+		m_pChecksumReport->isIndexNodeTableCorrupted = true;
+		ERROR_MSG("Install Virtual Disk : i-node table doesn't match its checksum, run fsck!");
+	}
+	m_pChecksumReport->verifiedBytes += indexNodeTableSize;
+
+	//(user space of a read-only install is left to scrubber, so that installing doesn't read all of it)
+	if (mIsVDiskReadOnly)return;
+	std::vector<N_AddressRange> blockRanges;
+	mFunction_GetAllocatedBlocks(blockRanges);
+	const char* pChecksums = &m_pVirtualDiskImage->at(size_t(mFunction_GetChecksumAreaOffset()));
+	for (auto& r : blockRanges)
+	{
+		for (uint64_t i = r.start; i < r.start + r.size; ++i)
+		{
+			uint64_t blockStart = i * c_ChecksumBlockSize;
+			uint64_t blockSize = std::min<uint64_t>(c_ChecksumBlockSize, mVDiskCapacity - blockStart);
+			uint32_t checksum = 0;
+			memcpy(&checksum, pChecksums + i * sizeof(uint32_t), sizeof(checksum));
+			if (CChecksum::CRC32C(&m_pVirtualDiskImage->at(size_t(mVDiskHeaderLength + blockStart)), blockSize) != checksum)
+				m_pChecksumReport->corruptedBlocks.push_back(blockStart);
+			m_pChecksumReport->verifiedBytes += blockSize;
+		}
+	}
+	if (!m_pChecksumReport->corruptedBlocks.empty())
+	{
+		ERROR_MSG("Install Virtual Disk : " << m_pChecksumReport->corruptedBlocks.size() << " blocks of user space don't match their checksums!"
+			<< " (first one at " << m_pChecksumReport->corruptedBlocks.front() << ")");
+	}
+}
+
+bool IFileSystem::mFunction_RecursiveFolderDelete(uint32_t dirFileIndexNodeNum)
+{
+	//desc : delete all child-folders and files under this folder including the folder itself.
+	//the whole subtree is collected (and checked) first, so nothing is deleted if it fails
+	std::vector<uint32_t> subtreeINodes;
+	mFunction_CollectSubtreeParallel(dirFileIndexNodeNum, subtreeINodes);
+
+	for (uint32_t iNodeNum : subtreeINodes)
+	{
+		if (m_pIndexNodeList->at(iNodeNum).isFileOpened)
+		{
+			DEBUG_MSG("IFileSystem :Delete folder failed. a file under this folder is opened. Deletion procedure terminated.");
+			DEBUG_MSG("IFileSystem :Opened file i-node:" << iNodeNum);
+			return false;
+		}
+	}
+
+	//extents and i-nodes are released in one merge pass per allocator
+	std::vector<N_AddressRange> extents;
+	std::vector<N_AddressRange> indexNodes;
+	extents.reserve(subtreeINodes.size());
+	indexNodes.reserve(subtreeINodes.size());
+	for (uint32_t iNodeNum : subtreeINodes)
+	{
+		N_IndexNode& node = m_pIndexNodeList->at(iNodeNum);
+		uint64_t allocationSize = node.isInline() ? 0 : mFunction_GetAllocationSize(node.extentSize());
+		if (allocationSize != 0)extents.push_back(N_AddressRange(node.address, allocationSize));
+		indexNodes.push_back(N_AddressRange(iNodeNum, 1));
+		node.reset();
+		if (m_pMetadataIndex != nullptr)m_pMetadataIndex->Erase(iNodeNum);
+		if (m_pDedupIndex != nullptr)m_pDedupIndex->Erase(iNodeNum);
+	}
+
+	if (!m_pFileAddressAllocator->ReleaseRanges(extents))
+	{
+		//(only with a corrupted image) release one by one, illegal ranges are skipped
+		ERROR_MSG("IFileSystem :Delete folder : overlapped or free extents found in the deleted folder, run fsck.");
+		for (auto& range : extents)m_pFileAddressAllocator->Release(range.start, range.size);
+	}
+	if (!m_pIndexNodeAllocator->ReleaseRanges(indexNodes))
+	{
+		ERROR_MSG("IFileSystem :Delete folder : an i-node is referred more than once in the deleted folder, run fsck.");
+		for (auto& range : indexNodes)m_pIndexNodeAllocator->Release(range.start, range.size);
+	}
+	for (auto& range : extents)mFunction_QueueFreedRange(range.start, range.size);
+
+	return true;
+}
+
+void IFileSystem::mFunction_RebuildMetadataIndex()
+{
+	//only files are indexed, i-nodes of folders are told apart by the directory tree
+	m_pMetadataIndex->Clear();
+	std::vector<uint32_t> dirStack(1, 0);
+	uint32_t folderCount = 0, fileCount = 0;
+	std::vector<N_DirFileRecord> subFolderINT;
+	std::vector<N_DirFileRecord> subFilesINT;
+	while (!dirStack.empty())
+	{
+		uint32_t dirINodeNum = dirStack.back();
+		dirStack.pop_back();
+		mFunction_ReadDirectoryFile(m_pIndexNodeList->at(dirINodeNum), folderCount, fileCount, subFolderINT, subFilesINT);
+		for (auto& file : subFilesINT)m_pMetadataIndex->Insert(file.indexNodeId, m_pIndexNodeList->at(file.indexNodeId));
+		for (auto& folder : subFolderINT)dirStack.push_back(folder.indexNodeId);
+	}
+}
+
+void IFileSystem::mFunction_CollectSubtreeParallel(uint32_t dirFileIndexNodeNum, std::vector<uint32_t>& outIndexNodes)
+{
+	outIndexNodes.clear();
+	uint32_t rootFolderCount = 0, rootFileCount = 0;
+	std::vector<N_DirFileRecord> rootFolderINT;
+	std::vector<N_DirFileRecord> rootFilesINT;
+	mFunction_ReadDirectoryFile(m_pIndexNodeList->at(dirFileIndexNodeNum), rootFolderCount, rootFileCount, rootFolderINT, rootFilesINT);
+
+	outIndexNodes.push_back(dirFileIndexNodeNum);
+	for (auto& file : rootFilesINT)outIndexNodes.push_back(file.indexNodeId);
+	if (rootFolderINT.empty())return;
+
+	//shared state of worker threads : one folder per task (as in Walk), so that a deep subtree under
+	//one child folder is shared as well. workers only read the image and i-node list, nothing is
+	//modified until all of them are joined
+	std::vector<uint32_t> taskStack;
+	for (auto& folder : rootFolderINT)taskStack.push_back(folder.indexNodeId);
+	std::mutex taskLock;
+	std::condition_variable taskCondition;
+	uint32_t activeWorkerCount = 0;
+	uint32_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<std::vector<uint32_t>> workerResults(threadCount);
+
+	auto workerLoop = [&](std::vector<uint32_t>& result)
+	{
+		uint32_t folderCount = 0, fileCount = 0;
+		std::vector<N_DirFileRecord> subFolderINT;
+		std::vector<N_DirFileRecord> subFilesINT;
+		while (true)
+		{
+			uint32_t dirINodeNum = 0;
+			{
+				//quit when no task is left and no worker can produce one
+				std::unique_lock<std::mutex> lock(taskLock);
+				taskCondition.wait(lock, [&]() {return !taskStack.empty() || activeWorkerCount == 0; });
+				if (taskStack.empty())return;
+				dirINodeNum = taskStack.back();
+				taskStack.pop_back();
+				++activeWorkerCount;
+			}
+
+			//(a broken directory file still gives its readable records)
+			mFunction_ReadDirectoryFile(m_pIndexNodeList->at(dirINodeNum), folderCount, fileCount, subFolderINT, subFilesINT);
+			result.push_back(dirINodeNum);
+			for (auto& file : subFilesINT)result.push_back(file.indexNodeId);
+
+			{
+				std::lock_guard<std::mutex> lock(taskLock);
+				for (auto& folder : subFolderINT)taskStack.push_back(folder.indexNodeId);
+				--activeWorkerCount;
+			}
+			taskCondition.notify_all();
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (uint32_t i = 1; i < threadCount; ++i)workers.push_back(std::thread(workerLoop, std::ref(workerResults.at(i))));
+	workerLoop(workerResults.at(0));//calling thread is a worker too
+	for (auto& worker : workers)worker.join();
+
+	for (auto& result : workerResults)outIndexNodes.insert(outIndexNodes.end(), result.begin(), result.end());
+}
+
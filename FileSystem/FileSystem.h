@@ -14,6 +14,10 @@
 
 //login		---	IFileSystem::Login
 //dir			---	IFileSystem::EnumerateFilesAndDirs
+//find		---	IFileSystem::Walk
+//rename	---	IFileSystem::Rename
+//clone		---	IFileSystem::CloneFile
+//compress	---	IFileSystem::CompressFile
 //create	---	IFileSystem::CreateFile
 //delete	---	IFileSystem::DeleteFile
 //open		---	IFileSystem::OpenFile
@@ -42,6 +46,16 @@ namespace Noise3D
 			NOISE_VIRTUAL_DISK_CAPACITY_1GB
 		};
 
+		//geometry of a new virtual disk (CreateVirtualDisk)
+		struct N_VirtualDiskFormatOptions
+		{
+			N_VirtualDiskFormatOptions() :capacity(128ull * 1024 * 1024), indexNodeCount(0), blockSize(1) {}
+
+			uint64_t capacity;//byte size of user file space (64-bit, can exceed 4GB)
+			uint32_t indexNodeCount;//0 : decided by capacity (one i-node per 8KB)
+			uint32_t blockSize;//allocation granularity of user file space in bytes (power of 2)
+		};
+
 		enum NOISE_FILE_OWNER
 		{
 			NOISE_FILE_OWNER_NULL = 0,
@@ -49,17 +63,42 @@ namespace Noise3D
 			NOISE_FILE_OWNER_GUEST = 2
 		};
 
+		enum NOISE_INDEX_NODE_FLAG
+		{
+			NOISE_INDEX_NODE_FLAG_INLINE = 0x1,//data lies in i-node itself instead of an extent of user file space
+			NOISE_INDEX_NODE_FLAG_SHARED = 0x2,//extent may be shared with clones (copy-on-write, see CloneFile)
+			NOISE_INDEX_NODE_FLAG_COMPRESSED = 0x4,//extent holds LZ4 chunks (see Compression.h) of storedSize bytes
+		};
+
+		const uint32_t c_IndexNodeInlineDataMaxSize = 48;//files not larger than this are stored inline
+
+		//(64 bytes, one cache line)
 		struct N_IndexNode
 		{
-			N_IndexNode():ownerUserID(0),isFileOpened(0) ,accessMode(0),address(0),size(0){}
+			N_IndexNode() { reset(); }
+
+			void reset() { memset(static_cast<void*>(this), 0, sizeof(*this)); }
+
+			bool isInline() const { return (flags & NOISE_INDEX_NODE_FLAG_INLINE) != 0; }
+
+			bool isCompressed() const { return (flags & NOISE_INDEX_NODE_FLAG_COMPRESSED) != 0; }
 
-			void reset() { ownerUserID = NOISE_FILE_OWNER_NULL; isFileOpened = 0; accessMode = 0; address = 0; size = 0; }
+			uint64_t extentSize() const { return isCompressed() ? storedSize : size; }//bytes used in user file space
 
 			uint8_t ownerUserID;//userID of this file user (system file are owned by ROOT : 1 , i-node that is not in use is owned by NULL:0)
 			uint8_t	isFileOpened;//false=0,true=1
 			uint16_t accessMode;//flag can be combined by 'OR' operation
-			uint32_t address;
-			uint32_t size;//file byte size
+			uint32_t flags;//NOISE_INDEX_NODE_FLAG
+			uint64_t size;//file byte size
+			union
+			{
+				struct
+				{
+					uint64_t address;//extent in user file space
+					uint64_t storedSize;//byte size of compressed extent (NOISE_INDEX_NODE_FLAG_COMPRESSED)
+				};
+				char inlineData[c_IndexNodeInlineDataMaxSize];//(NOISE_INDEX_NODE_FLAG_INLINE)
+			};
 		};
 
 		struct N_FileEnumInfo
@@ -67,8 +106,9 @@ namespace Noise3D
 			std::string name;
 			uint8_t ownerUserID;//userID of this file user (system file are owned by ROOT : 1 , i-node that is not in use is owned by NULL:0)
 			uint16_t accessMode;//flag can be combined by 'OR' operation
-			uint32_t address;
-			uint32_t size;//file byte size
+			bool isInline;//address is meaningless if data is stored inline
+			uint64_t address;
+			uint64_t size;//file byte size
 		};
 
 		//result of enumeration of target directory
@@ -79,6 +119,23 @@ namespace Noise3D
 		};
 
 
+		//options of a tree walk (IFileSystem::Walk)
+		struct N_FileSystemWalkOptions
+		{
+			N_FileSystemWalkOptions() :maxDepth(0xffffffff), isFolderReported(false), threadCount(0) {}
+
+			uint32_t maxDepth;//children of the start dir are at depth 1, deeper folders are not read
+			std::string pathPrefix;//only paths that start with it are reported, other subtrees are skipped unread (empty : no limit)
+			bool isFolderReported;//folders are also given to predicate & callback
+			uint32_t threadCount;//0 : decided by hardware concurrency
+		};
+
+		//decide if a walked child matches (called by worker threads concurrently)
+		typedef std::function<bool(const char* name, const N_IndexNode& node, bool isFolder)> N_WalkPredicate;
+
+		//receive a matched child with its full path (calls are serialized)
+		typedef std::function<void(const std::string& path, const N_IndexNode& node, bool isFolder)> N_WalkCallback;
+
 		class IFile;
 
 		//********************************************************************
@@ -97,12 +154,28 @@ namespace Noise3D
 			//create a virtual disk on hard disk (a binary file)
 			bool CreateVirtualDisk(NFilePath filePath, NOISE_VIRTUAL_DISK_CAPACITY cap);
 
-			//load the whole virtual disk IMAGE into memory
-			bool InstallVirtualDisk(NFilePath virtualDiskImagePath);
+			//create a virtual disk with custom capacity, i-node count and allocation block size
+			bool CreateVirtualDisk(NFilePath filePath, const N_VirtualDiskFormatOptions& options);
+
+			//load the whole virtual disk IMAGE into memory. a read-only install maps the image file instead,
+			//shared by every process that installs it read-only, and rejects every modification. one
+			//writer or any count of read-only installs hold an image at a time (locked on host file)
+			bool InstallVirtualDisk(NFilePath virtualDiskImagePath, bool isReadOnly = false);
 
 			//write the VDisk image back to hard disk
 			void UninstallVirtualDisk();
 
+			//enlarge the installed virtual disk without un-installing it (can't shrink), the grown image
+			//is written back at once (false : nothing has changed). newIndexNodeCount=0 : i-node table
+			//grows in proportion to capacity
+			bool GrowVirtualDisk(uint64_t newCapacity, uint32_t newIndexNodeCount = 0);
+
+			//give host storage of freed user space back to host file system (hole punching).
+			//only ranges freed since last trim are punched, unless all free space is required. space
+			//that the image file still refers to (freed since last write back) waits for the next trim.
+			//if too many ranges were freed to be kept, all free space is trimmed. (also done when un-installing)
+			bool Trim(bool isAllFreeSpaceTrimmed = false);
+
 
 			bool Login(std::string userName, std::string password);
 
@@ -116,35 +189,130 @@ namespace Noise3D
 
 			void EnumerateFilesAndDirs(N_FileSystemEnumResult& outResult);
 
-			bool CreateFile(std::string fileName, uint32_t byteSize,NOISE_FILE_ACCESS_MODE acMode);//a new file under current working directory
+			//walk the tree under startDir (absolute path) on a worker pool, matches of predicate are streamed
+			//to callback. the file system mustn't be modified within predicate or callback
+			//(null predicate : everything matches, null callback : matches are only counted)
+			bool Walk(std::string startDir, const N_FileSystemWalkOptions& options, N_WalkPredicate predicate, N_WalkCallback callback);
+
+			bool CreateFile(std::string fileName, uint64_t byteSize,NOISE_FILE_ACCESS_MODE acMode);//a new file under current working directory
 
 			bool DeleteFile(std::string fileName);//can be done only if the file is CLOSED!!
 
 			IFile* OpenFile(std::string fileName);
 
+			//rename or move a file/folder (paths are absolute, or relative to working dir). only the directory
+			//entries are rewritten, i-node and data stay, so a folder moves at the same cost whatever its size.
+			//an opened file can't be renamed, a folder can't be moved into itself
+			bool Rename(std::string oldPath, std::string newPath);
+
+			//reflink-style copy : the new file shares the extent of source file, no data is copied.
+			//the first write (or resize) of either file copies the extent (copy-on-write)
+			bool CloneFile(std::string srcPath, std::string dstPath);
+
 			bool CloseFile(IFile* pFile);//SAVE and UPDATE data to hard disk
 
-			uint32_t GetVDiskCapacity();
+			//copy a host file into a new file of virtual disk (path is absolute, or relative to working dir).
+			//data is read by positional I/O right into the extent of new file, large files by several threads
+			bool ImportFile(NFilePath hostFilePath, std::string filePath);
+
+			//copy a file of virtual disk into a host file (created, or overwritten), written right from its extent
+			bool ExportFile(std::string filePath, NFilePath hostFilePath);
+
+			//copy a host folder tree into a new folder of virtual disk. host tree is listed first, i-nodes, user space
+			//and directory files are made at once (like ImportArchive), then data of all files is read by a pool
+			//of threads at once. nothing is left if it fails
+			bool ImportDirectory(NFilePath hostDirPath, std::string dirPath);
 
-			uint32_t GetVDiskUsedSize();
+			//write a folder subtree (folders, i-node metadata and data) into one sequential archive file
+			//(see Archive.h). compressed files stay compressed, opened files are archived as they are now
+			bool ExportArchive(std::string dirPath, NFilePath archivePath);
 
-			uint32_t GetVDiskFreeSize();//free space left for USER FILE in virtual disk
+			//rebuild an archived subtree as a new folder. i-nodes and user space are allocated at once
+			//(one contiguous run if there is one), then data is streamed in. nothing is left if it fails
+			bool ImportArchive(NFilePath archivePath, std::string dirPath);
+
+			uint64_t GetVDiskCapacity();
+
+			uint64_t GetVDiskUsedSize();
+
+			uint64_t GetVDiskFreeSize();//free space left for USER FILE in virtual disk
+
+			uint64_t GetVDiskImageHugePageSize();//bytes of the in-memory image backed by huge pages
+
+			bool IsVDiskReadOnly();
+
+			uint32_t GetVDiskBlockSize();//allocation granularity of user file space
 
 			const uint32_t GetNameMaxLength();
 
+			//secondary indexes for attribute queries (built by one tree walk, then maintained on
+			//create/delete/resize). the index is rebuilt whenever a virtual disk is installed
+			bool EnableMetadataIndex(bool isEnabled);
+
+			CMetadataIndex* GetMetadataIndex();//null if disabled
+
+			//compress a closed file under current working directory (chunked LZ4). reads decompress only
+			//the chunks they touch, the first write or resize stores the file uncompressed again
+			bool CompressFile(std::string fileName);
+
+			//identical files share one extent (refcounted, copy-on-write as CloneFile). with inline
+			//deduplication enabled, a file is fingerprinted and deduplicated whenever it is closed
+			bool EnableDeduplication(bool isEnabled);
+
+			CDedupIndex* GetDedupIndex();//null if inline deduplication is disabled
+
+			//offline pass : fingerprint every closed file and deduplicate the whole tree
+			bool DeduplicateFiles(N_DedupReport& outReport);
+
+			//point-in-time snapshot of installed virtual disk (one at a time). i-node table is copied,
+			//user space is copied per block only when it is modified afterwards (copy-on-write)
+			bool CreateSnapshot();
+
+			//stream the snapshot into a new image file while the live virtual disk stays in use.
+			//the file can be installed (or backed up) like any virtual disk
+			bool WriteSnapshot(NFilePath imageFilePath);
+
+			void ReleaseSnapshot();
+
+			//background verification of installed image file against its block checksums, reading at most
+			//bytesPerSecond (0 : not limited). it stops when the virtual disk is un-installed
+			bool StartScrubber(uint64_t bytesPerSecond);
+
+			void StopScrubber();
+
+			//corruption found since the virtual disk was installed (install verification and scrubber)
+			void GetChecksumReport(N_ChecksumReport& outReport);
+
+			bool StartTraceRecording(NFilePath traceFilePath);//record public calls into a binary trace (see TraceRecorder.h)
+
+			void StopTraceRecording();
+
 		private:
 
+			friend class CFileSystemChecker;
+			friend class CScrubber;
+			friend class IFile;
+
 			struct N_VirtualDiskHeaderInfo
 			{
 				const uint32_t c_magicNumber = c_FileSystemMagicNumber;
 				const uint32_t c_versionNumber = c_FileSystemVersion;
-				uint32_t diskCapacity;
-				uint32_t diskHeaderLength;//including i-node table
+				uint64_t diskCapacity;
+				uint64_t diskHeaderLength;//including i-node table (user space starts here)
 				uint32_t indexNodeCount;
+				uint32_t blockSize;
+				uint32_t checksumBlockSize;
+				uint32_t indexNodeTableChecksum;//CRC32C
 				//i-node table
+				//user space
+				//CRC32C of user space blocks (4 bytes per checksum block, after user space so that
+				//growing capacity doesn't move user space)
 			};
 
-			//items in an directory file
+			//items in an directory file (in memory). directory file packs them as :
+			//	folderCount(4) | fileCount(4) | nameHash(4) x n | indexNodeId(4) x n |
+			//	nameOffset(4) x n | [nameLength(1) | name(nameLength)] x n
+			//(n = folderCount + fileCount, folders come first, names are not padded)
 			struct N_DirFileRecord
 			{
 				N_DirFileRecord() { for (int i = 0; i < 124; ++i)name[i] = 0; indexNodeId = 0; }
@@ -153,39 +321,166 @@ namespace Noise3D
 				uint32_t indexNodeId;
 			};
 
+			bool				mFunction_InstallVirtualDisk(const NFilePath& virtualDiskImagePath);
+
+			bool				mFunction_IsWritable(const std::string& operationName);//false (and logged) on a read-only install
+
+			bool				mFunction_Login(std::string userName, std::string password);
+
+			bool				mFunction_SetWorkingDir(std::string dir);
+
+			bool				mFunction_CreateFolder(std::string folderName);
+
+			bool				mFunction_DeleteFolder(std::string folderName);
+
+			void				mFunction_EnumerateFilesAndDirs(N_FileSystemEnumResult& outResult);
+
+			bool				mFunction_Walk(const std::string& startDir, const N_FileSystemWalkOptions& options, const N_WalkPredicate& predicate, const N_WalkCallback& callback, uint64_t& outMatchCount);
+
+			bool				mFunction_ResolveDirectory(const std::string& dir, uint32_t& outIndexNodeId);//absolute path to i-node, working dir is not changed
+
+			bool				mFunction_CreateFile(std::string fileName, uint64_t byteSize, NOISE_FILE_ACCESS_MODE acMode);
+
+			bool				mFunction_DeleteFile(std::string fileName);
+
+			IFile*			mFunction_OpenFile(std::string fileName);
+
+			bool				mFunction_Rename(const std::string& oldPath, const std::string& newPath);
+
+			bool				mFunction_CloneFile(const std::string& srcPath, const std::string& dstPath);
+
+			bool				mFunction_ImportFile(const NFilePath& hostFilePath, const std::string& filePath);
+
+			bool				mFunction_ExportFile(const std::string& filePath, const NFilePath& hostFilePath);
+
+			bool				mFunction_ImportDirectory(const NFilePath& hostDirPath, const std::string& dirPath);
+
+			bool				mFunction_ExportArchive(const std::string& dirPath, const NFilePath& archivePath);
+
+			bool				mFunction_ImportArchive(const NFilePath& archivePath, const std::string& dirPath);
+
+			bool				mFunction_ResolveParent(const std::string& path, uint32_t& outDirIndexNodeId, std::string& outName);//folder that holds the path, and the last name
+
+			bool				mFunction_RunInDirectory(uint32_t dirIndexNodeId, const std::function<bool()>& operation);//operation on working dir is done in another folder
+
+			bool				mFunction_ResolveFolderPath(const std::string& path, uint32_t& outIndexNodeId);//folder path, absolute or relative to working dir
+
+			bool				mFunction_ImportEntry(uint32_t dirIndexNodeId, const std::string& name, bool isFolder, uint64_t byteSize, uint32_t& outIndexNodeId);//new file or folder
+
+			//detached subtree (entries like an archive's, names[0] unused) : i-nodes and extents are allocated at once
+			//(one contiguous run if there is one), i-nodes & directory files are written, file data is left to the caller
+			bool				mFunction_CreateSubtree(const std::vector<N_ArchiveEntry>& entries, const std::vector<std::string>& names, std::vector<uint32_t>& outINodeNums, std::vector<N_AddressRange>& outAllocatedRanges, bool& outIsContiguous);
+
+			void				mFunction_ReleaseSubtree(std::vector<uint32_t>& iNodeNums, std::vector<N_AddressRange>& allocatedRanges);//undo of a detached subtree
+
+			bool				mFunction_LinkSubtree(uint32_t parentINodeNum, const std::string& dirName, const std::vector<N_ArchiveEntry>& entries, const std::vector<uint32_t>& iNodeNums);
+
+			bool				mFunction_UnshareExtent(IFile* pFile);//give the file an own copy of its extent if it is shared
+
+			bool				mFunction_PrepareFileWrite(IFile* pFile, uint64_t startIndex, uint64_t size);//copy-on-write of clones and snapshot
+
+			void				mFunction_PreserveSnapshot(uint64_t address, uint64_t size);//user space is about to be modified
+
+			bool				mFunction_CompressFile(std::string fileName);
+
+			bool				mFunction_DecompressFile(IFile* pFile);//compressed file is stored raw again
+
+			bool				mFunction_ReadCompressedFile(IFile* pFile, char* pOutData, uint64_t startIndex, uint64_t size);
+
+			void				mFunction_PrefetchFile(IFile* pFile, uint64_t startIndex, uint64_t size);
+
+			void				mFunction_DeduplicateFile(uint32_t fileIndexNodeNum, CDedupIndex& index, N_DedupReport& report);//share extent of an identical indexed file
+
+			void				mFunction_GetPathFolders(const std::string& path, std::vector<std::string>& outFolders);//folder names from root (relative path starts from working dir)
+
+			bool				mFunction_CloseFile(IFile* pFile);
+
 			template<typename T>
-			void				mFunction_ReadData(uint32_t srcOffset,T& destData);//read data from VDisk image
+			void				mFunction_ReadData(uint64_t srcOffset,T& destData);//read data from VDisk image
 
 			template<typename T>
-			void				mFunction_WriteData(uint32_t destOffset, T& srcData);//write data to VDisk image
+			void				mFunction_WriteData(uint64_t destOffset, T& srcData);//write data to VDisk image
+
+			uint64_t		mFunction_GetAllocationSize(uint64_t byteSize);//byte size rounded up to allocation block
+
+			uint64_t		mFunction_AllocateFileSpace(uint64_t byteSize);//c_invalid_alloc_address for failure
+
+			void				mFunction_ReleaseFileSpace(uint64_t address, uint64_t byteSize);
+
+			void				mFunction_QueueFreedRange(uint64_t start, uint64_t size);//host storage is trimmed later
 
 			bool				mFunction_NameValidation(const std::string& name);
 
-			void				mFunction_ReadDirectoryFile(uint32_t dirFileAddress,uint32_t& outFolderCount, uint32_t& outFileCount, std::vector<N_DirFileRecord>& outChildFolders, std::vector<N_DirFileRecord>& outChildFiles);
+			static uint32_t	mFunction_HashName(const char* pName, uint32_t length);
+
+			uint64_t		mFunction_GetDirectoryFileSize(const std::vector<N_DirFileRecord>& childFolders, const std::vector<N_DirFileRecord>& childFiles);
+
+			//false if directory file is broken (records before the broken one are still read)
+			bool				mFunction_ReadDirectoryFile(const N_IndexNode& dirNode,uint32_t& outFolderCount, uint32_t& outFileCount, std::vector<N_DirFileRecord>& outChildFolders, std::vector<N_DirFileRecord>& outChildFiles);
+
+			void				mFunction_WriteDirectoryFile(uint64_t dirFileAddress, uint32_t inFolderCount, uint32_t inFileCount, std::vector<N_DirFileRecord>& inChildFolders, std::vector<N_DirFileRecord>& inChildFiles);
+
+			bool				mFunction_UpdateDirectoryFile(N_IndexNode* pDirNode, std::vector<N_DirFileRecord>& childFolders, std::vector<N_DirFileRecord>& childFiles);//re-allocate and re-write
 
-			void				mFunction_WriteDirectoryFile(uint32_t dirFileAddress, uint32_t inFolderCount, uint32_t inFileCount, std::vector<N_DirFileRecord>& inChildFolders, std::vector<N_DirFileRecord>& inChildFiles);
+			bool				mFunction_FindInDirectory(const N_IndexNode& dirNode, const std::string& name, bool isFolder, uint32_t& outIndexNodeId);//no record is copied
 
 			void				mFunction_ReleaseFileSpace(uint32_t fileIndexNodeNum);
 
+			char*				mFunction_GetFileBuffer(N_IndexNode& node);//inline data or extent in memory image
+
+			bool				mFunction_ResizeFile(IFile* pFile, uint64_t newByteSize);
+
+			bool				mFunction_WriteBackImage();//header, i-node table and allocated user space only
+
+			void				mFunction_RelayoutImage(uint64_t capacity, uint32_t indexNodeCount);//grow (or undo a grow) in memory
+
+			static uint64_t	mFunction_GetHeaderLength(uint32_t indexNodeCount);//header and i-node table
+
+			static uint64_t	mFunction_GetChecksumAreaSize(uint64_t capacity);//block checksums (they follow user space)
+
+			uint64_t		mFunction_GetChecksumAreaOffset();
+
+			void				mFunction_GetAllocatedBlocks(std::vector<N_AddressRange>& outBlockRanges);//runs of checksum blocks that overlap allocated user space
+
+			void				mFunction_VerifyChecksums();//i-node table and allocated blocks of installed image
+
 			bool				mFunction_RecursiveFolderDelete(uint32_t dirFileIndexNodeNum);//delete all child-folders and files under this folder including the folder itself
 
+			void				mFunction_RebuildMetadataIndex();
+
+			void				mFunction_CollectSubtreeParallel(uint32_t dirFileIndexNodeNum, std::vector<uint32_t>& outIndexNodes);//i-nodes of the subtree (folder itself included), every folder is a task of worker threads
+
 			static const uint32_t	c_FileAndDirNameMaxLength = 120;//sizeof(dirFileItem)-sizeof(i-node)=128-4=124, but for safety, round it to 120
 			static const uint32_t	c_FileSystemMagicNumber = 0x12345678;
-			static const uint32_t	c_FileSystemVersion = 0x20170727;//init stage check file system version
-			static const uint32_t	c_DirectoryFileItemSize = 128;//124+4
+			static const uint32_t	c_FileSystemVersion = 0x20261108;//init stage check file system version (block checksums after user space)
+			static const uint32_t	c_FreedRangeListMaxSize = 65536;//more freed ranges are not kept, all free space is trimmed instead
 			std::fstream*							m_pVirtualDiskFile;
-			std::vector<char>*					m_pVirtualDiskImage;//Mapped-virtual disk in lying in memory 
+			CImageBuffer*						m_pVirtualDiskImage;//Mapped-virtual disk in lying in memory 
 			std::vector<N_IndexNode>*	m_pIndexNodeList;//i-node list
-			uint32_t				mVDiskImageSize;//the total size of VDisk
-			uint32_t				mVDiskCapacity;//file space capacity
-			uint32_t				mVDiskHeaderLength;	//(header and i-node table are skipped)
+			std::vector<N_AddressRange>*	m_pFreedRangeList;//user space freed since last trim
+			std::vector<N_AddressRange>*	m_pWrittenBackFreeSegments;//free user space of image file (as of last write back or install)
+			NFilePath*							m_pVirtualDiskImagePath;
+			uint64_t				mVDiskImageSize;//the total size of VDisk
+			uint64_t				mVDiskCapacity;//file space capacity
+			uint64_t				mVDiskHeaderLength;	//(header and i-node table are skipped)
+			uint32_t				mVDiskBlockSize;//allocation granularity of user file space
 			CAllocator*			m_pIndexNodeAllocator;
 			CAllocator*			m_pFileAddressAllocator;
 			bool						mIsVDiskInitialized;
+			bool						mIsImageFileStale;//last write back failed, image file can't be scrubbed or trimmed till written back
+			bool						mIsFreedRangeListOverflowed;//freed ranges were dropped, next trim covers all free space
+			bool						mIsVDiskReadOnly;//image is a read-only shared mapping of image file
+			intptr_t					mHostFileLockHandle;//held while installed
 			uint8_t					mLoggedInAccountID;
 
 			N_IndexNode*		m_pCurrentDirIndexNode;
 			std::string*			m_pCurrentWorkingDir;
+			CTraceRecorder*	m_pTraceRecorder;//null if trace recording is disabled
+			CMetadataIndex*	m_pMetadataIndex;//null if metadata index is disabled
+			CSnapshot*			m_pSnapshot;//null if no snapshot is taken
+			CDedupIndex*		m_pDedupIndex;//null if inline deduplication is disabled
+			CScrubber*			m_pScrubber;//null if scrubber isn't running
+			N_ChecksumReport*	m_pChecksumReport;
 		};
 
 
@@ -193,11 +488,15 @@ namespace Noise3D
 		{
 		public:
 
-			UINT	GetFileSize();
+			uint64_t	GetFileSize();
 			//read
-			void Read(char* pOutData,uint32_t startIndex,uint32_t size);
-			//write, but not immediately update to hard disk
-			void Write(char* pSrcData, uint32_t startIndex, uint32_t size);
+			void Read(char* pOutData,uint64_t startIndex,uint64_t size);
+			//write, but not immediately update to hard disk (false : nothing is written)
+			bool Write(char* pSrcData, uint64_t startIndex, uint64_t size);
+			//grow or shrink, new bytes are zero (tiny files are moved between i-node and extent)
+			bool Resize(uint64_t newSize);
+			//hint that a range is read soon : pages of a mapped image are read in ahead (not waited for)
+			void Prefetch(uint64_t startIndex, uint64_t size);
 
 		private:
 
@@ -206,12 +505,21 @@ namespace Noise3D
 			friend		IFactory<IFile>;
 			friend		IFileSystem;
 
+			void			mFunction_Read(char* pOutData, uint64_t startIndex, uint64_t size);
+
+			bool			mFunction_Write(char* pSrcData, uint64_t startIndex, uint64_t size);
+
 			bool			mIsFileOpened;//file has been written, data needs to write to hard disk
 			bool			mAccessMode_Read;
 			bool			mAccessMode_Write;
 			uint32_t	mFileIndexNodeNumber;
-			uint32_t	mFileSize;
+			uint64_t	mFileSize;
 			char*		m_pFileBuffer;
+			std::vector<N_DecompressedChunk>* m_pChunkCache;//null if file isn't compressed
+			uint64_t	mChunkUseTime;
+			IFileSystem* m_pFileSystem;
+			CTraceRecorder* m_pTraceRecorder;
+			uint32_t	mTraceFileHandle;
 		};
 	}
 }
\ No newline at end of file
@@ -0,0 +1,465 @@
+
+/***********************************************************************
+
+									cppFile System Checker
+
+************************************************************************/
+
+#include "Noise3D.h"
+
+using namespace Noise3D::Core;
+
+CFileSystemChecker::CFileSystemChecker(IFileSystem & fs) :
+	mFs(fs),
+	mActiveWorkerCount(0),
+	m_pVisitedFlags(nullptr)
+{
+}
+
+bool CFileSystemChecker::Check(N_FileSystemCheckReport & outReport, bool isRepairEnabled, uint32_t threadCount)
+{
+	outReport = N_FileSystemCheckReport();
+	if (!mFs.mIsVDiskInitialized)
+	{
+		ERROR_MSG("FileSystemChecker : Check failure! virtual disk is not installed.");
+		outReport.messages.push_back("virtual disk is not installed.");
+		return false;
+	}
+
+	if (isRepairEnabled && mFs.mIsVDiskReadOnly)
+	{
+		ERROR_MSG("FileSystemChecker : repair is skipped, virtual disk is installed read-only.");
+		isRepairEnabled = false;
+	}
+
+	if (threadCount == 0)threadCount = std::max<uint32_t>(1, std::thread::hardware_concurrency());
+
+	std::vector<N_WorkerResult> results;
+	mFunction_Scan(outReport, results, threadCount);
+
+	if (isRepairEnabled && !outReport.IsConsistent())
+	{
+		mFunction_Repair(results);
+		mFunction_RebuildAllocators();
+		if (mFs.m_pMetadataIndex != nullptr)mFs.mFunction_RebuildMetadataIndex();
+		if (mFs.m_pDedupIndex != nullptr)mFs.m_pDedupIndex->Clear();//(fingerprints may refer to freed i-nodes, files are indexed again when closed)
+
+		//check again to report what remains
+		N_FileSystemCheckReport repairedReport;
+		mFunction_Scan(repairedReport, results, threadCount);
+		repairedReport.isRepaired = true;
+		repairedReport.messages.insert(repairedReport.messages.begin(), outReport.messages.begin(), outReport.messages.end());
+		outReport = repairedReport;
+	}
+
+	return outReport.IsConsistent();
+}
+
+/***********************************************************
+
+								PRIVATE
+
+************************************************************/
+
+void CFileSystemChecker::mFunction_Scan(N_FileSystemCheckReport & outReport, std::vector<N_WorkerResult>& outResults, uint32_t threadCount)
+{
+	uint32_t inodeCount = uint32_t(mFs.m_pIndexNodeList->size());
+	m_pVisitedFlags = new std::atomic<uint8_t>[inodeCount];
+	for (uint32_t i = 0; i < inodeCount; ++i)m_pVisitedFlags[i] = 0;
+
+	outResults.clear();
+	outResults.resize(threadCount);
+
+	//root directory (i-node 0)
+	if (mFs.m_pIndexNodeList->at(0).ownerUserID == NOISE_FILE_OWNER_NULL)
+	{
+		outReport.messages.push_back("root directory i-node 0 is not in use.");
+		++outReport.danglingRecordCount;
+	}
+	else
+	{
+		mFunction_VisitINode(0);
+		N_DirTask rootTask = { 0, "/" };
+		mTaskStack.push_back(rootTask);
+		outResults.at(0).reachedDirs.push_back(0);
+	}
+
+	//walk the directory tree in parallel, every directory file is a task
+	mActiveWorkerCount = 0;
+	std::vector<std::thread> workers;
+	for (uint32_t i = 0; i < threadCount; ++i)
+		workers.push_back(std::thread(&CFileSystemChecker::mFunction_WorkerLoop, this, std::ref(outResults.at(i))));
+	for (auto& w : workers)w.join();
+
+	//merge results of workers
+	std::vector<uint32_t> reachedINodes;
+	for (auto& r : outResults)
+	{
+		outReport.directoryCount += uint32_t(r.reachedDirs.size());
+		outReport.fileCount += uint32_t(r.reachedFiles.size());
+		outReport.danglingRecordCount += r.danglingRecordCount;
+		outReport.multiplyLinkedINodeCount += r.multiplyLinkedINodeCount;
+		outReport.dirSizeMismatchCount += r.dirSizeMismatchCount;
+		outReport.duplicateNameCount += r.duplicateNameCount;
+		outReport.messages.insert(outReport.messages.end(), r.messages.begin(), r.messages.end());
+		reachedINodes.insert(reachedINodes.end(), r.reachedDirs.begin(), r.reachedDirs.end());
+		reachedINodes.insert(reachedINodes.end(), r.reachedFiles.begin(), r.reachedFiles.end());
+	}
+
+	mFunction_CheckExtents(reachedINodes, outReport);
+
+	//leaked i-nodes : in use, but unreachable
+	uint32_t inUseINodeCount = 0;
+	for (uint32_t i = 0; i < inodeCount; ++i)
+	{
+		if (mFs.m_pIndexNodeList->at(i).ownerUserID == NOISE_FILE_OWNER_NULL)continue;
+		++inUseINodeCount;
+		if (m_pVisitedFlags[i] == 0)
+		{
+			++outReport.leakedINodeCount;
+			outReport.messages.push_back("leaked i-node " + std::to_string(i) + " (in use but unreachable from root).");
+		}
+	}
+
+	//allocators should agree with reachable i-nodes
+	uint64_t expectedFreeSpace = mFs.mVDiskCapacity - outReport.usedBytes;
+	if (mFs.m_pFileAddressAllocator->GetFreeSpace() != expectedFreeSpace)
+	{
+		outReport.isAllocatorConsistent = false;
+		outReport.messages.push_back("file address allocator reports " + std::to_string(mFs.m_pFileAddressAllocator->GetFreeSpace()) +
+			" free bytes, but reachable extents leave " + std::to_string(expectedFreeSpace) + " bytes.");
+	}
+	if (mFs.m_pIndexNodeAllocator->GetFreeSpace() != inodeCount - inUseINodeCount)
+	{
+		outReport.isAllocatorConsistent = false;
+		outReport.messages.push_back("i-node allocator reports " + std::to_string(mFs.m_pIndexNodeAllocator->GetFreeSpace()) +
+			" free i-nodes, but " + std::to_string(inodeCount - inUseINodeCount) + " i-nodes are not in use.");
+	}
+
+	delete[] m_pVisitedFlags;
+	m_pVisitedFlags = nullptr;
+}
+
+void CFileSystemChecker::mFunction_WorkerLoop(N_WorkerResult & result)
+{
+	while (true)
+	{
+		N_DirTask task;
+		{
+			std::unique_lock<std::mutex> lock(mTaskLock);
+			//wait until there is a task, or no worker could produce one any more
+			mTaskCondition.wait(lock, [this]() {return !mTaskStack.empty() || mActiveWorkerCount == 0; });
+			if (mTaskStack.empty())
+			{
+				mTaskCondition.notify_all();
+				return;
+			}
+			task = mTaskStack.back();
+			mTaskStack.pop_back();
+			++mActiveWorkerCount;
+		}
+
+		mFunction_CheckDirectory(task, result);
+
+		{
+			std::lock_guard<std::mutex> lock(mTaskLock);
+			--mActiveWorkerCount;
+		}
+		mTaskCondition.notify_all();
+	}
+}
+
+void CFileSystemChecker::mFunction_CheckDirectory(const N_DirTask & task, N_WorkerResult & result)
+{
+	std::vector<IFileSystem::N_DirFileRecord> folders, files;
+	std::string errorMsg;
+	if (!mFunction_ReadDirectory(task.indexNodeId, folders, files, errorMsg))
+	{
+		result.messages.push_back("directory " + task.path + " : " + errorMsg);
+		++result.dirSizeMismatchCount;
+		result.badSizeDirs.push_back(task.indexNodeId);
+	}
+
+	uint32_t inodeCount = uint32_t(mFs.m_pIndexNodeList->size());
+	auto checkRecord = [&](const IFileSystem::N_DirFileRecord& record, bool isFolder) ->bool
+	{
+		std::string name(record.name, strnlen(record.name, sizeof(record.name)));
+		N_BadRecord badRecord = { task.indexNodeId, record.indexNodeId, name };
+		if (record.indexNodeId >= inodeCount || mFs.m_pIndexNodeList->at(record.indexNodeId).ownerUserID == NOISE_FILE_OWNER_NULL)
+		{
+			result.messages.push_back(task.path + name + " : refers to freed or invalid i-node " + std::to_string(record.indexNodeId) + ".");
+			++result.danglingRecordCount;
+			result.badRecords.push_back(badRecord);
+			return false;
+		}
+		if (!mFunction_VisitINode(record.indexNodeId))
+		{
+			result.messages.push_back(task.path + name + " : i-node " + std::to_string(record.indexNodeId) + " is referred more than once.");
+			++result.multiplyLinkedINodeCount;
+			result.badRecords.push_back(badRecord);
+			return false;
+		}
+		if (isFolder)
+		{
+			N_DirTask childTask = { record.indexNodeId, task.path + name + "/" };
+			result.reachedDirs.push_back(record.indexNodeId);
+			std::lock_guard<std::mutex> lock(mTaskLock);
+			mTaskStack.push_back(childTask);
+			mTaskCondition.notify_one();
+		}
+		else
+		{
+			result.reachedFiles.push_back(record.indexNodeId);
+		}
+		return true;
+	};
+
+	//(folders and files of a directory are found by name separately)
+	std::unordered_set<std::string> folderNames, fileNames;
+	auto checkName = [&](const IFileSystem::N_DirFileRecord& record, std::unordered_set<std::string>& names)
+	{
+		std::string name(record.name, strnlen(record.name, sizeof(record.name)));
+		if (names.insert(name).second)return;
+		result.messages.push_back(task.path + name + " : name is used more than once, i-node " + std::to_string(record.indexNodeId) + " can't be found by name.");
+		++result.duplicateNameCount;
+	};
+
+	for (auto& folder : folders)
+	{
+		checkName(folder, folderNames);
+		checkRecord(folder, true);
+	}
+	for (auto& file : files)
+	{
+		checkName(file, fileNames);
+		checkRecord(file, false);
+	}
+}
+
+bool CFileSystemChecker::mFunction_ReadDirectory(uint32_t dirIndexNodeId, std::vector<IFileSystem::N_DirFileRecord>& outFolders, std::vector<IFileSystem::N_DirFileRecord>& outFiles, std::string & outErrorMsg)
+{
+	const N_IndexNode& dirNode = mFs.m_pIndexNodeList->at(dirIndexNodeId);
+	outFolders.clear();
+	outFiles.clear();
+
+	if (dirNode.size < 8 || dirNode.isInline() || dirNode.address > mFs.mVDiskCapacity || dirNode.size > mFs.mVDiskCapacity - dirNode.address)
+	{
+		outErrorMsg = "directory file [" + std::to_string(dirNode.address) + "," + std::to_string(dirNode.address + dirNode.size) + ") is invalid.";
+		return false;
+	}
+
+	//records are only read within the directory file. a broken record ends the directory
+	uint32_t folderCount = 0, fileCount = 0;
+	if (!mFs.mFunction_ReadDirectoryFile(dirNode, folderCount, fileCount, outFolders, outFiles))
+	{
+		outErrorMsg = "directory file of " + std::to_string(dirNode.size) + " bytes is broken, only " +
+			std::to_string(outFolders.size() + outFiles.size()) + " records are readable.";
+		return false;
+	}
+
+	uint64_t expectedSize = mFs.mFunction_GetDirectoryFileSize(outFolders, outFiles);
+	if (expectedSize != dirNode.size)
+	{
+		outErrorMsg = std::to_string(folderCount) + " folders and " + std::to_string(fileCount) + " files need " +
+			std::to_string(expectedSize) + " bytes, but i-node size is " + std::to_string(dirNode.size) + ".";
+		return false;
+	}
+	return true;
+}
+
+bool CFileSystemChecker::mFunction_VisitINode(uint32_t indexNodeId)
+{
+	return m_pVisitedFlags[indexNodeId].exchange(1) == 0;
+}
+
+void CFileSystemChecker::mFunction_CheckExtents(const std::vector<uint32_t>& reachedINodes, N_FileSystemCheckReport & report)
+{
+	struct N_Extent { uint64_t start; uint64_t end; uint32_t indexNodeId; bool isShared; };
+	std::vector<N_Extent> extents;
+	extents.reserve(reachedINodes.size());
+
+	for (uint32_t id : reachedINodes)
+	{
+		const N_IndexNode& node = mFs.m_pIndexNodeList->at(id);
+		if (node.isInline() && node.size > c_IndexNodeInlineDataMaxSize)
+		{
+			++report.outOfRangeExtentCount;
+			report.messages.push_back("i-node " + std::to_string(id) + " : inline data of " + std::to_string(node.size) + " bytes exceeds i-node.");
+			continue;
+		}
+		if (node.size == 0 || node.isInline())continue;
+
+		//extents occupy whole allocation blocks
+		N_Extent e = { node.address, node.address + mFs.mFunction_GetAllocationSize(node.extentSize()), id, (node.flags & NOISE_INDEX_NODE_FLAG_SHARED) != 0 };
+		if (node.address > mFs.mVDiskCapacity || node.extentSize() > mFs.mVDiskCapacity - node.address)
+		{
+			++report.outOfRangeExtentCount;
+			report.messages.push_back("i-node " + std::to_string(id) + " : extent [" + std::to_string(e.start) + "," + std::to_string(e.end) + ") exceeds user file space.");
+			continue;
+		}
+		report.usedBytes += e.end - e.start;
+		extents.push_back(e);
+	}
+
+	//interval check : sorted by start, every extent must begin after the farthest end so far.
+	//clones share an identical extent (adjacent after sorting), which must be referred as many times in allocator
+	std::sort(extents.begin(), extents.end(), [](const N_Extent& a, const N_Extent& b) {return a.start < b.start || (a.start == b.start && a.end < b.end); });
+	uint64_t farthestEnd = 0;
+	uint32_t farthestOwner = 0;
+	const N_Extent* pLastExtent = nullptr;
+	uint32_t sharerCount = 1;
+	auto checkReferenceCount = [&]()
+	{
+		if (pLastExtent == nullptr || !pLastExtent->isShared)return;
+		uint32_t referenceCount = mFs.m_pFileAddressAllocator->GetReferenceCount(pLastExtent->start);
+		if (referenceCount == sharerCount)return;
+		report.isAllocatorConsistent = false;
+		report.messages.push_back("i-node " + std::to_string(pLastExtent->indexNodeId) + " : extent is shared by " + std::to_string(sharerCount) +
+			" files, but allocator counts " + std::to_string(referenceCount) + " references.");
+	};
+	for (auto& e : extents)
+	{
+		if (pLastExtent != nullptr && e.isShared && pLastExtent->isShared && e.start == pLastExtent->start && e.end == pLastExtent->end)
+		{
+			++sharerCount;
+			report.usedBytes -= e.end - e.start;//shared bytes are counted only once
+			continue;
+		}
+		checkReferenceCount();
+		pLastExtent = &e;
+		sharerCount = 1;
+
+		if (e.start < farthestEnd)
+		{
+			++report.overlappingExtentCount;
+			report.messages.push_back("i-node " + std::to_string(e.indexNodeId) + " : extent overlaps with i-node " + std::to_string(farthestOwner) + ".");
+			//overlapped bytes are counted only once
+			report.usedBytes -= std::min(e.end, farthestEnd) - e.start;
+		}
+		if (e.end > farthestEnd)
+		{
+			farthestEnd = e.end;
+			farthestOwner = e.indexNodeId;
+		}
+	}
+	checkReferenceCount();
+}
+
+void CFileSystemChecker::mFunction_Repair(const std::vector<N_WorkerResult>& results)
+{
+	//directories that need to be re-written : bad records are dropped, size is fixed
+	std::unordered_map<uint32_t, std::vector<const N_BadRecord*>> dirsToFix;
+	for (auto& r : results)
+	{
+		for (auto& bad : r.badRecords)dirsToFix[bad.parentIndexNodeId].push_back(&bad);
+		for (auto id : r.badSizeDirs)dirsToFix[id];
+	}
+
+	for (auto& pair : dirsToFix)
+	{
+		N_IndexNode& dirNode = mFs.m_pIndexNodeList->at(pair.first);
+		std::vector<IFileSystem::N_DirFileRecord> folders, files;
+		std::string errorMsg;
+		mFunction_ReadDirectory(pair.first, folders, files, errorMsg);
+
+		if (dirNode.size < 8 || dirNode.isInline() || dirNode.address > mFs.mVDiskCapacity || dirNode.size > mFs.mVDiskCapacity - dirNode.address)
+		{
+			//directory file itself is lost, the directory becomes an empty one in a new place
+			uint64_t newAddress = mFs.mFunction_AllocateFileSpace(8);
+			if (newAddress == c_invalid_alloc_address)continue;
+			dirNode.address = newAddress;
+		}
+
+		auto isBad = [&](const IFileSystem::N_DirFileRecord& record)
+		{
+			std::string name(record.name, strnlen(record.name, sizeof(record.name)));
+			for (auto pBad : pair.second)
+				if (pBad->indexNodeId == record.indexNodeId && pBad->name == name)return true;
+			return false;
+		};
+		folders.erase(std::remove_if(folders.begin(), folders.end(), isBad), folders.end());
+		files.erase(std::remove_if(files.begin(), files.end(), isBad), files.end());
+
+		//directory file is re-written at the same address if it still fits in its blocks
+		//(allocators are rebuilt after repair anyway)
+		uint32_t folderCount = uint32_t(folders.size());
+		uint32_t fileCount = uint32_t(files.size());
+		uint64_t newSize = mFs.mFunction_GetDirectoryFileSize(folders, files);
+		if (newSize > mFs.mFunction_GetAllocationSize(dirNode.size))
+		{
+			uint64_t newAddress = mFs.mFunction_AllocateFileSpace(newSize);
+			if (newAddress == c_invalid_alloc_address)continue;
+			dirNode.address = newAddress;
+		}
+		dirNode.size = newSize;
+		mFs.mFunction_WriteDirectoryFile(dirNode.address, folderCount, fileCount, folders, files);
+	}
+
+	//release leaked i-nodes (the directory tree is scanned again after dir records are fixed)
+	uint32_t inodeCount = uint32_t(mFs.m_pIndexNodeList->size());
+	std::vector<N_WorkerResult> tmpResults;
+	std::vector<uint8_t> isReachable(inodeCount, 0);
+	{
+		m_pVisitedFlags = new std::atomic<uint8_t>[inodeCount];
+		for (uint32_t i = 0; i < inodeCount; ++i)m_pVisitedFlags[i] = 0;
+		mFunction_VisitINode(0);
+		N_DirTask rootTask = { 0, "/" };
+		mTaskStack.push_back(rootTask);
+		tmpResults.resize(1);
+		mActiveWorkerCount = 0;
+		mFunction_WorkerLoop(tmpResults.at(0));
+		for (uint32_t i = 0; i < inodeCount; ++i)isReachable.at(i) = m_pVisitedFlags[i];
+		delete[] m_pVisitedFlags;
+		m_pVisitedFlags = nullptr;
+	}
+	for (uint32_t i = 0; i < inodeCount; ++i)
+	{
+		N_IndexNode& node = mFs.m_pIndexNodeList->at(i);
+		if (node.ownerUserID != NOISE_FILE_OWNER_NULL && !isReachable.at(i))node.reset();
+	}
+}
+
+void CFileSystemChecker::mFunction_RebuildAllocators()
+{
+	//(allocation policies are kept)
+	uint32_t inodeCount = uint32_t(mFs.m_pIndexNodeList->size());
+	NOISE_ALLOCATION_POLICY indexNodePolicy = mFs.m_pIndexNodeAllocator->GetPolicy();
+	NOISE_ALLOCATION_POLICY fileAddressPolicy = mFs.m_pFileAddressAllocator->GetPolicy();
+	delete mFs.m_pIndexNodeAllocator;
+	delete mFs.m_pFileAddressAllocator;
+	mFs.m_pIndexNodeAllocator = new CAllocator(inodeCount, indexNodePolicy);
+	mFs.m_pFileAddressAllocator = new CAllocator(mFs.mVDiskCapacity, fileAddressPolicy);
+
+	std::vector<N_AddressRange> extents;
+	std::unordered_map<uint64_t, uint32_t> sharerCounts;//start of shared extent -> clones
+	for (uint32_t i = 0; i < inodeCount; ++i)
+	{
+		N_IndexNode& node = mFs.m_pIndexNodeList->at(i);
+		if (node.ownerUserID == NOISE_FILE_OWNER_NULL)continue;
+		mFs.m_pIndexNodeAllocator->Allocate(i, 1);
+		if (node.isInline())continue;
+		uint64_t allocationSize = mFs.mFunction_GetAllocationSize(node.extentSize());
+		if (allocationSize > 0 && node.address <= mFs.mVDiskCapacity && allocationSize <= mFs.mVDiskCapacity - node.address)
+		{
+			if ((node.flags & NOISE_INDEX_NODE_FLAG_SHARED) && ++sharerCounts[node.address] > 1)continue;
+			extents.push_back(N_AddressRange(node.address, allocationSize));
+		}
+	}
+
+	//overlapping extents remain reported, but the allocator covers their union
+	std::sort(extents.begin(), extents.end(), [](const N_AddressRange& a, const N_AddressRange& b) {return a.start < b.start; });
+	uint64_t farthestEnd = 0;
+	for (auto& e : extents)
+	{
+		//a shared extent gets one more reference per clone (if it is a segment of its own)
+		if (e.start >= farthestEnd)
+			for (uint32_t i = 1; i < sharerCounts[e.start]; ++i)mFs.m_pFileAddressAllocator->AddReference(e.start);
+		uint64_t start = std::max(e.start, farthestEnd);
+		uint64_t end = e.start + e.size;
+		if (end > start)
+		{
+			mFs.m_pFileAddressAllocator->Allocate(start, end - start);
+			farthestEnd = end;
+		}
+	}
+}
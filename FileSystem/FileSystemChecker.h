@@ -0,0 +1,127 @@
+
+/***********************************************************************
+
+									hFile System Checker
+
+			Desc: consistency checker (fsck) of an installed virtual disk.
+			the directory tree is walked from i-node 0 by a pool of
+			worker threads (one directory file per task), then:
+				1. every dir record must refer to an in-use i-node,
+					and every i-node is referred at most once;
+				2. directory file must be well-formed and its size must
+					match its records, names of its folders (and of its
+					files) must be unique;
+				3. extents of reachable i-nodes must lie in the user
+					file space and must not overlap (interval check),
+					except identical extents shared by clones;
+				4. in-use i-nodes that are unreachable are leaked;
+				5. allocators must agree with the reachable i-nodes.
+			repair mode drops bad dir records, frees leaked i-nodes
+			and rebuilds both allocators. overlapping extents can only
+			be reported (which file owns the data can't be decided),
+			so can duplicate names (which one is meant can't be decided).
+
+************************************************************************/
+
+#pragma once
+
+namespace Noise3D
+{
+	namespace Core
+	{
+		struct N_FileSystemCheckReport
+		{
+			N_FileSystemCheckReport() :
+				directoryCount(0), fileCount(0), usedBytes(0),
+				danglingRecordCount(0), multiplyLinkedINodeCount(0), dirSizeMismatchCount(0), duplicateNameCount(0),
+				outOfRangeExtentCount(0), overlappingExtentCount(0), leakedINodeCount(0),
+				isAllocatorConsistent(true), isRepaired(false) {}
+
+			bool IsConsistent() const
+			{
+				return danglingRecordCount == 0 && multiplyLinkedINodeCount == 0 && dirSizeMismatchCount == 0 && duplicateNameCount == 0 &&
+					outOfRangeExtentCount == 0 && overlappingExtentCount == 0 && leakedINodeCount == 0 && isAllocatorConsistent;
+			}
+
+			uint32_t directoryCount;//reachable directories (root included)
+			uint32_t fileCount;//reachable files
+			uint64_t usedBytes;//sum of reachable extents
+			uint32_t danglingRecordCount;//dir records that refer to freed or out-of-range i-nodes
+			uint32_t multiplyLinkedINodeCount;//i-nodes referred by more than one dir record (or cycles)
+			uint32_t dirSizeMismatchCount;//directory file size doesn't match its record count
+			uint32_t duplicateNameCount;//dir records whose name is used by an earlier folder (or file) of the same directory
+			uint32_t outOfRangeExtentCount;//extents that exceed the user file space
+			uint32_t overlappingExtentCount;
+			uint32_t leakedINodeCount;//in-use i-nodes that can't be reached from root
+			bool isAllocatorConsistent;
+			bool isRepaired;
+			std::vector<std::string> messages;//human readable description of every problem
+		};
+
+		class /*_declspec(dllexport)*/ CFileSystemChecker
+		{
+		public:
+
+			CFileSystemChecker(IFileSystem& fs);
+
+			//threadCount=0 : decided by hardware concurrency
+			bool	Check(N_FileSystemCheckReport& outReport, bool isRepairEnabled = false, uint32_t threadCount = 0);
+
+		private:
+
+			struct N_DirTask
+			{
+				uint32_t indexNodeId;
+				std::string path;
+			};
+
+			//dir record to be dropped in repair mode
+			struct N_BadRecord
+			{
+				uint32_t parentIndexNodeId;
+				uint32_t indexNodeId;
+				std::string name;
+			};
+
+			//result of a worker thread, merged when all workers are done
+			struct N_WorkerResult
+			{
+				std::vector<uint32_t> reachedFiles;
+				std::vector<uint32_t> reachedDirs;
+				std::vector<N_BadRecord> badRecords;
+				std::vector<uint32_t> badSizeDirs;//directory i-nodes whose size doesn't match record count
+				std::vector<std::string> messages;
+				uint32_t danglingRecordCount = 0;
+				uint32_t multiplyLinkedINodeCount = 0;
+				uint32_t dirSizeMismatchCount = 0;
+				uint32_t duplicateNameCount = 0;
+			};
+
+			void		mFunction_Scan(N_FileSystemCheckReport& outReport, std::vector<N_WorkerResult>& outResults, uint32_t threadCount);
+
+			void		mFunction_WorkerLoop(N_WorkerResult& result);
+
+			void		mFunction_CheckDirectory(const N_DirTask& task, N_WorkerResult& result);
+
+			//false if directory file is broken or its size doesn't match its records
+			bool		mFunction_ReadDirectory(uint32_t dirIndexNodeId, std::vector<IFileSystem::N_DirFileRecord>& outFolders, std::vector<IFileSystem::N_DirFileRecord>& outFiles, std::string& outErrorMsg);
+
+			bool		mFunction_VisitINode(uint32_t indexNodeId);//false if the i-node was visited already
+
+			void		mFunction_CheckExtents(const std::vector<uint32_t>& reachedINodes, N_FileSystemCheckReport& report);
+
+			void		mFunction_Repair(const std::vector<N_WorkerResult>& results);
+
+			void		mFunction_RebuildAllocators();
+
+			IFileSystem& mFs;
+
+			//shared state of worker threads
+			std::vector<N_DirTask> mTaskStack;
+			std::mutex mTaskLock;
+			std::condition_variable mTaskCondition;
+			uint32_t mActiveWorkerCount;
+			std::atomic<uint8_t>* m_pVisitedFlags;//per i-node
+		};
+	}
+}
@@ -0,0 +1,310 @@
+/***********************************************************************
+
+									cppHost File
+
+************************************************************************/
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <winioctl.h>
+//(windows.h renames these, but they are also IFileSystem methods)
+#undef CreateFile
+#undef DeleteFile
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#endif
+
+#include "Noise3D.h"
+
+using namespace Noise3D::Core;
+
+const uint64_t CHostFile::c_TransferChunkSize;//(bound to const& by std::min)
+
+bool CHostFile::PunchHoles(const NFilePath & hostFilePath, const std::vector<N_AddressRange>& ranges)
+{
+	if (ranges.empty())return true;
+
+#ifdef _WIN32
+	//NTFS : mark the file sparse, then zeroed ranges of a sparse file are deallocated
+	HANDLE hFile = ::CreateFileA(hostFilePath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+		nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		ERROR_MSG("HostFile : PunchHoles failure! host file can't be opened.");
+		return false;
+	}
+
+	DWORD bytesReturned = 0;
+	bool isSucceeded = ::DeviceIoControl(hFile, FSCTL_SET_SPARSE, nullptr, 0, nullptr, 0, &bytesReturned, nullptr) != FALSE;
+	for (auto& range : ranges)
+	{
+		if (!isSucceeded)break;
+		FILE_ZERO_DATA_INFORMATION zeroInfo;
+		zeroInfo.FileOffset.QuadPart = LONGLONG(range.start);
+		zeroInfo.BeyondFinalZero.QuadPart = LONGLONG(range.start + range.size);
+		isSucceeded = ::DeviceIoControl(hFile, FSCTL_SET_ZERO_DATA, &zeroInfo, sizeof(zeroInfo), nullptr, 0, &bytesReturned, nullptr) != FALSE;
+	}
+	::CloseHandle(hFile);
+#else
+	int fd = ::open(hostFilePath.c_str(), O_WRONLY);
+	if (fd < 0)
+	{
+		ERROR_MSG("HostFile : PunchHoles failure! host file can't be opened.");
+		return false;
+	}
+
+	bool isSucceeded = true;
+	for (auto& range : ranges)
+	{
+		if (::fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, off_t(range.start), off_t(range.size)) != 0)
+		{
+			isSucceeded = false;
+			break;
+		}
+	}
+	::close(fd);
+#endif
+
+	if (!isSucceeded)ERROR_MSG("HostFile : PunchHoles failure! host file system doesn't support hole punching.");
+	return isSucceeded;
+}
+
+bool CHostFile::SetFileSize(const NFilePath & hostFilePath, uint64_t size)
+{
+#ifdef _WIN32
+	HANDLE hFile = ::CreateFileA(hostFilePath.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+		nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		ERROR_MSG("HostFile : SetFileSize failure! host file can't be opened.");
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	fileSize.QuadPart = LONGLONG(size);
+	bool isSucceeded = ::SetFilePointerEx(hFile, fileSize, nullptr, FILE_BEGIN) != FALSE && ::SetEndOfFile(hFile) != FALSE;
+	::CloseHandle(hFile);
+#else
+	int fd = ::open(hostFilePath.c_str(), O_WRONLY);
+	if (fd < 0)
+	{
+		ERROR_MSG("HostFile : SetFileSize failure! host file can't be opened.");
+		return false;
+	}
+
+	bool isSucceeded = (::ftruncate(fd, off_t(size)) == 0);
+	::close(fd);
+#endif
+
+	if (!isSucceeded)ERROR_MSG("HostFile : SetFileSize failure! host file can't be resized.");
+	return isSucceeded;
+}
+
+bool CHostFile::ParallelRead(const NFilePath & hostFilePath, char * pImage, const std::vector<N_AddressRange>& ranges, uint32_t threadCount)
+{
+	std::vector<N_HostFileTransfer> transfers;
+	for (auto& range : ranges)transfers.push_back(N_HostFileTransfer(&hostFilePath, pImage + range.start, range.start, range.size));
+	return ParallelTransfer(transfers, false, threadCount);
+}
+
+bool CHostFile::ParallelWrite(const NFilePath & hostFilePath, const char * pImage, const std::vector<N_AddressRange>& ranges, uint32_t threadCount)
+{
+	std::vector<N_HostFileTransfer> transfers;
+	for (auto& range : ranges)transfers.push_back(N_HostFileTransfer(&hostFilePath, const_cast<char*>(pImage) + range.start, range.start, range.size));
+	return ParallelTransfer(transfers, true, threadCount);
+}
+
+bool CHostFile::ParallelTransfer(const std::vector<N_HostFileTransfer>& transfers, bool isWrite, uint32_t threadCount)
+{
+	std::vector<N_HostFileTransfer> chunks;
+	for (auto& t : transfers)
+		for (uint64_t offset = 0; offset < t.size; offset += c_TransferChunkSize)
+			chunks.push_back(N_HostFileTransfer(t.pHostFilePath, t.pData + offset, t.hostFileOffset + offset, std::min<uint64_t>(c_TransferChunkSize, t.size - offset)));
+	if (chunks.empty())return true;
+
+	if (threadCount == 0)threadCount = std::max(1u, std::thread::hardware_concurrency());
+	threadCount = uint32_t(std::min<uint64_t>(threadCount, chunks.size()));
+
+	//every thread has handles of its own (reopened when the next chunk lies in another file)
+	std::atomic<uint64_t> nextChunk(0);
+	std::atomic<bool> isFailed(false);
+	auto workerLoop = [&]()
+	{
+		const NFilePath* pOpenedPath = nullptr;
+#ifdef _WIN32
+		HANDLE hFile = INVALID_HANDLE_VALUE;
+		for (uint64_t i = nextChunk++; i < chunks.size() && !isFailed; i = nextChunk++)
+		{
+			const N_HostFileTransfer& chunk = chunks[i];
+			if (pOpenedPath == nullptr || *pOpenedPath != *chunk.pHostFilePath)
+			{
+				if (hFile != INVALID_HANDLE_VALUE)::CloseHandle(hFile);
+				pOpenedPath = chunk.pHostFilePath;
+				hFile = ::CreateFileA(pOpenedPath->c_str(), isWrite ? GENERIC_WRITE : GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+					nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+				if (hFile == INVALID_HANDLE_VALUE)
+				{
+					isFailed = true;
+					break;
+				}
+			}
+			OVERLAPPED overlapped = {};
+			overlapped.Offset = DWORD(chunk.hostFileOffset & 0xffffffff);
+			overlapped.OffsetHigh = DWORD(chunk.hostFileOffset >> 32);
+			DWORD transferredBytes = 0;
+			BOOL isSucceeded = isWrite ?
+				::WriteFile(hFile, chunk.pData, DWORD(chunk.size), &transferredBytes, &overlapped) :
+				::ReadFile(hFile, chunk.pData, DWORD(chunk.size), &transferredBytes, &overlapped);
+			if (!isSucceeded || transferredBytes != chunk.size)isFailed = true;
+		}
+		if (hFile != INVALID_HANDLE_VALUE)::CloseHandle(hFile);
+#else
+		int fd = -1;
+		for (uint64_t i = nextChunk++; i < chunks.size() && !isFailed; i = nextChunk++)
+		{
+			const N_HostFileTransfer& chunk = chunks[i];
+			if (pOpenedPath == nullptr || *pOpenedPath != *chunk.pHostFilePath)
+			{
+				if (fd >= 0)::close(fd);
+				pOpenedPath = chunk.pHostFilePath;
+				fd = ::open(pOpenedPath->c_str(), isWrite ? O_WRONLY : O_RDONLY);
+				if (fd < 0)
+				{
+					isFailed = true;
+					break;
+				}
+			}
+
+			//(transfer may be partial)
+			uint64_t doneBytes = 0;
+			while (doneBytes < chunk.size)
+			{
+				char* pData = chunk.pData + doneBytes;
+				size_t leftBytes = size_t(chunk.size - doneBytes);
+				off_t offset = off_t(chunk.hostFileOffset + doneBytes);
+				ssize_t n = isWrite ? ::pwrite(fd, pData, leftBytes, offset) : ::pread(fd, pData, leftBytes, offset);
+				if (n <= 0)
+				{
+					isFailed = true;
+					break;
+				}
+				doneBytes += uint64_t(n);
+			}
+		}
+		if (fd >= 0)::close(fd);
+#endif
+	};
+
+	std::vector<std::thread> workers;
+	for (uint32_t i = 1; i < threadCount; ++i)workers.push_back(std::thread(workerLoop));
+	workerLoop();
+	for (auto& t : workers)t.join();
+
+	if (isFailed)ERROR_MSG("HostFile : Parallel " << (isWrite ? "write" : "read") << " failure! host file can't be accessed.");
+	return !isFailed;
+}
+
+bool CHostFile::ListDirectory(const NFilePath & hostDirPath, std::vector<N_HostDirEntry>& outEntries)
+{
+	outEntries.clear();
+
+#ifdef _WIN32
+	WIN32_FIND_DATAA findData;
+	HANDLE hFind = ::FindFirstFileA((hostDirPath + "\\*").c_str(), &findData);
+	if (hFind == INVALID_HANDLE_VALUE)
+	{
+		ERROR_MSG("HostFile : ListDirectory failure! host folder can't be opened.");
+		return false;
+	}
+	do
+	{
+		std::string name = findData.cFileName;
+		if (name == "." || name == "..")continue;
+		N_HostDirEntry entry;
+		entry.name = name;
+		entry.isFolder = (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+		entry.size = entry.isFolder ? 0 : ((uint64_t(findData.nFileSizeHigh) << 32) | findData.nFileSizeLow);
+		outEntries.push_back(entry);
+	} while (::FindNextFileA(hFind, &findData));
+	::FindClose(hFind);
+#else
+	DIR* pDir = ::opendir(hostDirPath.c_str());
+	if (pDir == nullptr)
+	{
+		ERROR_MSG("HostFile : ListDirectory failure! host folder can't be opened.");
+		return false;
+	}
+	for (dirent* pEntry = ::readdir(pDir); pEntry != nullptr; pEntry = ::readdir(pDir))
+	{
+		std::string name = pEntry->d_name;
+		if (name == "." || name == "..")continue;
+
+		//(symbolic links are followed, other kinds of files are skipped)
+		struct stat fileStat;
+		if (::stat((hostDirPath + "/" + name).c_str(), &fileStat) != 0)continue;
+		if (!S_ISDIR(fileStat.st_mode) && !S_ISREG(fileStat.st_mode))continue;
+		N_HostDirEntry entry;
+		entry.name = name;
+		entry.isFolder = S_ISDIR(fileStat.st_mode);
+		entry.size = entry.isFolder ? 0 : uint64_t(fileStat.st_size);
+		outEntries.push_back(entry);
+	}
+	::closedir(pDir);
+#endif
+
+	//(listing order of host is arbitrary)
+	std::sort(outEntries.begin(), outEntries.end(), [](const N_HostDirEntry& a, const N_HostDirEntry& b) {return a.name < b.name; });
+	return true;
+}
+
+bool CHostFile::LockFile(const NFilePath & hostFilePath, bool isExclusive, intptr_t & outLockHandle)
+{
+	outLockHandle = c_InvalidLockHandle;
+
+#ifdef _WIN32
+	//windows locks are mandatory : the last byte of 64-bit offset space is locked instead of
+	//the image, so that the lock only excludes other lockers
+	HANDLE hFile = ::CreateFileA(hostFilePath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE)return false;
+	OVERLAPPED overlapped = {};
+	overlapped.Offset = 0xfffffffe;
+	overlapped.OffsetHigh = 0xffffffff;
+	DWORD flags = LOCKFILE_FAIL_IMMEDIATELY | (isExclusive ? LOCKFILE_EXCLUSIVE_LOCK : 0);
+	if (!::LockFileEx(hFile, flags, 0, 1, 0, &overlapped))
+	{
+		::CloseHandle(hFile);
+		return false;
+	}
+	outLockHandle = intptr_t(hFile);
+#else
+	//(flock belongs to the open file, so mounts within one process exclude each other as well)
+	int fd = ::open(hostFilePath.c_str(), O_RDONLY);
+	if (fd < 0)return false;
+	if (::flock(fd, (isExclusive ? LOCK_EX : LOCK_SH) | LOCK_NB) != 0)
+	{
+		::close(fd);
+		return false;
+	}
+	outLockHandle = intptr_t(fd);
+#endif
+	return true;
+}
+
+void CHostFile::UnlockFile(intptr_t lockHandle)
+{
+	if (lockHandle == c_InvalidLockHandle)return;
+
+	//(lock is released with its handle)
+#ifdef _WIN32
+	::CloseHandle(HANDLE(lockHandle));
+#else
+	::close(int(lockHandle));
+#endif
+}
@@ -0,0 +1,73 @@
+/***********************************************************************
+
+									hHost File
+
+			Desc: platform specific operations on the host file that
+			holds a virtual disk image (the image itself is accessed
+			with std::fstream, only what fstream can't do lies here).
+
+************************************************************************/
+
+#pragma once
+
+namespace Noise3D
+{
+	namespace Core
+	{
+		//a piece of memory and where it lies in a host file
+		struct N_HostFileTransfer
+		{
+			N_HostFileTransfer(const NFilePath* _pHostFilePath, char* _pData, uint64_t _hostFileOffset, uint64_t _size) :
+				pHostFilePath(_pHostFilePath), pData(_pData), hostFileOffset(_hostFileOffset), size(_size) {}
+
+			const NFilePath* pHostFilePath;
+			char* pData;
+			uint64_t hostFileOffset;
+			uint64_t size;
+		};
+
+		struct N_HostDirEntry
+		{
+			std::string name;
+			uint64_t size;
+			bool isFolder;
+		};
+
+		class /*_declspec(dllexport)*/ CHostFile
+		{
+		public:
+
+			//deallocate host storage of the given byte ranges (offsets in host file), they
+			//read as zero afterwards. false if the host file system can't punch holes
+			static bool PunchHoles(const NFilePath& hostFilePath, const std::vector<N_AddressRange>& ranges);
+
+			//extend host file sparsely (appended part reads as zero) or cut it to the given size
+			static bool SetFileSize(const NFilePath& hostFilePath, uint64_t size);
+
+			//read the given byte ranges of host file into pImage at the same offsets. ranges are cut into
+			//chunks, which are transferred by several threads with positional I/O (threadCount=0 : decided
+			//by hardware concurrency). false if any chunk can't be transferred
+			static bool ParallelRead(const NFilePath& hostFilePath, char* pImage, const std::vector<N_AddressRange>& ranges, uint32_t threadCount = 0);
+
+			static bool ParallelWrite(const NFilePath& hostFilePath, const char* pImage, const std::vector<N_AddressRange>& ranges, uint32_t threadCount = 0);
+
+			//transfers of any count of (existing) host files, cut into chunks that are shared by the same threads
+			static bool ParallelTransfer(const std::vector<N_HostFileTransfer>& transfers, bool isWrite, uint32_t threadCount = 0);
+
+			//regular files and folders in a host folder (. and .. excluded)
+			static bool ListDirectory(const NFilePath& hostDirPath, std::vector<N_HostDirEntry>& outEntries);
+
+			//advisory lock of host file across processes : exclusive for the one that writes the image,
+			//shared for read-only mounts. it isn't waited for, false if it is held the other way
+			static bool LockFile(const NFilePath& hostFilePath, bool isExclusive, intptr_t& outLockHandle);
+
+			static void UnlockFile(intptr_t lockHandle);
+
+			static const intptr_t c_InvalidLockHandle = -1;
+
+		private:
+
+			static const uint64_t c_TransferChunkSize = 8 * 1024 * 1024;
+		};
+	}
+}
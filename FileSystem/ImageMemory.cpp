@@ -0,0 +1,304 @@
+/***********************************************************************
+
+									cppImage Memory
+
+************************************************************************/
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+//(windows.h renames these, but they are also IFileSystem methods)
+#undef CreateFile
+#undef DeleteFile
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#endif
+
+#include "Noise3D.h"
+#include <stdexcept>
+
+using namespace Noise3D::Core;
+
+void * CImageMemory::Allocate(uint64_t size)
+{
+	if (size < c_HugePageSize)
+	{
+		void* p = ::operator new(size_t(size), std::nothrow);
+		if (p != nullptr)memset(p, 0, size_t(size));
+		return p;
+	}
+
+	N_Allocation allocation = { (size + c_HugePageSize - 1) / c_HugePageSize * c_HugePageSize, NOISE_IMAGE_MEMORY_EXPLICIT_HUGE_PAGE };
+	void* p = nullptr;
+
+#ifdef _WIN32
+	//large pages need SeLockMemoryPrivilege held by the user, it is enabled in process token once
+	static const bool isLargePageEnabled = []()
+	{
+		HANDLE hToken = nullptr;
+		if (!::OpenProcessToken(::GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &hToken))return false;
+		TOKEN_PRIVILEGES privileges = {};
+		privileges.PrivilegeCount = 1;
+		privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+		bool isEnabled = ::LookupPrivilegeValueA(nullptr, "SeLockMemoryPrivilege", &privileges.Privileges[0].Luid) != FALSE &&
+			::AdjustTokenPrivileges(hToken, FALSE, &privileges, 0, nullptr, nullptr) != FALSE && ::GetLastError() == ERROR_SUCCESS;
+		::CloseHandle(hToken);
+		return isEnabled && ::GetLargePageMinimum() != 0;
+	}();
+	if (isLargePageEnabled)
+	{
+		uint64_t largePageSize = ::GetLargePageMinimum();
+		uint64_t largeMappedSize = (size + largePageSize - 1) / largePageSize * largePageSize;
+		p = ::VirtualAlloc(nullptr, SIZE_T(largeMappedSize), MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+		if (p != nullptr)allocation.mappedSize = largeMappedSize;
+	}
+	if (p == nullptr)
+	{
+		//(windows has no transparent huge pages)
+		p = ::VirtualAlloc(nullptr, SIZE_T(allocation.mappedSize), MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+		if (p == nullptr)return nullptr;
+		allocation.type = NOISE_IMAGE_MEMORY_NORMAL_PAGE;
+	}
+#else
+	//hugetlb pages are only there if administrator reserved them
+#ifdef MAP_HUGETLB
+	p = ::mmap(nullptr, size_t(allocation.mappedSize), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (p == MAP_FAILED)p = nullptr;
+#endif
+	if (p == nullptr)
+	{
+		//a mapping larger by one huge page is cut to a huge page aligned range, so that
+		//kernel can back all of it with transparent huge pages
+		uint64_t overSize = allocation.mappedSize + c_HugePageSize;
+		void* pRaw = ::mmap(nullptr, size_t(overSize), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (pRaw == MAP_FAILED)return nullptr;
+		uintptr_t rawStart = uintptr_t(pRaw);
+		uintptr_t alignedStart = (rawStart + c_HugePageSize - 1) & ~uintptr_t(c_HugePageSize - 1);
+		uintptr_t alignedEnd = alignedStart + uintptr_t(allocation.mappedSize);
+		if (alignedStart > rawStart)::munmap(pRaw, alignedStart - rawStart);
+		if (rawStart + overSize > alignedEnd)::munmap(reinterpret_cast<void*>(alignedEnd), size_t(rawStart + overSize - alignedEnd));
+		p = reinterpret_cast<void*>(alignedStart);
+
+		allocation.type = NOISE_IMAGE_MEMORY_NORMAL_PAGE;
+#ifdef MADV_HUGEPAGE
+		if (::madvise(p, size_t(allocation.mappedSize), MADV_HUGEPAGE) == 0)allocation.type = NOISE_IMAGE_MEMORY_TRANSPARENT_HUGE_PAGE;
+#endif
+	}
+#endif
+
+	//(mapped memory is zero already)
+	std::lock_guard<std::mutex> lock(mFunction_GetAllocationMutex());
+	mFunction_GetAllocations()[p] = allocation;
+	return p;
+}
+
+void CImageMemory::Free(void * p)
+{
+	if (p == nullptr)return;
+
+	N_Allocation allocation;
+	{
+		std::lock_guard<std::mutex> lock(mFunction_GetAllocationMutex());
+		auto iter = mFunction_GetAllocations().find(p);
+		if (iter == mFunction_GetAllocations().end())
+		{
+			//(from heap)
+			::operator delete(p);
+			return;
+		}
+		allocation = iter->second;
+		mFunction_GetAllocations().erase(iter);
+	}
+
+#ifdef _WIN32
+	::VirtualFree(p, 0, MEM_RELEASE);
+#else
+	::munmap(p, size_t(allocation.mappedSize));
+#endif
+}
+
+uint64_t CImageMemory::GetHugePageBackedSize(const void * p, uint64_t size)
+{
+	N_Allocation allocation;
+	{
+		std::lock_guard<std::mutex> lock(mFunction_GetAllocationMutex());
+		auto iter = mFunction_GetAllocations().find(p);
+		if (iter == mFunction_GetAllocations().end())return 0;
+		allocation = iter->second;
+	}
+
+	switch (allocation.type)
+	{
+	case NOISE_IMAGE_MEMORY_EXPLICIT_HUGE_PAGE:
+		return std::min(size, allocation.mappedSize);
+
+	case NOISE_IMAGE_MEMORY_TRANSPARENT_HUGE_PAGE:
+	{
+#ifdef _WIN32
+		return 0;
+#else
+		//AnonHugePages of the mappings that overlap the range (a mapping may be split by kernel)
+		std::ifstream smaps("/proc/self/smaps");
+		uintptr_t rangeStart = uintptr_t(p), rangeEnd = rangeStart + uintptr_t(size);
+		uint64_t hugePageBytes = 0;
+		bool isOverlapped = false;
+		std::string line;
+		while (std::getline(smaps, line))
+		{
+			unsigned long long mappingStart = 0, mappingEnd = 0;
+			if (std::sscanf(line.c_str(), "%llx-%llx ", &mappingStart, &mappingEnd) == 2)
+				isOverlapped = mappingStart < rangeEnd && mappingEnd > rangeStart;
+			else if (isOverlapped && line.compare(0, 14, "AnonHugePages:") == 0)
+				hugePageBytes += std::strtoull(line.c_str() + 14, nullptr, 10) * 1024;
+		}
+		return std::min(size, hugePageBytes);
+#endif
+	}
+
+	default:
+		return 0;
+	}
+}
+
+const void * CImageMemory::MapFileReadOnly(const NFilePath & filePath, uint64_t size)
+{
+	if (size == 0)return nullptr;
+
+#ifdef _WIN32
+	HANDLE hFile = ::CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE)return nullptr;
+	HANDLE hMapping = ::CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	::CloseHandle(hFile);
+	if (hMapping == nullptr)return nullptr;
+	//(the view keeps mapping alive)
+	const void* p = ::MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, SIZE_T(size));
+	::CloseHandle(hMapping);
+	return p;
+#else
+	int fd = ::open(filePath.c_str(), O_RDONLY);
+	if (fd < 0)return nullptr;
+	void* p = ::mmap(nullptr, size_t(size), PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	return p == MAP_FAILED ? nullptr : p;
+#endif
+}
+
+void CImageMemory::UnmapFile(const void * p, uint64_t size)
+{
+	if (p == nullptr)return;
+#ifdef _WIN32
+	::UnmapViewOfFile(p);
+#else
+	::munmap(const_cast<void*>(p), size_t(size));
+#endif
+}
+
+void CImageMemory::Prefetch(const void * p, uint64_t size)
+{
+	if (p == nullptr || size == 0)return;
+
+	//(whole pages)
+	static const uintptr_t pageSize = 4096;
+	uintptr_t start = uintptr_t(p) & ~(pageSize - 1);
+	uintptr_t end = uintptr_t(p) + uintptr_t(size);
+#ifdef _WIN32
+#if _WIN32_WINNT >= 0x0602
+	WIN32_MEMORY_RANGE_ENTRY range;
+	range.VirtualAddress = reinterpret_cast<void*>(start);
+	range.NumberOfBytes = SIZE_T(end - start);
+	::PrefetchVirtualMemory(::GetCurrentProcess(), 1, &range, 0);
+#endif
+#else
+	::madvise(reinterpret_cast<void*>(start), size_t(end - start), MADV_WILLNEED);
+#endif
+}
+
+CImageBuffer::CImageBuffer(uint64_t size) :
+	m_pData(static_cast<char*>(CImageMemory::Allocate(size))),
+	mSize(size),
+	mIsReadOnlyMapping(false)
+{
+}
+
+CImageBuffer::CImageBuffer(const NFilePath & imageFilePath, uint64_t size) :
+	m_pData(const_cast<char*>(static_cast<const char*>(CImageMemory::MapFileReadOnly(imageFilePath, size)))),
+	mSize(size),
+	mIsReadOnlyMapping(true)
+{
+}
+
+CImageBuffer::~CImageBuffer()
+{
+	if (mIsReadOnlyMapping)CImageMemory::UnmapFile(m_pData, mSize);
+	else CImageMemory::Free(m_pData);
+}
+
+char & CImageBuffer::at(uint64_t offset)
+{
+	if (offset >= mSize)throw std::out_of_range("CImageBuffer::at");
+	return m_pData[offset];
+}
+
+uint64_t CImageBuffer::size() const
+{
+	return mSize;
+}
+
+bool CImageBuffer::resize(uint64_t newSize)
+{
+	if (mIsReadOnlyMapping || m_pData == nullptr)return false;
+	if (newSize == mSize)return true;
+
+	char* pNewData = static_cast<char*>(CImageMemory::Allocate(newSize));
+	if (pNewData == nullptr)return false;
+	memcpy(pNewData, m_pData, size_t(std::min(mSize, newSize)));
+	CImageMemory::Free(m_pData);
+	m_pData = pNewData;
+	mSize = newSize;
+	return true;
+}
+
+bool CImageBuffer::IsValid() const
+{
+	return m_pData != nullptr;
+}
+
+bool CImageBuffer::IsReadOnlyMapping() const
+{
+	return mIsReadOnlyMapping;
+}
+
+void CImageBuffer::Prefetch(uint64_t offset, uint64_t size)
+{
+	if (!mIsReadOnlyMapping || offset >= mSize)return;
+	CImageMemory::Prefetch(m_pData + offset, std::min(size, mSize - offset));
+}
+
+uint64_t CImageBuffer::GetHugePageBackedSize() const
+{
+	if (mIsReadOnlyMapping)return 0;
+	return CImageMemory::GetHugePageBackedSize(m_pData, mSize);
+}
+
+/***********************************************************
+
+								P R I V A T E
+
+***********************************************************/
+
+std::mutex & CImageMemory::mFunction_GetAllocationMutex()
+{
+	//(never destroyed, images of static IFileSystem objects are freed during static destruction)
+	static std::mutex* pAllocationMutex = new std::mutex;
+	return *pAllocationMutex;
+}
+
+std::unordered_map<const void*, CImageMemory::N_Allocation>& CImageMemory::mFunction_GetAllocations()
+{
+	static std::unordered_map<const void*, N_Allocation>* pAllocations = new std::unordered_map<const void*, N_Allocation>;
+	return *pAllocations;
+}
@@ -0,0 +1,98 @@
+/***********************************************************************
+
+									hImage Memory
+
+			Desc: memory of an installed virtual disk image. large
+			allocations come from 2MB huge pages when the host allows it
+			(explicit huge pages first, then transparent huge pages on an
+			aligned mapping), so that random access to a big image doesn't
+			miss TLB all the time. normal pages are used otherwise. an
+			image mounted read-only is a shared mapping of its file.
+
+************************************************************************/
+
+#pragma once
+
+namespace Noise3D
+{
+	namespace Core
+	{
+		class /*_declspec(dllexport)*/ CImageMemory
+		{
+		public:
+
+			static void*		Allocate(uint64_t size);//zero-filled, nullptr if out of memory
+
+			static void		Free(void* p);
+
+			//bytes of [p, p+size) that lie in huge pages (transparent huge pages are
+			//given to a mapping by kernel on demand, so that is queried every time)
+			static uint64_t	GetHugePageBackedSize(const void* p, uint64_t size);
+
+			//read-only view of host file, shared with every process that maps it (page cache)
+			static const void*	MapFileReadOnly(const NFilePath& filePath, uint64_t size);
+
+			static void		UnmapFile(const void* p, uint64_t size);
+
+			static void		Prefetch(const void* p, uint64_t size);//start reading pages of a mapped file in (not waited for)
+
+			static const uint64_t c_HugePageSize = 2 * 1024 * 1024;//smaller allocations come from heap
+
+		private:
+
+			enum NOISE_IMAGE_MEMORY_TYPE
+			{
+				NOISE_IMAGE_MEMORY_EXPLICIT_HUGE_PAGE,//hugetlb / large pages : all of it is huge page backed
+				NOISE_IMAGE_MEMORY_TRANSPARENT_HUGE_PAGE,//aligned mapping advised to kernel
+				NOISE_IMAGE_MEMORY_NORMAL_PAGE,
+			};
+
+			struct N_Allocation
+			{
+				uint64_t mappedSize;
+				NOISE_IMAGE_MEMORY_TYPE type;
+			};
+
+			static std::mutex& mFunction_GetAllocationMutex();
+
+			static std::unordered_map<const void*, N_Allocation>& mFunction_GetAllocations();
+		};
+
+		//in-memory image of IFileSystem : memory of its own (from CImageMemory), or a read-only
+		//shared mapping of the image file, which must never be written through at()
+		class /*_declspec(dllexport)*/ CImageBuffer
+		{
+		public:
+
+			explicit CImageBuffer(uint64_t size);//zero-filled
+
+			CImageBuffer(const NFilePath& imageFilePath, uint64_t size);//read-only mapping of the first size bytes
+
+			~CImageBuffer();
+
+			CImageBuffer(const CImageBuffer&) = delete;
+
+			CImageBuffer& operator=(const CImageBuffer&) = delete;
+
+			char&		at(uint64_t offset);//(bounds checked as std::vector)
+
+			uint64_t	size() const;
+
+			bool			resize(uint64_t newSize);//memory of its own only, appended part is zero
+
+			bool			IsValid() const;//false if memory can't be allocated or file can't be mapped
+
+			bool			IsReadOnlyMapping() const;
+
+			void			Prefetch(uint64_t offset, uint64_t size);//(a mapping only, memory of its own is resident)
+
+			uint64_t	GetHugePageBackedSize() const;
+
+		private:
+
+			char* m_pData;
+			uint64_t mSize;
+			bool mIsReadOnlyMapping;
+		};
+	}
+}
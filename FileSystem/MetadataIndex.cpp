@@ -0,0 +1,142 @@
+
+/***********************************************************************
+
+									cppMetadata Index
+
+************************************************************************/
+
+#include "Noise3D.h"
+
+using namespace Noise3D::Core;
+
+CMetadataIndex::CMetadataIndex() :
+	mTotalBytes(0)
+{
+}
+
+void CMetadataIndex::Clear()
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	mEntries.clear();
+	mSizeOrder.clear();
+	mOwnerSets.clear();
+	mAccessModeSets.clear();
+	mTotalBytes = 0;
+}
+
+void CMetadataIndex::Insert(uint32_t indexNodeId, const N_IndexNode & node)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	mFunction_Erase(indexNodeId);
+
+	N_MetadataIndexEntry entry = { indexNodeId, node.ownerUserID, node.accessMode, node.size };
+	mEntries[indexNodeId] = entry;
+	mSizeOrder.insert(std::make_pair(entry.size, indexNodeId));
+	N_OwnerSet& ownerSet = mOwnerSets[entry.ownerUserID];
+	ownerSet.indexNodes.insert(indexNodeId);
+	ownerSet.bytes += entry.size;
+	mAccessModeSets[entry.accessMode].insert(indexNodeId);
+	mTotalBytes += entry.size;
+}
+
+void CMetadataIndex::Erase(uint32_t indexNodeId)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	mFunction_Erase(indexNodeId);
+}
+
+uint32_t CMetadataIndex::GetFileCount()
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	return uint32_t(mEntries.size());
+}
+
+uint64_t CMetadataIndex::GetTotalBytes()
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	return mTotalBytes;
+}
+
+void CMetadataIndex::GetLargestFiles(uint32_t count, std::vector<N_MetadataIndexEntry>& outEntries)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	outEntries.clear();
+	for (auto iter = mSizeOrder.rbegin(); iter != mSizeOrder.rend() && outEntries.size() < count; ++iter)
+	{
+		outEntries.push_back(mEntries.at(iter->second));
+	}
+}
+
+void CMetadataIndex::GetFilesBySize(uint64_t minSize, uint64_t maxSize, std::vector<N_MetadataIndexEntry>& outEntries)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	outEntries.clear();
+	for (auto iter = mSizeOrder.lower_bound(std::make_pair(minSize, 0u)); iter != mSizeOrder.end() && iter->first <= maxSize; ++iter)
+	{
+		outEntries.push_back(mEntries.at(iter->second));
+	}
+}
+
+uint32_t CMetadataIndex::GetOwnerFileCount(uint8_t ownerUserID)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	auto iter = mOwnerSets.find(ownerUserID);
+	return iter == mOwnerSets.end() ? 0 : uint32_t(iter->second.indexNodes.size());
+}
+
+uint64_t CMetadataIndex::GetOwnerBytes(uint8_t ownerUserID)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	auto iter = mOwnerSets.find(ownerUserID);
+	return iter == mOwnerSets.end() ? 0 : iter->second.bytes;
+}
+
+void CMetadataIndex::GetFilesByOwner(uint8_t ownerUserID, std::vector<N_MetadataIndexEntry>& outEntries)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	outEntries.clear();
+	auto iter = mOwnerSets.find(ownerUserID);
+	if (iter != mOwnerSets.end())mFunction_AppendEntries(iter->second.indexNodes, outEntries);
+}
+
+void CMetadataIndex::GetFilesByAccessMode(uint16_t requiredAccessMode, std::vector<N_MetadataIndexEntry>& outEntries)
+{
+	//only a few distinct access modes exist, so every matching mode set is merged
+	std::lock_guard<std::mutex> lock(mLock);
+	outEntries.clear();
+	for (auto& modeSet : mAccessModeSets)
+	{
+		if ((modeSet.first & requiredAccessMode) == requiredAccessMode)mFunction_AppendEntries(modeSet.second, outEntries);
+	}
+}
+
+/***********************************************************
+
+								P R I V A T E
+
+***********************************************************/
+
+void CMetadataIndex::mFunction_Erase(uint32_t indexNodeId)
+{
+	auto iter = mEntries.find(indexNodeId);
+	if (iter == mEntries.end())return;
+
+	//attributes are taken from the index, the i-node may have been reset already
+	const N_MetadataIndexEntry& entry = iter->second;
+	mSizeOrder.erase(std::make_pair(entry.size, indexNodeId));
+	N_OwnerSet& ownerSet = mOwnerSets[entry.ownerUserID];
+	ownerSet.indexNodes.erase(indexNodeId);
+	ownerSet.bytes -= entry.size;
+	if (ownerSet.indexNodes.empty())mOwnerSets.erase(entry.ownerUserID);
+	auto modeIter = mAccessModeSets.find(entry.accessMode);
+	modeIter->second.erase(indexNodeId);
+	if (modeIter->second.empty())mAccessModeSets.erase(modeIter);
+	mTotalBytes -= entry.size;
+	mEntries.erase(iter);
+}
+
+void CMetadataIndex::mFunction_AppendEntries(const std::unordered_set<uint32_t>& indexNodes, std::vector<N_MetadataIndexEntry>& outEntries)
+{
+	outEntries.reserve(outEntries.size() + indexNodes.size());
+	for (uint32_t indexNodeId : indexNodes)outEntries.push_back(mEntries.at(indexNodeId));
+}
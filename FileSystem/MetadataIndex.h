@@ -0,0 +1,83 @@
+
+/***********************************************************************
+
+									hMetadata Index
+
+			Desc: optional secondary indexes over file i-nodes (folders
+			are not indexed) : a size-ordered set, per-owner i-node sets
+			with byte totals and per-access-mode i-node sets. IFileSystem
+			builds it with one tree walk, then keeps it up to date on
+			every create/delete/resize, so that attribute queries don't
+			scan the i-node table. queries lock the index, so they can
+			be issued from another thread while the file system works.
+
+************************************************************************/
+
+#pragma once
+
+namespace Noise3D
+{
+	namespace Core
+	{
+		struct N_IndexNode;
+
+		//indexed attributes of a file
+		struct N_MetadataIndexEntry
+		{
+			uint32_t indexNodeId;
+			uint8_t ownerUserID;
+			uint16_t accessMode;
+			uint64_t size;
+		};
+
+		class /*_declspec(dllexport)*/ CMetadataIndex
+		{
+		public:
+
+			CMetadataIndex();
+
+			void		Clear();
+
+			void		Insert(uint32_t indexNodeId, const N_IndexNode& node);//(re-inserting a file updates it)
+
+			void		Erase(uint32_t indexNodeId);//no effect if the i-node isn't indexed
+
+			//queries
+
+			uint32_t	GetFileCount();
+
+			uint64_t	GetTotalBytes();
+
+			void		GetLargestFiles(uint32_t count, std::vector<N_MetadataIndexEntry>& outEntries);//size descending
+
+			void		GetFilesBySize(uint64_t minSize, uint64_t maxSize, std::vector<N_MetadataIndexEntry>& outEntries);//size in [min,max], ascending
+
+			uint32_t	GetOwnerFileCount(uint8_t ownerUserID);
+
+			uint64_t	GetOwnerBytes(uint8_t ownerUserID);
+
+			void		GetFilesByOwner(uint8_t ownerUserID, std::vector<N_MetadataIndexEntry>& outEntries);
+
+			void		GetFilesByAccessMode(uint16_t requiredAccessMode, std::vector<N_MetadataIndexEntry>& outEntries);//every required flag is set
+
+		private:
+
+			struct N_OwnerSet
+			{
+				std::unordered_set<uint32_t> indexNodes;
+				uint64_t bytes = 0;
+			};
+
+			void		mFunction_Erase(uint32_t indexNodeId);//(lock is held by caller)
+
+			void		mFunction_AppendEntries(const std::unordered_set<uint32_t>& indexNodes, std::vector<N_MetadataIndexEntry>& outEntries);
+
+			std::mutex mLock;
+			std::unordered_map<uint32_t, N_MetadataIndexEntry> mEntries;//indexed attributes by i-node
+			std::set<std::pair<uint64_t, uint32_t>> mSizeOrder;//(size, i-node)
+			std::unordered_map<uint8_t, N_OwnerSet> mOwnerSets;
+			std::unordered_map<uint16_t, std::unordered_set<uint32_t>> mAccessModeSets;//by exact access mode
+			uint64_t mTotalBytes;
+		};
+	}
+}
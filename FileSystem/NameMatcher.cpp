@@ -0,0 +1,144 @@
+
+/***********************************************************************
+
+									cppName Matcher
+
+************************************************************************/
+
+#include "Noise3D.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define NOISE_NAME_MATCH_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define NOISE_TARGET_AVX2
+#else
+#define NOISE_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+using namespace Noise3D::Core;
+
+#ifdef NOISE_NAME_MATCH_X86
+//index of lowest set bit (mask != 0)
+static inline uint32_t CountTrailingZeros(uint32_t mask)
+{
+#ifdef _MSC_VER
+	unsigned long index = 0;
+	_BitScanForward(&index, mask);
+	return uint32_t(index);
+#else
+	return uint32_t(__builtin_ctz(mask));
+#endif
+}
+#endif
+
+uint64_t CNameMatcher::FindHash(const char * pHashArray, uint64_t startIndex, uint64_t count, uint32_t targetHash, NOISE_NAME_MATCH_KERNEL kernel)
+{
+	if (startIndex >= count)return count;
+
+	NOISE_NAME_MATCH_KERNEL supportedKernel = GetSupportedKernel();
+	if (kernel == NOISE_NAME_MATCH_KERNEL_AUTO || kernel > supportedKernel)kernel = supportedKernel;
+
+	switch (kernel)
+	{
+	case NOISE_NAME_MATCH_KERNEL_AVX2:
+		return mFunction_FindHash_AVX2(pHashArray, startIndex, count, targetHash);
+	case NOISE_NAME_MATCH_KERNEL_SSE2:
+		return mFunction_FindHash_SSE2(pHashArray, startIndex, count, targetHash);
+	default:
+		return mFunction_FindHash_Scalar(pHashArray, startIndex, count, targetHash);
+	}
+}
+
+NOISE_NAME_MATCH_KERNEL CNameMatcher::GetSupportedKernel()
+{
+	static const NOISE_NAME_MATCH_KERNEL supportedKernel = []()
+	{
+#if defined(NOISE_NAME_MATCH_X86) && defined(_MSC_VER)
+		//AVX2 : cpuid(7).ebx bit 5, and OS must save ymm registers (xgetbv)
+		int info[4] = { 0 };
+		__cpuid(info, 1);
+		bool isSSE2 = (info[3] & (1 << 26)) != 0;
+		bool isOSXSAVE = (info[2] & (1 << 27)) != 0;
+		bool isAVX = (info[2] & (1 << 28)) != 0;
+		__cpuidex(info, 7, 0);
+		bool isAVX2 = (info[1] & (1 << 5)) != 0;
+		if (isAVX2 && isAVX && isOSXSAVE && (_xgetbv(0) & 0x6) == 0x6)return NOISE_NAME_MATCH_KERNEL_AVX2;
+		if (isSSE2)return NOISE_NAME_MATCH_KERNEL_SSE2;
+#elif defined(NOISE_NAME_MATCH_X86)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))return NOISE_NAME_MATCH_KERNEL_AVX2;
+		if (__builtin_cpu_supports("sse2"))return NOISE_NAME_MATCH_KERNEL_SSE2;
+#endif
+		return NOISE_NAME_MATCH_KERNEL_SCALAR;
+	}();
+	return supportedKernel;
+}
+
+/***********************************************************
+
+								P R I V A T E
+
+***********************************************************/
+
+uint64_t CNameMatcher::mFunction_FindHash_Scalar(const char * pHashArray, uint64_t startIndex, uint64_t count, uint32_t targetHash)
+{
+	for (uint64_t i = startIndex; i < count; ++i)
+	{
+		uint32_t hash;
+		memcpy(&hash, pHashArray + i * 4, sizeof(hash));
+		if (hash == targetHash)return i;
+	}
+	return count;
+}
+
+uint64_t CNameMatcher::mFunction_FindHash_SSE2(const char * pHashArray, uint64_t startIndex, uint64_t count, uint32_t targetHash)
+{
+#ifdef NOISE_NAME_MATCH_X86
+	//4 hashes per compare, movemask gives one bit per byte (4 bits per hash)
+	const __m128i target = _mm_set1_epi32(int(targetHash));
+	uint64_t i = startIndex;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i hashes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pHashArray + i * 4));
+		uint32_t mask = uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi32(hashes, target)));
+		if (mask != 0)return i + CountTrailingZeros(mask) / 4;
+	}
+	return mFunction_FindHash_Scalar(pHashArray, i, count, targetHash);
+#else
+	return mFunction_FindHash_Scalar(pHashArray, startIndex, count, targetHash);
+#endif
+}
+
+#ifdef NOISE_NAME_MATCH_X86
+NOISE_TARGET_AVX2
+#endif
+uint64_t CNameMatcher::mFunction_FindHash_AVX2(const char * pHashArray, uint64_t startIndex, uint64_t count, uint32_t targetHash)
+{
+#ifdef NOISE_NAME_MATCH_X86
+	//16 hashes per iteration (2 compares folded into one test)
+	const __m256i target = _mm256_set1_epi32(int(targetHash));
+	uint64_t i = startIndex;
+	for (; i + 16 <= count; i += 16)
+	{
+		__m256i eq0 = _mm256_cmpeq_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pHashArray + i * 4)), target);
+		__m256i eq1 = _mm256_cmpeq_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pHashArray + i * 4 + 32)), target);
+		if (_mm256_testz_si256(_mm256_or_si256(eq0, eq1), _mm256_or_si256(eq0, eq1)))continue;
+
+		uint32_t mask0 = uint32_t(_mm256_movemask_ps(_mm256_castsi256_ps(eq0)));
+		if (mask0 != 0)return i + CountTrailingZeros(mask0);
+		return i + 8 + CountTrailingZeros(uint32_t(_mm256_movemask_ps(_mm256_castsi256_ps(eq1))));
+	}
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i eq = _mm256_cmpeq_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pHashArray + i * 4)), target);
+		uint32_t mask = uint32_t(_mm256_movemask_ps(_mm256_castsi256_ps(eq)));
+		if (mask != 0)return i + CountTrailingZeros(mask);
+	}
+	return mFunction_FindHash_Scalar(pHashArray, i, count, targetHash);
+#else
+	return mFunction_FindHash_Scalar(pHashArray, startIndex, count, targetHash);
+#endif
+}
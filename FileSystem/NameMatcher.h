@@ -0,0 +1,46 @@
+
+/***********************************************************************
+
+									hName Matcher
+
+			Desc: vectorized scan over the name hash array of a directory
+			file. the kernel (AVX2 / SSE2 / scalar) is chosen at runtime
+			by cpu features, and can be forced for benchmarking.
+
+************************************************************************/
+
+#pragma once
+
+namespace Noise3D
+{
+	namespace Core
+	{
+		enum NOISE_NAME_MATCH_KERNEL
+		{
+			NOISE_NAME_MATCH_KERNEL_AUTO = 0,//best kernel supported by cpu
+			NOISE_NAME_MATCH_KERNEL_SCALAR = 1,
+			NOISE_NAME_MATCH_KERNEL_SSE2 = 2,
+			NOISE_NAME_MATCH_KERNEL_AVX2 = 3,
+		};
+
+		class /*_declspec(dllexport)*/ CNameMatcher
+		{
+		public:
+
+			//index of the first hash in [startIndex, count) that equals targetHash, count if none.
+			//pHashArray needn't be aligned. unsupported kernel falls back to the best supported one
+			static uint64_t FindHash(const char* pHashArray, uint64_t startIndex, uint64_t count, uint32_t targetHash,
+				NOISE_NAME_MATCH_KERNEL kernel = NOISE_NAME_MATCH_KERNEL_AUTO);
+
+			static NOISE_NAME_MATCH_KERNEL GetSupportedKernel();//best kernel of current cpu (detected once)
+
+		private:
+
+			static uint64_t mFunction_FindHash_Scalar(const char* pHashArray, uint64_t startIndex, uint64_t count, uint32_t targetHash);
+
+			static uint64_t mFunction_FindHash_SSE2(const char* pHashArray, uint64_t startIndex, uint64_t count, uint32_t targetHash);
+
+			static uint64_t mFunction_FindHash_AVX2(const char* pHashArray, uint64_t startIndex, uint64_t count, uint32_t targetHash);
+		};
+	}
+}
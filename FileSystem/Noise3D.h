@@ -2,10 +2,21 @@
 
 #include <iostream>
 #include <string>
+#include <cstring>
 #include <vector>
 #include <list>
+#include <deque>
 #include <fstream>
 #include <unordered_map>
+#include <unordered_set>
+#include <set>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <algorithm>
+#include <functional>
 
 typedef std::string N_UID;
 typedef  std::string NFilePath;
@@ -21,4 +32,17 @@ extern std::ofstream* g_pLogFile;
 
 #include "IFactory.h"
 #include "Allocator.h"
+#include "HostFile.h"
+#include "ImageMemory.h"
+#include "Checksum.h"
+#include "NameMatcher.h"
+#include "TraceRecorder.h"
+#include "MetadataIndex.h"
+#include "Snapshot.h"
+#include "DedupIndex.h"
+#include "Compression.h"
+#include "Scrubber.h"
+#include "Archive.h"
 #include "FileSystem.h"
+#include "FileStream.h"
+#include "FileSystemChecker.h"
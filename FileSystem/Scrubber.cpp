@@ -0,0 +1,173 @@
+/***********************************************************************
+
+									cppScrubber
+
+************************************************************************/
+
+#include "Noise3D.h"
+
+using namespace Noise3D::Core;
+
+CScrubber::CScrubber(NFilePath imageFilePath, uint64_t bytesPerSecond, N_ChecksumReport& report) :
+	mImageFilePath(imageFilePath),
+	mBytesPerSecond(bytesPerSecond),
+	mReport(report),
+	mIsStopping(false),
+	mReadBytesSinceRateStart(0)
+{
+	mThread = std::thread(&CScrubber::mFunction_ScrubLoop, this);
+}
+
+CScrubber::~CScrubber()
+{
+	{
+		std::lock_guard<std::mutex> lock(mStopMutex);
+		mIsStopping = true;
+	}
+	mStopCondition.notify_all();
+	mThread.join();
+}
+
+std::mutex & CScrubber::GetImageFileMutex()
+{
+	return mImageFileMutex;
+}
+
+void CScrubber::CopyReport(N_ChecksumReport & outReport)
+{
+	std::lock_guard<std::mutex> lock(mReportMutex);
+	outReport = mReport;
+}
+
+/***********************************************************
+
+								P R I V A T E
+
+***********************************************************/
+
+void CScrubber::mFunction_ScrubLoop()
+{
+	std::ifstream imageFile(mImageFilePath.c_str(), std::ios::binary);
+	while (true)
+	{
+		if (imageFile.is_open() && mFunction_ScrubPass(imageFile))
+		{
+			std::lock_guard<std::mutex> lock(mReportMutex);
+			++mReport.scrubPassCount;
+		}
+
+		//a second between passes (an image that can't be read is retried as well)
+		std::unique_lock<std::mutex> lock(mStopMutex);
+		if (mStopCondition.wait_for(lock, std::chrono::seconds(1), [this]() {return mIsStopping; }))return;
+	}
+}
+
+bool CScrubber::mFunction_ScrubPass(std::ifstream & imageFile)
+{
+	typedef IFileSystem::N_VirtualDiskHeaderInfo N_HeaderInfo;
+	mRateStartTime = std::chrono::steady_clock::now();
+	mReadBytesSinceRateStart = 0;
+
+	//header & i-node table as they lie in image file
+	N_HeaderInfo headerInfo;
+	std::vector<N_IndexNode> indexNodes;
+	{
+		std::lock_guard<std::mutex> lock(mImageFileMutex);
+		imageFile.clear();
+		imageFile.seekg(0);
+		imageFile.read(reinterpret_cast<char*>(&headerInfo), sizeof(headerInfo));
+		if (!imageFile.good() || headerInfo.c_magicNumber != IFileSystem::c_FileSystemMagicNumber ||
+			headerInfo.c_versionNumber != IFileSystem::c_FileSystemVersion || headerInfo.indexNodeCount == 0 ||
+			headerInfo.diskHeaderLength != IFileSystem::mFunction_GetHeaderLength(headerInfo.indexNodeCount))
+			return false;
+		indexNodes.resize(headerInfo.indexNodeCount);
+		imageFile.read(reinterpret_cast<char*>(&indexNodes.at(0)), std::streamsize(indexNodes.size() * sizeof(N_IndexNode)));
+		if (!imageFile.good())return false;
+	}
+	uint64_t indexNodeTableSize = indexNodes.size() * sizeof(N_IndexNode);
+	bool isIndexNodeTableCorrupted = CChecksum::CRC32C(reinterpret_cast<char*>(&indexNodes.at(0)), indexNodeTableSize) != headerInfo.indexNodeTableChecksum;
+	{
+		std::lock_guard<std::mutex> lock(mReportMutex);
+		mReport.verifiedBytes += indexNodeTableSize;
+		if (isIndexNodeTableCorrupted)mReport.isIndexNodeTableCorrupted = true;
+	}
+	if (!mFunction_Throttle(sizeof(headerInfo) + indexNodeTableSize))return false;
+
+	//blocks of the extents that i-nodes refer to (sorted, runs merged)
+	uint64_t blockCount = (headerInfo.diskCapacity + c_ChecksumBlockSize - 1) / c_ChecksumBlockSize;
+	std::vector<N_AddressRange> blockRanges;
+	for (auto& node : indexNodes)
+	{
+		if (node.ownerUserID == NOISE_FILE_OWNER_NULL || node.isInline() || node.address >= headerInfo.diskCapacity)continue;
+		uint64_t firstBlock = node.address / c_ChecksumBlockSize;
+		uint64_t endBlock = std::min<uint64_t>((node.address + node.extentSize() + c_ChecksumBlockSize - 1) / c_ChecksumBlockSize, blockCount);
+		if (endBlock > firstBlock)blockRanges.push_back(N_AddressRange(firstBlock, endBlock - firstBlock));
+	}
+	std::sort(blockRanges.begin(), blockRanges.end(), [](const N_AddressRange& a, const N_AddressRange& b) {return a.start < b.start; });
+	std::vector<N_AddressRange> mergedRanges;
+	for (auto& r : blockRanges)
+	{
+		if (!mergedRanges.empty() && mergedRanges.back().start + mergedRanges.back().size >= r.start)
+			mergedRanges.back().size = std::max(mergedRanges.back().size, r.start + r.size - mergedRanges.back().start);
+		else
+			mergedRanges.push_back(r);
+	}
+
+	//blocks are read in batches together with their checksums
+	uint64_t checksumAreaOffset = headerInfo.diskHeaderLength + headerInfo.diskCapacity;
+	std::vector<uint32_t> checksums(c_ScrubBatchBlockCount);
+	std::vector<char> blocks(size_t(c_ScrubBatchBlockCount) * c_ChecksumBlockSize);
+	for (auto& r : mergedRanges)
+	{
+		for (uint64_t batchStart = r.start; batchStart < r.start + r.size; batchStart += c_ScrubBatchBlockCount)
+		{
+			uint64_t batchBlockCount = std::min<uint64_t>(c_ScrubBatchBlockCount, r.start + r.size - batchStart);
+			uint64_t byteStart = batchStart * c_ChecksumBlockSize;
+			uint64_t byteSize = std::min<uint64_t>(batchBlockCount * c_ChecksumBlockSize, headerInfo.diskCapacity - byteStart);
+			{
+				//(a grow writes back another layout, the pass is given up then)
+				std::lock_guard<std::mutex> lock(mImageFileMutex);
+				N_HeaderInfo currentHeaderInfo;
+				imageFile.seekg(0);
+				imageFile.read(reinterpret_cast<char*>(&currentHeaderInfo), sizeof(currentHeaderInfo));
+				if (!imageFile.good() || currentHeaderInfo.diskCapacity != headerInfo.diskCapacity ||
+					currentHeaderInfo.diskHeaderLength != headerInfo.diskHeaderLength)return false;
+				imageFile.seekg(std::streamoff(checksumAreaOffset + batchStart * sizeof(uint32_t)));
+				imageFile.read(reinterpret_cast<char*>(&checksums.at(0)), std::streamsize(batchBlockCount * sizeof(uint32_t)));
+				imageFile.seekg(std::streamoff(headerInfo.diskHeaderLength + byteStart));
+				imageFile.read(&blocks.at(0), std::streamsize(byteSize));
+				if (!imageFile.good())return false;
+			}
+
+			for (uint64_t i = 0; i < batchBlockCount; ++i)
+			{
+				uint64_t blockSize = std::min<uint64_t>(c_ChecksumBlockSize, byteSize - i * c_ChecksumBlockSize);
+				if (CChecksum::CRC32C(&blocks.at(size_t(i * c_ChecksumBlockSize)), blockSize) != checksums.at(size_t(i)))
+					mFunction_ReportCorruptedBlock(byteStart + i * c_ChecksumBlockSize);
+			}
+			{
+				std::lock_guard<std::mutex> lock(mReportMutex);
+				mReport.verifiedBytes += byteSize;
+			}
+			if (!mFunction_Throttle(byteSize + batchBlockCount * sizeof(uint32_t)))return false;
+		}
+	}
+	return true;
+}
+
+bool CScrubber::mFunction_Throttle(uint64_t readBytes)
+{
+	//reading runs ahead of the rate by one batch at most, then it waits till the rate catches up
+	std::unique_lock<std::mutex> lock(mStopMutex);
+	if (mBytesPerSecond == 0)return !mIsStopping;
+	mReadBytesSinceRateStart += readBytes;
+	auto dueTime = mRateStartTime + std::chrono::microseconds(uint64_t(double(mReadBytesSinceRateStart) * 1e6 / double(mBytesPerSecond)));
+	return !mStopCondition.wait_until(lock, dueTime, [this]() {return mIsStopping; });
+}
+
+void CScrubber::mFunction_ReportCorruptedBlock(uint64_t address)
+{
+	std::lock_guard<std::mutex> lock(mReportMutex);
+	if (std::find(mReport.corruptedBlocks.begin(), mReport.corruptedBlocks.end(), address) == mReport.corruptedBlocks.end())
+		mReport.corruptedBlocks.push_back(address);
+}
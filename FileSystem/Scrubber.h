@@ -0,0 +1,60 @@
+
+/***********************************************************************
+
+									hScrubber
+
+			Desc: background thread that re-reads an installed image file
+			and verifies it against the checksums stored in it (i-node
+			table, and every block of the extents the i-node table refers
+			to), so that host storage rot is found before the image is
+			written back. reading is rate limited. the image file must
+			only be modified while the image file mutex is held.
+
+************************************************************************/
+
+#pragma once
+
+namespace Noise3D
+{
+	namespace Core
+	{
+		class /*_declspec(dllexport)*/ CScrubber
+		{
+		public:
+
+			//corruption found is added to report (which is only touched while the report mutex is held)
+			CScrubber(NFilePath imageFilePath, uint64_t bytesPerSecond, N_ChecksumReport& report);
+
+			~CScrubber();//thread is stopped
+
+			std::mutex&	GetImageFileMutex();
+
+			void		CopyReport(N_ChecksumReport& outReport);
+
+		private:
+
+			void		mFunction_ScrubLoop();
+
+			bool		mFunction_ScrubPass(std::ifstream& imageFile);//false if image file can't be read (or is grown meanwhile)
+
+			bool		mFunction_Throttle(uint64_t readBytes);//wait until reading is within rate, false if stopped
+
+			void		mFunction_ReportCorruptedBlock(uint64_t address);
+
+			static const uint32_t c_ScrubBatchBlockCount = 64;//blocks read at once
+
+			NFilePath mImageFilePath;
+			uint64_t mBytesPerSecond;
+			N_ChecksumReport& mReport;
+			std::mutex mReportMutex;
+			std::mutex mImageFileMutex;
+
+			std::mutex mStopMutex;
+			std::condition_variable mStopCondition;
+			bool mIsStopping;
+			std::chrono::steady_clock::time_point mRateStartTime;
+			uint64_t mReadBytesSinceRateStart;
+			std::thread mThread;
+		};
+	}
+}
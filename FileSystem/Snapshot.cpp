@@ -0,0 +1,120 @@
+/***********************************************************************
+
+									cppSnapshot
+
+************************************************************************/
+
+#include "Noise3D.h"
+
+using namespace Noise3D::Core;
+
+CSnapshot::CSnapshot(std::vector<char>& frozenHeader, uint64_t capacity, const std::vector<N_AddressRange>& freeSegments) :
+	mCapacity(capacity),
+	mPreservedBlockCount(0)
+{
+	mFrozenHeader.swap(frozenHeader);
+
+	//blocks that lie entirely in free space are not captured (partly free blocks are)
+	uint64_t blockCount = (capacity + c_SnapshotBlockSize - 1) / c_SnapshotBlockSize;
+	mBlockStates.assign(size_t(blockCount), uint32_t(c_BlockShared));
+	for (auto& seg : freeSegments)
+	{
+		uint64_t firstBlock = (seg.start + c_SnapshotBlockSize - 1) / c_SnapshotBlockSize;
+		uint64_t segEnd = seg.start + seg.size;
+		uint64_t endBlock = (segEnd == capacity) ? blockCount : segEnd / c_SnapshotBlockSize;
+		for (uint64_t i = firstBlock; i < endBlock; ++i)mBlockStates.at(size_t(i)) = c_BlockNotCaptured;
+	}
+}
+
+void CSnapshot::PreserveBlocks(uint64_t address, uint64_t size, const char * pLiveUserSpace)
+{
+	if (size == 0 || address >= mCapacity)return;
+	uint64_t endBlock = std::min<uint64_t>((address + size + c_SnapshotBlockSize - 1) / c_SnapshotBlockSize, mBlockStates.size());
+	for (uint64_t i = address / c_SnapshotBlockSize; i < endBlock; ++i)
+	{
+		if (mBlockStates.at(size_t(i)) != c_BlockShared)continue;
+
+		//(the last block may be shorter)
+		uint64_t blockStart = i * c_SnapshotBlockSize;
+		uint64_t blockSize = std::min<uint64_t>(c_SnapshotBlockSize, mCapacity - blockStart);
+		mPreservedBlocks.resize(size_t(uint64_t(mPreservedBlockCount + 1) * c_SnapshotBlockSize));
+		memcpy(&mPreservedBlocks.at(size_t(uint64_t(mPreservedBlockCount) * c_SnapshotBlockSize)), pLiveUserSpace + blockStart, size_t(blockSize));
+		mBlockStates.at(size_t(i)) = mPreservedBlockCount + 2;
+		++mPreservedBlockCount;
+	}
+}
+
+bool CSnapshot::WriteToFile(NFilePath imageFilePath, const char * pLiveUserSpace)
+{
+	std::ofstream outFile(imageFilePath.c_str(), std::ios::binary | std::ios::trunc);
+	if (!outFile.is_open())
+	{
+		ERROR_MSG("Snapshot : Write failure! image file can't be created.");
+		return false;
+	}
+
+	//file is extended first (sparse), then captured blocks are written in place. block checksums
+	//(behind user space) and header are written last
+	uint64_t headerLength = mFrozenHeader.size();
+	uint64_t blockCount = mBlockStates.size();
+	mChecksums.assign(size_t(blockCount), 0);
+	outFile.seekp(std::streamoff(headerLength + mCapacity + blockCount * sizeof(uint32_t) - 1));
+	outFile.put(0);
+	auto setChecksum = [&](uint64_t blockIndex, const char* pBlock, uint64_t blockSize)
+	{
+		mChecksums.at(size_t(blockIndex)) = CChecksum::CRC32C(pBlock, blockSize);
+	};
+
+	//runs of captured blocks that are still shared are written from live image in one go
+	uint64_t runStart = 0, runEnd = 0;
+	auto flushRun = [&]()
+	{
+		if (runEnd == runStart)return;
+		uint64_t start = runStart * c_SnapshotBlockSize;
+		uint64_t end = std::min<uint64_t>(runEnd * c_SnapshotBlockSize, mCapacity);
+		outFile.seekp(std::streamoff(headerLength + start));
+		outFile.write(pLiveUserSpace + start, std::streamsize(end - start));
+		for (uint64_t i = runStart; i < runEnd; ++i)
+			setChecksum(i, pLiveUserSpace + i * c_SnapshotBlockSize, std::min<uint64_t>(c_SnapshotBlockSize, mCapacity - i * c_SnapshotBlockSize));
+	};
+	for (uint64_t i = 0; i < blockCount; ++i)
+	{
+		uint32_t state = mBlockStates.at(size_t(i));
+		if (state == c_BlockShared)
+		{
+			if (runEnd != i)
+			{
+				flushRun();
+				runStart = i;
+			}
+			runEnd = i + 1;
+			continue;
+		}
+		if (state == c_BlockNotCaptured)continue;
+
+		uint64_t blockStart = i * c_SnapshotBlockSize;
+		uint64_t blockSize = std::min<uint64_t>(c_SnapshotBlockSize, mCapacity - blockStart);
+		const char* pBlock = &mPreservedBlocks.at(size_t(uint64_t(state - 2) * c_SnapshotBlockSize));
+		outFile.seekp(std::streamoff(headerLength + blockStart));
+		outFile.write(pBlock, std::streamsize(blockSize));
+		setChecksum(i, pBlock, blockSize);
+	}
+	flushRun();
+	outFile.seekp(std::streamoff(headerLength + mCapacity));
+	outFile.write(reinterpret_cast<const char*>(&mChecksums.at(0)), std::streamsize(blockCount * sizeof(uint32_t)));
+	outFile.seekp(0);
+	outFile.write(&mFrozenHeader.at(0), std::streamsize(headerLength));
+
+	outFile.flush();
+	if (!outFile.good())
+	{
+		ERROR_MSG("Snapshot : Write failure! image file can't be written.");
+		return false;
+	}
+	return true;
+}
+
+uint64_t CSnapshot::GetPreservedBytes()
+{
+	return uint64_t(mPreservedBlockCount) * c_SnapshotBlockSize;
+}
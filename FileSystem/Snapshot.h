@@ -0,0 +1,57 @@
+
+/***********************************************************************
+
+									hSnapshot
+
+			Desc: point-in-time image of an installed virtual disk.
+			header and i-node table are copied when the snapshot is
+			taken, user file space is shared with the live image and
+			copied at block granularity (copy-on-write) : IFileSystem
+			calls PreserveBlocks before it modifies user space, so only
+			blocks that were allocated at snapshot time and modified
+			since are copied. the snapshot is streamed into a new image
+			file, which can be installed like any other virtual disk
+			(block checksums of captured blocks are computed on the way
+			and written behind user space).
+
+************************************************************************/
+
+#pragma once
+
+namespace Noise3D
+{
+	namespace Core
+	{
+		const uint32_t c_SnapshotBlockSize = c_ChecksumBlockSize;//copy-on-write granularity of user file space
+
+		class /*_declspec(dllexport)*/ CSnapshot
+		{
+		public:
+
+			//frozenHeader : header and i-node table as they should be written (header length bytes),
+			//freeSegments : free user space at snapshot time (sorted), its blocks are never preserved
+			CSnapshot(std::vector<char>& frozenHeader, uint64_t capacity, const std::vector<N_AddressRange>& freeSegments);
+
+			//user space [address, address+size) of live image is about to be modified
+			void		PreserveBlocks(uint64_t address, uint64_t size, const char* pLiveUserSpace);
+
+			//write the snapshot as a complete image file (free space is left sparse)
+			bool		WriteToFile(NFilePath imageFilePath, const char* pLiveUserSpace);
+
+			uint64_t	GetPreservedBytes();//bytes copied since the snapshot was taken
+
+		private:
+
+			static const uint32_t c_BlockNotCaptured = 0;//block was free at snapshot time
+			static const uint32_t c_BlockShared = 1;//block of live image is still the snapshot's
+			//(other values : index of preserved copy + 2)
+
+			std::vector<char> mFrozenHeader;
+			uint64_t mCapacity;
+			std::vector<uint32_t> mBlockStates;
+			std::vector<uint32_t> mChecksums;//block checksums of the image (0 for blocks not captured)
+			std::vector<char> mPreservedBlocks;
+			uint32_t mPreservedBlockCount;
+		};
+	}
+}
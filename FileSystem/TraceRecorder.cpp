@@ -0,0 +1,243 @@
+
+/***********************************************************************
+
+									cppTrace Recorder
+
+************************************************************************/
+
+#include "Noise3D.h"
+
+using namespace Noise3D::Core;
+
+template<typename T>
+static inline void WriteField(std::ofstream& out, T value)
+{
+	out.write((char*)&value, sizeof(T));
+}
+
+template<typename T>
+static inline bool ReadField(std::ifstream& in, T& value)
+{
+	in.read((char*)&value, sizeof(T));
+	return in.gcount() == sizeof(T);
+}
+
+/***************************************************
+						TRACE RECORDER
+****************************************************/
+
+CTraceRecorder::CTraceRecorder() :
+	m_pTraceFile(nullptr),
+	mNextFileHandle(1)
+{
+}
+
+CTraceRecorder::~CTraceRecorder()
+{
+	Close();
+}
+
+bool CTraceRecorder::Open(NFilePath traceFilePath, uint64_t vdiskCapacity, uint32_t indexNodeCount, uint32_t blockSize)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	if (m_pTraceFile != nullptr)
+	{
+		ERROR_MSG("TraceRecorder : Open failure! a trace is already being recorded.");
+		return false;
+	}
+
+	m_pTraceFile = new std::ofstream(traceFilePath, std::ios::binary | std::ios::trunc);
+	if (!m_pTraceFile->is_open())
+	{
+		ERROR_MSG("TraceRecorder : Open failure! trace file can't be created.");
+		delete m_pTraceFile;
+		m_pTraceFile = nullptr;
+		return false;
+	}
+
+	WriteField(*m_pTraceFile, c_TraceFileMagicNumber);
+	WriteField(*m_pTraceFile, c_TraceFileVersion);
+	WriteField(*m_pTraceFile, vdiskCapacity);
+	WriteField(*m_pTraceFile, indexNodeCount);
+	WriteField(*m_pTraceFile, blockSize);
+
+	mNextFileHandle = 1;
+	mThreadIdMap.clear();
+	mStartTime = std::chrono::high_resolution_clock::now();
+	return true;
+}
+
+void CTraceRecorder::Close()
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	if (m_pTraceFile == nullptr)return;
+	m_pTraceFile->close();
+	delete m_pTraceFile;
+	m_pTraceFile = nullptr;
+}
+
+bool CTraceRecorder::IsRecording()
+{
+	return m_pTraceFile != nullptr;
+}
+
+uint32_t CTraceRecorder::AllocateFileHandle()
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	return mNextFileHandle++;
+}
+
+uint64_t CTraceRecorder::GetTimestamp()
+{
+	auto now = std::chrono::high_resolution_clock::now();
+	return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(now - mStartTime).count());
+}
+
+void CTraceRecorder::Record(N_TraceRecord & record)
+{
+	std::lock_guard<std::mutex> lock(mLock);
+	if (m_pTraceFile == nullptr)return;
+
+	record.threadId = mFunction_GetThreadId();
+	uint16_t nameLength = uint16_t(record.name.size() < 0xffff ? record.name.size() : 0xffff);
+
+	std::ofstream& out = *m_pTraceFile;
+	WriteField(out, record.opCode);
+	WriteField(out, record.result);
+	WriteField(out, record.threadId);
+	WriteField(out, record.fileHandle);
+	WriteField(out, record.arg0);
+	WriteField(out, record.arg1);
+	WriteField(out, record.timestamp);
+	WriteField(out, record.duration);
+	WriteField(out, nameLength);
+	if (nameLength > 0)out.write(record.name.c_str(), nameLength);
+}
+
+uint16_t CTraceRecorder::mFunction_GetThreadId()
+{
+	//(lock is held by caller)
+	auto iter = mThreadIdMap.find(std::this_thread::get_id());
+	if (iter != mThreadIdMap.end())return iter->second;
+
+	uint16_t newId = uint16_t(mThreadIdMap.size());
+	mThreadIdMap.insert(std::make_pair(std::this_thread::get_id(), newId));
+	return newId;
+}
+
+/***************************************************
+						TRACE SCOPE
+****************************************************/
+
+CTraceScope::CTraceScope(CTraceRecorder * pRecorder, NOISE_TRACE_OP op, const std::string & name, uint64_t arg0, uint64_t arg1, uint32_t fileHandle):
+	m_pRecorder(pRecorder)
+{
+	if (m_pRecorder == nullptr)return;
+
+	mRecord.opCode = uint8_t(op);
+	mRecord.name = name;
+	mRecord.arg0 = arg0;
+	mRecord.arg1 = arg1;
+	mRecord.fileHandle = fileHandle;
+	mRecord.result = 1;
+	mRecord.timestamp = m_pRecorder->GetTimestamp();
+}
+
+CTraceScope::~CTraceScope()
+{
+	if (m_pRecorder == nullptr)return;
+
+	mRecord.duration = uint32_t(m_pRecorder->GetTimestamp() - mRecord.timestamp);
+	m_pRecorder->Record(mRecord);
+}
+
+/***************************************************
+						TRACE READER
+****************************************************/
+
+CTraceReader::CTraceReader():
+	m_pTraceFile(nullptr),
+	mVDiskCapacity(0),
+	mIndexNodeCount(0),
+	mBlockSize(1)
+{
+}
+
+CTraceReader::~CTraceReader()
+{
+	if (m_pTraceFile != nullptr)delete m_pTraceFile;
+}
+
+bool CTraceReader::Open(NFilePath traceFilePath)
+{
+	if (m_pTraceFile != nullptr)delete m_pTraceFile;
+	m_pTraceFile = new std::ifstream(traceFilePath, std::ios::binary);
+	if (!m_pTraceFile->is_open())
+	{
+		ERROR_MSG("TraceReader : Open failure! trace file can't be opened.");
+		return false;
+	}
+
+	uint32_t magicNumber = 0, version = 0;
+	if (!ReadField(*m_pTraceFile, magicNumber) || !ReadField(*m_pTraceFile, version))
+	{
+		ERROR_MSG("TraceReader : Open failure! corrupted trace file.");
+		return false;
+	}
+
+	if (magicNumber != c_TraceFileMagicNumber || version != c_TraceFileVersion)
+	{
+		ERROR_MSG("TraceReader : Open failure! not a trace file or version not match.");
+		return false;
+	}
+
+	if (!ReadField(*m_pTraceFile, mVDiskCapacity) || !ReadField(*m_pTraceFile, mIndexNodeCount) || !ReadField(*m_pTraceFile, mBlockSize))
+	{
+		ERROR_MSG("TraceReader : Open failure! corrupted trace file.");
+		return false;
+	}
+
+	return true;
+}
+
+bool CTraceReader::ReadNext(N_TraceRecord & outRecord)
+{
+	if (m_pTraceFile == nullptr)return false;
+
+	std::ifstream& in = *m_pTraceFile;
+	uint16_t nameLength = 0;
+	bool isSucceeded =
+		ReadField(in, outRecord.opCode) &&
+		ReadField(in, outRecord.result) &&
+		ReadField(in, outRecord.threadId) &&
+		ReadField(in, outRecord.fileHandle) &&
+		ReadField(in, outRecord.arg0) &&
+		ReadField(in, outRecord.arg1) &&
+		ReadField(in, outRecord.timestamp) &&
+		ReadField(in, outRecord.duration) &&
+		ReadField(in, nameLength);
+	if (!isSucceeded)return false;
+
+	outRecord.name.resize(nameLength);
+	if (nameLength > 0)
+	{
+		in.read(&outRecord.name[0], nameLength);
+		if (in.gcount() != nameLength)return false;
+	}
+	return true;
+}
+
+uint64_t CTraceReader::GetVDiskCapacity()
+{
+	return mVDiskCapacity;
+}
+
+uint32_t CTraceReader::GetIndexNodeCount()
+{
+	return mIndexNodeCount;
+}
+
+uint32_t CTraceReader::GetBlockSize()
+{
+	return mBlockSize;
+}
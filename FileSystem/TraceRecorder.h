@@ -0,0 +1,152 @@
+
+/***********************************************************************
+
+									hTrace Recorder
+
+			Desc: record public IFileSystem/IFile calls (arguments,
+			result, timestamp and duration) into a compact binary
+			trace, which can be replayed offline against another
+			virtual disk image (see benchmark_TraceReplay.cpp).
+
+			trace file layout (little-endian):
+				header : magic(4) | version(4) | vdisk capacity(8) |
+							i-node count(4) | block size(4)
+				record : opCode(1) | result(1) | threadId(2) | fileHandle(4) |
+							arg0(8) | arg1(8) | timestamp ns(8) | duration ns(4) |
+							nameLength(2) | name(nameLength)
+
+************************************************************************/
+
+#pragma once
+
+namespace Noise3D
+{
+	namespace Core
+	{
+		enum NOISE_TRACE_OP
+		{
+			NOISE_TRACE_OP_LOGIN = 1,//name=user name (password is never recorded)
+			NOISE_TRACE_OP_SET_WORKING_DIR = 2,//name=dir
+			NOISE_TRACE_OP_CREATE_FOLDER = 3,//name=folder name
+			NOISE_TRACE_OP_DELETE_FOLDER = 4,//name=folder name
+			NOISE_TRACE_OP_ENUMERATE = 5,//arg0=enumerated folder count, arg1=enumerated file count
+			NOISE_TRACE_OP_CREATE_FILE = 6,//name=file name, arg0=byte size, arg1=access mode
+			NOISE_TRACE_OP_DELETE_FILE = 7,//name=file name
+			NOISE_TRACE_OP_OPEN_FILE = 8,//name=file name, fileHandle=handle assigned to the opened file
+			NOISE_TRACE_OP_CLOSE_FILE = 9,//fileHandle
+			NOISE_TRACE_OP_FILE_READ = 10,//fileHandle, arg0=start index, arg1=size
+			NOISE_TRACE_OP_FILE_WRITE = 11,//fileHandle, arg0=start index, arg1=size
+			NOISE_TRACE_OP_FILE_RESIZE = 12,//fileHandle, arg0=new size
+			NOISE_TRACE_OP_WALK = 13,//name=start dir, arg0=max depth, arg1=matched count
+			NOISE_TRACE_OP_RENAME = 14,//name=old path + '\0' + new path
+			NOISE_TRACE_OP_CLONE_FILE = 15,//name=source path + '\0' + new path
+			NOISE_TRACE_OP_COMPRESS_FILE = 16,//name=file name
+			NOISE_TRACE_OP_IMPORT_FILE = 17,//name=host file path + '\0' + file path
+			NOISE_TRACE_OP_EXPORT_FILE = 18,//name=file path + '\0' + host file path
+			NOISE_TRACE_OP_IMPORT_DIRECTORY = 19,//name=host folder path + '\0' + folder path
+			NOISE_TRACE_OP_EXPORT_ARCHIVE = 20,//name=folder path + '\0' + archive path
+			NOISE_TRACE_OP_IMPORT_ARCHIVE = 21,//name=archive path + '\0' + folder path
+		};
+
+		struct N_TraceRecord
+		{
+			N_TraceRecord() :opCode(0), result(0), threadId(0), fileHandle(0), arg0(0), arg1(0), timestamp(0), duration(0) {}
+
+			uint8_t opCode;//NOISE_TRACE_OP
+			uint8_t result;//succeeded=1, failed=0
+			uint16_t threadId;//small sequential id of the calling thread
+			uint32_t fileHandle;//0 for calls that are not related to an opened file
+			uint64_t arg0;
+			uint64_t arg1;
+			uint64_t timestamp;//nanoseconds since the recording started
+			uint32_t duration;//nanoseconds
+			std::string name;
+		};
+
+		class /*_declspec(dllexport)*/ CTraceRecorder
+		{
+		public:
+
+			CTraceRecorder();
+
+			~CTraceRecorder();
+
+			//geometry of the traced virtual disk is saved so that replay can create a fresh one
+			bool Open(NFilePath traceFilePath, uint64_t vdiskCapacity, uint32_t indexNodeCount, uint32_t blockSize);
+
+			void Close();
+
+			bool IsRecording();
+
+			uint32_t AllocateFileHandle();//opened files are identified by handle instead of pointer
+
+			uint64_t GetTimestamp();//nanoseconds since the recording started
+
+			void Record(N_TraceRecord& record);//thread id is filled by recorder
+
+		private:
+
+			uint16_t mFunction_GetThreadId();
+
+			std::ofstream*	m_pTraceFile;
+			std::mutex			mLock;
+			uint32_t				mNextFileHandle;
+			std::chrono::high_resolution_clock::time_point mStartTime;
+			std::unordered_map<std::thread::id, uint16_t> mThreadIdMap;
+		};
+
+		//measure the duration of a public call and record it when the scope ends.
+		//nothing happens if the recorder pointer is null (recording is disabled)
+		class CTraceScope
+		{
+		public:
+
+			CTraceScope(CTraceRecorder* pRecorder, NOISE_TRACE_OP op, const std::string& name = "", uint64_t arg0 = 0, uint64_t arg1 = 0, uint32_t fileHandle = 0);
+
+			~CTraceScope();
+
+			bool		Result(bool isSucceeded) { mRecord.result = isSucceeded ? 1 : 0; return isSucceeded; }
+
+			template<typename T>
+			T*		Result(T* pObj) { mRecord.result = (pObj != nullptr) ? 1 : 0; return pObj; }
+
+			void		SetArgs(uint64_t arg0, uint64_t arg1) { mRecord.arg0 = arg0; mRecord.arg1 = arg1; }
+
+			void		SetFileHandle(uint32_t fileHandle) { mRecord.fileHandle = fileHandle; }
+
+		private:
+
+			CTraceRecorder* m_pRecorder;
+			N_TraceRecord mRecord;
+		};
+
+		class /*_declspec(dllexport)*/ CTraceReader
+		{
+		public:
+
+			CTraceReader();
+
+			~CTraceReader();
+
+			bool Open(NFilePath traceFilePath);
+
+			bool ReadNext(N_TraceRecord& outRecord);//false at the end of trace
+
+			uint64_t GetVDiskCapacity();
+
+			uint32_t GetIndexNodeCount();
+
+			uint32_t GetBlockSize();
+
+		private:
+
+			std::ifstream* m_pTraceFile;
+			uint64_t mVDiskCapacity;
+			uint32_t mIndexNodeCount;
+			uint32_t mBlockSize;
+		};
+
+		const uint32_t c_TraceFileMagicNumber = 0x5254464e;//"NFTR"
+		const uint32_t c_TraceFileVersion = 2;
+	}
+}
@@ -0,0 +1,291 @@
+
+/***********************************************************************
+
+						cppAllocator Benchmark & Fragmentation Simulator
+
+			Desc: replay synthetic or recorded allocation traces against
+			CAllocator with every allocation policy. throughput, latency,
+			free segment count and external fragmentation are sampled
+			over time and written as one JSON object per line.
+
+			usage: benchmark_Allocator [outputPath] [--trace recordedTrace.txt]
+
+			recorded trace format (text, one operation per line):
+				A <id> <size>		allocate <size> units and tag it with <id>
+				R <id>				release the segment tagged with <id>
+
+************************************************************************/
+
+#include "Noise3D.h"
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <sstream>
+#include <cmath>
+
+using namespace Noise3D::Core;
+std::ofstream* g_pLogFile;
+
+static const uint32_t c_simAddressSpaceSize = 1024 * 1024 * 1024;//same as the largest virtual disk
+static const uint32_t c_simOperationCount = 200000;
+static const uint32_t c_simSampleInterval = 5000;//ops between 2 fragmentation samples
+
+struct N_AllocTraceOp
+{
+	bool isAllocation;
+	uint32_t id;
+	uint32_t size;//only for allocation
+};
+
+struct N_AllocTrace
+{
+	std::string name;
+	std::vector<N_AllocTraceOp> ops;
+};
+
+//base of synthetic trace generators : keep a live set, and release random live segment
+//when occupancy exceeds target
+class CTraceBuilder
+{
+public:
+
+	CTraceBuilder(const std::string& name, uint32_t seed) :mRng(seed), mNextId(0), mLiveBytes(0) { mTrace.name = name; }
+
+	void Allocate(uint32_t size)
+	{
+		N_AllocTraceOp op = { true, mNextId, size };
+		mTrace.ops.push_back(op);
+		mLive.push_back(std::make_pair(mNextId, size));
+		mLiveBytes += size;
+		++mNextId;
+	}
+
+	void ReleaseRandom()
+	{
+		if (mLive.empty())return;
+		std::uniform_int_distribution<size_t> dist(0, mLive.size() - 1);
+		size_t index = dist(mRng);
+		N_AllocTraceOp op = { false, mLive.at(index).first, 0 };
+		mTrace.ops.push_back(op);
+		mLiveBytes -= mLive.at(index).second;
+		mLive.at(index) = mLive.back();
+		mLive.pop_back();
+	}
+
+	uint64_t GetLiveBytes() { return mLiveBytes; }
+
+	std::mt19937& Rng() { return mRng; }
+
+	N_AllocTrace& GetTrace() { return mTrace; }
+
+private:
+
+	std::mt19937 mRng;
+	uint32_t mNextId;
+	uint64_t mLiveBytes;
+	std::vector<std::pair<uint32_t, uint32_t>> mLive;//id, size
+	N_AllocTrace mTrace;
+};
+
+//sizes drawn from 'sizeFunc', live data is kept around 'targetOccupancy' of the address space
+template<typename SizeFunc>
+static N_AllocTrace GenerateSteadyStateTrace(const std::string& name, double targetOccupancy, double releaseProbability, SizeFunc sizeFunc)
+{
+	CTraceBuilder builder(name, 2017);
+	std::uniform_real_distribution<double> coin(0.0, 1.0);
+	uint64_t targetBytes = uint64_t(targetOccupancy * double(c_simAddressSpaceSize));
+
+	while (builder.GetTrace().ops.size() < c_simOperationCount)
+	{
+		bool isFilled = builder.GetLiveBytes() >= targetBytes;
+		if (isFilled || coin(builder.Rng()) < releaseProbability)
+			builder.ReleaseRandom();
+		else
+			builder.Allocate(sizeFunc(builder.Rng()));
+	}
+	return builder.GetTrace();
+}
+
+//directory files grow 128 bytes per new child, and IFileSystem re-allocates
+//the whole directory file (release old segment, allocate a larger one) for every child created
+static N_AllocTrace GenerateDirectoryResizeTrace()
+{
+	N_AllocTrace trace;
+	trace.name = "dir_resize";
+	const uint32_t dirCount = 64;
+	std::mt19937 rng(2017);
+	std::uniform_int_distribution<uint32_t> dirDist(0, dirCount - 1);
+	std::uniform_int_distribution<uint32_t> fileSizeDist(64, 64 * 1024);
+
+	std::vector<std::pair<uint32_t, uint32_t>> dirs;//id, size
+	uint32_t nextId = 0;
+	for (uint32_t i = 0; i < dirCount; ++i)
+	{
+		N_AllocTraceOp op = { true, nextId, 8 };
+		trace.ops.push_back(op);
+		dirs.push_back(std::make_pair(nextId++, 8));
+	}
+
+	while (trace.ops.size() < c_simOperationCount)
+	{
+		//new file
+		N_AllocTraceOp fileOp = { true, nextId++, fileSizeDist(rng) };
+		trace.ops.push_back(fileOp);
+
+		//its parent directory file is resized
+		auto& dir = dirs.at(dirDist(rng));
+		N_AllocTraceOp releaseOp = { false, dir.first, 0 };
+		trace.ops.push_back(releaseOp);
+		dir.first = nextId++;
+		dir.second += 128;
+		N_AllocTraceOp allocOp = { true, dir.first, dir.second };
+		trace.ops.push_back(allocOp);
+	}
+	return trace;
+}
+
+static bool LoadRecordedTrace(const std::string& path, N_AllocTrace& outTrace)
+{
+	std::ifstream inFile(path);
+	if (!inFile.is_open())return false;
+
+	outTrace.name = "recorded";
+	std::string line;
+	while (std::getline(inFile, line))
+	{
+		std::istringstream is(line);
+		char type = 0;
+		N_AllocTraceOp op = { false, 0, 0 };
+		is >> type >> op.id;
+		if (type == 'A') { op.isAllocation = true; is >> op.size; }
+		else if (type != 'R')continue;
+		outTrace.ops.push_back(op);
+	}
+	return true;
+}
+
+static std::string PolicyName(NOISE_ALLOCATION_POLICY policy)
+{
+	switch (policy)
+	{
+	case NOISE_ALLOCATION_POLICY_BEST_FIT: return "best_fit";
+	case NOISE_ALLOCATION_POLICY_NEXT_FIT: return "next_fit";
+	default: return "first_fit";
+	}
+}
+
+static void ReplayTrace(const N_AllocTrace& trace, NOISE_ALLOCATION_POLICY policy, std::ostream& out)
+{
+	CAllocator allocator(c_simAddressSpaceSize, policy);
+	std::unordered_map<uint32_t, N_AddressRange> liveSegments;//trace id -> allocated segment
+	std::vector<uint64_t> latencies;
+	latencies.reserve(trace.ops.size());
+	uint32_t failedAllocCount = 0;
+	uint64_t totalTime = 0;
+	std::string header = "{\"suite\":\"allocator\",\"policy\":\"" + PolicyName(policy) + "\",\"trace\":\"" + trace.name + "\"";
+
+	for (uint32_t i = 0; i < trace.ops.size(); ++i)
+	{
+		const N_AllocTraceOp& op = trace.ops.at(i);
+		auto t1 = std::chrono::high_resolution_clock::now();
+		if (op.isAllocation)
+		{
+			uint64_t addr = allocator.Allocate(op.size);
+			auto t2 = std::chrono::high_resolution_clock::now();
+			latencies.push_back(uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count()));
+			if (addr == c_invalid_alloc_address)++failedAllocCount;
+			else liveSegments.insert(std::make_pair(op.id, N_AddressRange(addr, op.size)));
+		}
+		else
+		{
+			auto iter = liveSegments.find(op.id);
+			if (iter == liveSegments.end())continue;//its allocation failed
+			allocator.Release(iter->second.start, iter->second.size);
+			auto t2 = std::chrono::high_resolution_clock::now();
+			latencies.push_back(uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count()));
+			liveSegments.erase(iter);
+		}
+		totalTime += latencies.back();
+
+		if (i % c_simSampleInterval == 0 || i + 1 == trace.ops.size())
+		{
+			//external fragmentation = 1 - largest free segment / total free space
+			uint64_t freeSpace = allocator.GetFreeSpace();
+			uint64_t largestFree = allocator.GetLargestFreeSegmentSize();
+			double extFragmentation = freeSpace == 0 ? 0.0 : 1.0 - double(largestFree) / double(freeSpace);
+			out << header << ",\"type\":\"sample\",\"op_index\":" << i
+				<< ",\"free_bytes\":" << freeSpace
+				<< ",\"free_segments\":" << allocator.GetFreeSegmentCount()
+				<< ",\"largest_free_segment\":" << largestFree
+				<< ",\"external_fragmentation\":" << extFragmentation
+				<< ",\"failed_allocations\":" << failedAllocCount
+				<< "}" << std::endl;
+		}
+	}
+
+	std::vector<uint64_t> sorted = latencies;
+	std::sort(sorted.begin(), sorted.end());
+	auto percentile = [&](double p) ->uint64_t {return sorted.empty() ? 0 : sorted.at(size_t(p * double(sorted.size() - 1) + 0.5)); };
+	double opsPerSec = totalTime == 0 ? 0.0 : double(latencies.size()) * 1e9 / double(totalTime);
+
+	out << header << ",\"type\":\"summary\",\"count\":" << latencies.size()
+		<< ",\"ops_per_sec\":" << opsPerSec
+		<< ",\"p50_ns\":" << percentile(0.5)
+		<< ",\"p99_ns\":" << percentile(0.99)
+		<< ",\"max_ns\":" << percentile(1.0)
+		<< ",\"failed_allocations\":" << failedAllocCount
+		<< ",\"final_free_segments\":" << allocator.GetFreeSegmentCount()
+		<< "}" << std::endl;
+
+	std::cout << "benchmark: " << trace.name << " / " << PolicyName(policy) << " : " << opsPerSec << " ops/sec, worst " << percentile(1.0) << " ns" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	std::string outputPath = "benchmark_Allocator.jsonl";
+	std::string recordedTracePath = "";
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::string(argv[i]) == "--trace" && i + 1 < argc)recordedTracePath = argv[++i];
+		else outputPath = argv[i];
+	}
+
+	std::ofstream outFile(outputPath, std::ios::trunc);
+	if (!outFile.is_open())
+	{
+		std::cout << "benchmark: output file can't be created : " << outputPath << std::endl;
+		return 1;
+	}
+
+	std::vector<N_AllocTrace> traces;
+	traces.push_back(GenerateSteadyStateTrace("uniform", 0.7, 0.5, [](std::mt19937& rng)
+	{
+		return std::uniform_int_distribution<uint32_t>(64, 64 * 1024)(rng);
+	}));
+	traces.push_back(GenerateSteadyStateTrace("lognormal", 0.7, 0.5, [](std::mt19937& rng)
+	{
+		//median 4KB, heavy tail up to 16MB
+		double size = std::lognormal_distribution<double>(std::log(4096.0), 2.0)(rng);
+		return uint32_t(std::max(16.0, std::min(size, 16.0 * 1024 * 1024)));
+	}));
+	traces.push_back(GenerateSteadyStateTrace("churn", 0.9, 0.5, [](std::mt19937& rng)
+	{
+		return std::uniform_int_distribution<uint32_t>(16, 8 * 1024)(rng);
+	}));
+	traces.push_back(GenerateDirectoryResizeTrace());
+
+	if (recordedTracePath != "")
+	{
+		N_AllocTrace recorded;
+		if (LoadRecordedTrace(recordedTracePath, recorded))traces.push_back(recorded);
+		else std::cout << "benchmark: recorded trace can't be loaded : " << recordedTracePath << std::endl;
+	}
+
+	NOISE_ALLOCATION_POLICY policies[] = { NOISE_ALLOCATION_POLICY_FIRST_FIT, NOISE_ALLOCATION_POLICY_BEST_FIT, NOISE_ALLOCATION_POLICY_NEXT_FIT };
+	for (auto& trace : traces)
+		for (auto policy : policies)
+			ReplayTrace(trace, policy, outFile);
+
+	outFile.close();
+	return 0;
+}
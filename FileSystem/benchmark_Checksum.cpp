@@ -0,0 +1,120 @@
+/***********************************************************************
+
+						cppBlock Checksum Benchmark
+
+			Desc: measure CRC32C throughput of user space blocks against
+			memcpy of the same data, for working sets that fit in cache
+			and for one that doesn't. "copy+crc" is what writing back an
+			image costs per byte, its overhead over plain copy is the
+			checksum overhead. results are written as one JSON object
+			per line.
+
+			usage: benchmark_Checksum [outputPath] [--quick]
+
+************************************************************************/
+
+#include "Noise3D.h"
+#include <chrono>
+#include <sstream>
+
+using namespace Noise3D::Core;
+std::ofstream* g_pLogFile;
+
+static const uint64_t c_processedBytesPerMeasure = 8ull * 1024 * 1024 * 1024;//total bytes of one measurement
+
+struct N_ChecksumResult
+{
+	std::string operation;
+	uint64_t workingSetSize;
+	uint64_t processedBytes;
+	uint64_t totalTimeNs;
+};
+
+static std::string ToJson(const N_ChecksumResult& r, const N_ChecksumResult& copyResult)
+{
+	double seconds = double(r.totalTimeNs) / 1e9;
+	std::ostringstream ss;
+	ss << "{\"op\":\"" << r.operation << "\""
+		<< ",\"kernel\":\"" << (CChecksum::IsHardwareAccelerated() ? "sse4.2" : "table") << "\""
+		<< ",\"working_set\":" << r.workingSetSize
+		<< ",\"bytes\":" << r.processedBytes
+		<< ",\"gb_per_sec\":" << (seconds > 0 ? double(r.processedBytes) / 1e9 / seconds : 0)
+		<< ",\"time_vs_memcpy\":" << (copyResult.totalTimeNs == 0 ? 0 : double(r.totalTimeNs) / double(copyResult.totalTimeNs))
+		<< "}";
+	return ss.str();
+}
+
+template<typename Func>
+static N_ChecksumResult Measure(const std::string& operation, uint64_t workingSetSize, uint64_t processedBytes, Func blockOp)
+{
+	N_ChecksumResult result = { operation, workingSetSize, processedBytes, 0 };
+	auto t1 = std::chrono::high_resolution_clock::now();
+	for (uint64_t done = 0; done < processedBytes; done += workingSetSize)
+		for (uint64_t offset = 0; offset < workingSetSize; offset += c_ChecksumBlockSize)blockOp(offset);
+	auto t2 = std::chrono::high_resolution_clock::now();
+	result.totalTimeNs = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count());
+	return result;
+}
+
+static void RunBenchmark(uint64_t workingSetSize, uint64_t processedBytes, std::ostream& out)
+{
+	std::vector<char> src(static_cast<size_t>(workingSetSize)), dst(static_cast<size_t>(workingSetSize));
+	for (size_t i = 0; i < src.size(); ++i)src[i] = char(i * 2654435761u >> 13);
+	std::vector<uint32_t> checksums(size_t(workingSetSize / c_ChecksumBlockSize));
+
+	N_ChecksumResult copyResult = Measure("memcpy", workingSetSize, processedBytes, [&](uint64_t offset)
+	{
+		memcpy(&dst[size_t(offset)], &src[size_t(offset)], c_ChecksumBlockSize);
+	});
+	N_ChecksumResult crcResult = Measure("crc32c", workingSetSize, processedBytes, [&](uint64_t offset)
+	{
+		checksums[size_t(offset / c_ChecksumBlockSize)] = CChecksum::CRC32C(&src[size_t(offset)], c_ChecksumBlockSize);
+	});
+	N_ChecksumResult copyCrcResult = Measure("copy+crc32c", workingSetSize, processedBytes, [&](uint64_t offset)
+	{
+		memcpy(&dst[size_t(offset)], &src[size_t(offset)], c_ChecksumBlockSize);
+		checksums[size_t(offset / c_ChecksumBlockSize)] = CChecksum::CRC32C(&dst[size_t(offset)], c_ChecksumBlockSize);
+	});
+
+	out << ToJson(copyResult, copyResult) << std::endl;
+	out << ToJson(crcResult, copyResult) << std::endl;
+	out << ToJson(copyCrcResult, copyResult) << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	g_pLogFile = new std::ofstream;
+
+	std::string outputPath = "benchmark_Checksum.jsonl";
+	bool isQuickMode = false;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::string(argv[i]) == "--quick")isQuickMode = true;
+		else outputPath = argv[i];
+	}
+
+	std::ofstream outFile(outputPath, std::ios::trunc);
+	if (!outFile.is_open())
+	{
+		std::cout << "benchmark: output file can't be created : " << outputPath << std::endl;
+		return 1;
+	}
+
+	//L1, L2, last level cache, memory
+	std::vector<uint64_t> workingSetSizes = { 16ull << 10, 256ull << 10, 4ull << 20, 256ull << 20 };
+	if (isQuickMode)workingSetSizes = { 256ull << 10, 64ull << 20 };
+	uint64_t processedBytes = isQuickMode ? c_processedBytesPerMeasure / 16 : c_processedBytesPerMeasure;
+
+	for (uint64_t workingSetSize : workingSetSizes)
+	{
+		std::cout << "benchmark: working set=" << workingSetSize << std::endl;
+		std::ostringstream lines;
+		RunBenchmark(workingSetSize, std::max(processedBytes, workingSetSize), lines);
+		std::cout << lines.str();
+		outFile << lines.str();
+	}
+
+	outFile.close();
+	delete g_pLogFile;
+	return 0;
+}
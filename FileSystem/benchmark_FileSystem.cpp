@@ -0,0 +1,256 @@
+
+/***********************************************************************
+
+						cppFile System Metadata Benchmark
+
+			Desc: measure throughput & latency of metadata operations
+			(create/delete/open/enumerate/SetWorkingDir) at production
+			scale. every (capacity, fan-out, depth, fragmentation)
+			combination is measured on a freshly created virtual disk,
+			results are appended as one JSON object per line so that
+			they can be tracked across releases.
+
+			usage: benchmark_FileSystem [outputPath] [--quick]
+
+************************************************************************/
+
+#include "Noise3D.h"
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <sstream>
+#include <cstdio>
+
+using namespace Noise3D::Core;
+std::ofstream* g_pLogFile;
+
+static const char* c_benchmarkImagePath = "benchmark_tmp.nvd";
+static const uint32_t c_benchmarkFileSize = 512;//byte size of every measured file
+static const uint32_t c_setWorkingDirRepeatCount = 1000;
+
+struct N_BenchmarkConfig
+{
+	NOISE_VIRTUAL_DISK_CAPACITY capacity;
+	uint32_t capacityMB;
+	uint32_t indexNodeCount;
+	uint32_t fanOut;//file count in the measured directory
+	uint32_t depth;//level of the measured directory (root = 0)
+	uint32_t fragmentationPercent;//percent of filler files deleted before measurement
+};
+
+//latency samples (in nanoseconds) of one kind of operation
+class CLatencyRecorder
+{
+public:
+
+	template<typename Func>
+	bool Measure(Func func)
+	{
+		auto t1 = std::chrono::high_resolution_clock::now();
+		bool result = func();
+		auto t2 = std::chrono::high_resolution_clock::now();
+		mSamples.push_back(uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count()));
+		mTotalTime += mSamples.back();
+		if (!result)++mFailureCount;
+		return result;
+	}
+
+	uint64_t Percentile(double p)
+	{
+		if (mSamples.empty())return 0;
+		std::vector<uint64_t> sorted = mSamples;
+		std::sort(sorted.begin(), sorted.end());
+		size_t index = size_t(p * double(sorted.size() - 1) + 0.5);
+		return sorted.at(index);
+	}
+
+	std::string ToJson(const N_BenchmarkConfig& cfg, const std::string& opName)
+	{
+		double opsPerSec = mTotalTime == 0 ? 0.0 : double(mSamples.size()) * 1e9 / double(mTotalTime);
+		std::ostringstream os;
+		os << "{\"suite\":\"metadata\""
+			<< ",\"capacity_mb\":" << cfg.capacityMB
+			<< ",\"fanout\":" << cfg.fanOut
+			<< ",\"depth\":" << cfg.depth
+			<< ",\"fragmentation_pct\":" << cfg.fragmentationPercent
+			<< ",\"op\":\"" << opName << "\""
+			<< ",\"count\":" << mSamples.size()
+			<< ",\"failures\":" << mFailureCount
+			<< ",\"ops_per_sec\":" << opsPerSec
+			<< ",\"p50_ns\":" << Percentile(0.5)
+			<< ",\"p90_ns\":" << Percentile(0.9)
+			<< ",\"p99_ns\":" << Percentile(0.99)
+			<< ",\"p999_ns\":" << Percentile(0.999)
+			<< ",\"max_ns\":" << Percentile(1.0)
+			<< "}";
+		return os.str();
+	}
+
+private:
+
+	std::vector<uint64_t> mSamples;
+	uint64_t mTotalTime = 0;
+	uint32_t mFailureCount = 0;
+};
+
+//leave holes in user file space by creating filler files and deleting a part of them
+static void FragmentAddressSpace(IFileSystem& fs, uint32_t fragmentationPercent, uint32_t fillerCount)
+{
+	if (fragmentationPercent == 0)return;
+
+	fs.SetWorkingDir("/");
+	fs.CreateFolder("filler");
+	fs.SetWorkingDir("/filler");
+
+	std::mt19937 rng(12345);
+	std::uniform_int_distribution<uint32_t> sizeDist(64, 16 * 1024);
+	for (uint32_t i = 0; i < fillerCount; ++i)
+	{
+		fs.CreateFile("f" + std::to_string(i), sizeDist(rng), NOISE_FILE_ACCESS_MODE_OWNER_RW);
+	}
+
+	//deleted files are spread evenly, so holes are scattered all over the address space
+	for (uint32_t i = 0; i < fillerCount; ++i)
+	{
+		if ((i * fragmentationPercent) / 100 != ((i + 1) * fragmentationPercent) / 100)
+			fs.DeleteFile("f" + std::to_string(i));
+	}
+}
+
+static void RunBenchmark(const N_BenchmarkConfig& cfg, std::ostream& out)
+{
+	std::remove(c_benchmarkImagePath);
+	IFileSystem fs;
+	if (!fs.CreateVirtualDisk(c_benchmarkImagePath, cfg.capacity) || !fs.InstallVirtualDisk(c_benchmarkImagePath))
+	{
+		std::cout << "benchmark: virtual disk can't be prepared, configuration skipped." << std::endl;
+		return;
+	}
+	fs.Login("ROOT", "ROOT666666");
+
+	//filler files occupy i-nodes as well, keep enough of them for the measured directory
+	uint32_t reservedINodeCount = cfg.fanOut + cfg.depth + 2;
+	uint32_t fillerCount = reservedINodeCount < cfg.indexNodeCount ? std::min<uint32_t>(4096, (cfg.indexNodeCount - reservedINodeCount) / 2) : 0;
+	FragmentAddressSpace(fs, cfg.fragmentationPercent, fillerCount);
+
+	//build a chain of folders :  /d0/d1/..../d(depth-1)
+	std::string measuredDir = "/";
+	fs.SetWorkingDir("/");
+	for (uint32_t i = 0; i < cfg.depth; ++i)
+	{
+		std::string folderName = "d" + std::to_string(i);
+		fs.CreateFolder(folderName);
+		measuredDir += folderName + "/";
+		fs.SetWorkingDir(measuredDir);
+	}
+
+	std::vector<std::string> fileNames(cfg.fanOut);
+	for (uint32_t i = 0; i < cfg.fanOut; ++i)fileNames.at(i) = "file_" + std::to_string(i) + ".dat";
+
+	//create
+	CLatencyRecorder createRec;
+	for (auto& name : fileNames)
+		createRec.Measure([&]() {return fs.CreateFile(name, c_benchmarkFileSize, NOISE_FILE_ACCESS_MODE_OWNER_RW); });
+
+	//open (and close, an opened file can't be opened again)
+	CLatencyRecorder openRec;
+	for (auto& name : fileNames)
+	{
+		IFile* pFile = nullptr;
+		openRec.Measure([&]() {pFile = fs.OpenFile(name); return pFile != nullptr; });
+		if (pFile != nullptr)fs.CloseFile(pFile);
+	}
+
+	//enumerate (repeat count is decided by fan-out to keep running time bounded)
+	CLatencyRecorder enumRec;
+	uint32_t enumRepeatCount = std::max<uint32_t>(10, 100000 / cfg.fanOut);
+	for (uint32_t i = 0; i < enumRepeatCount; ++i)
+	{
+		enumRec.Measure([&]()
+		{
+			N_FileSystemEnumResult result;
+			fs.EnumerateFilesAndDirs(result);
+			return result.fileList.size() == cfg.fanOut;
+		});
+	}
+
+	//SetWorkingDir from root to the deepest folder
+	CLatencyRecorder setWorkingDirRec;
+	for (uint32_t i = 0; i < c_setWorkingDirRepeatCount; ++i)
+		setWorkingDirRec.Measure([&]() {return fs.SetWorkingDir(measuredDir); });
+
+	//delete
+	CLatencyRecorder deleteRec;
+	for (auto& name : fileNames)
+		deleteRec.Measure([&]() {return fs.DeleteFile(name); });
+
+	out << createRec.ToJson(cfg, "create") << std::endl;
+	out << openRec.ToJson(cfg, "open") << std::endl;
+	out << enumRec.ToJson(cfg, "enumerate") << std::endl;
+	out << setWorkingDirRec.ToJson(cfg, "set_working_dir") << std::endl;
+	out << deleteRec.ToJson(cfg, "delete") << std::endl;
+
+	fs.UninstallVirtualDisk();
+	std::remove(c_benchmarkImagePath);
+}
+
+int main(int argc, char* argv[])
+{
+	//log is discarded (an un-opened stream), file I/O of logging shouldn't be measured
+	g_pLogFile = new std::ofstream;
+
+	std::string outputPath = "benchmark_FileSystem.jsonl";
+	bool isQuickMode = false;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::string(argv[i]) == "--quick")isQuickMode = true;
+		else outputPath = argv[i];
+	}
+
+	std::ofstream outFile(outputPath, std::ios::trunc);
+	if (!outFile.is_open())
+	{
+		std::cout << "benchmark: output file can't be created : " << outputPath << std::endl;
+		return 1;
+	}
+
+	struct { NOISE_VIRTUAL_DISK_CAPACITY cap; uint32_t mb; uint32_t inodeCount; } capacities[] =
+	{
+		{ NOISE_VIRTUAL_DISK_CAPACITY_128MB, 128, 16384 },
+		{ NOISE_VIRTUAL_DISK_CAPACITY_256MB, 256, 32768 },
+		{ NOISE_VIRTUAL_DISK_CAPACITY_512MB, 512, 65536 },
+		{ NOISE_VIRTUAL_DISK_CAPACITY_1GB, 1024, 131072 },
+	};
+	std::vector<uint32_t> fanOuts = { 10, 100, 1000, 10000, 100000 };
+	std::vector<uint32_t> depths = { 1, 4, 16 };
+	std::vector<uint32_t> fragmentations = { 0, 25, 50 };
+	if (isQuickMode)
+	{
+		fanOuts = { 10, 1000 };
+		depths = { 1, 8 };
+		fragmentations = { 0, 50 };
+	}
+
+	for (auto& c : capacities)
+	{
+		for (uint32_t fanOut : fanOuts)
+		{
+			//every file needs an i-node
+			if (fanOut + 32 >= c.inodeCount)continue;
+
+			for (uint32_t depth : depths)
+			{
+				for (uint32_t frag : fragmentations)
+				{
+					N_BenchmarkConfig cfg = { c.cap, c.mb, c.inodeCount, fanOut, depth, frag };
+					std::cout << "benchmark: " << c.mb << "MB fan-out=" << fanOut << " depth=" << depth << " fragmentation=" << frag << "%" << std::endl;
+					RunBenchmark(cfg, outFile);
+				}
+			}
+		}
+	}
+
+	outFile.close();
+	delete g_pLogFile;
+	return 0;
+}
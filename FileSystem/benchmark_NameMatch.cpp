@@ -0,0 +1,163 @@
+
+/***********************************************************************
+
+						cppDirectory Name Matching Benchmark
+
+			Desc: measure how many directory records per second a name
+			lookup scans. "legacy" is the former lookup (fixed 128-byte
+			records copied into std::vector then compared by std::string),
+			the other rows scan the packed hash array of a directory file
+			with every CNameMatcher kernel. the target is the last record
+			so that the whole directory is scanned. results are written
+			as one JSON object per line.
+
+			usage: benchmark_NameMatch [outputPath] [--quick]
+
+************************************************************************/
+
+#include "Noise3D.h"
+#include <chrono>
+#include <random>
+#include <sstream>
+
+using namespace Noise3D::Core;
+std::ofstream* g_pLogFile;
+
+static const uint64_t c_scannedRecordsPerMeasure = 200000000;//total records scanned by one measurement
+static const uint64_t c_legacyScannedRecordsPerMeasure = 5000000;//legacy lookup is much slower
+
+//record layout before packed directory files
+struct N_LegacyDirFileRecord
+{
+	N_LegacyDirFileRecord() { memset(name, 0, sizeof(name)); }
+	char name[124];
+	uint32_t indexNodeId;
+};
+
+struct N_NameMatchResult
+{
+	std::string kernel;
+	uint32_t fanOut;
+	uint64_t lookupCount;
+	uint64_t totalTimeNs;
+	bool isFound;
+};
+
+static std::string ToJson(const N_NameMatchResult& r)
+{
+	double seconds = double(r.totalTimeNs) / 1e9;
+	std::ostringstream ss;
+	ss << "{\"kernel\":\"" << r.kernel << "\""
+		<< ",\"fan_out\":" << r.fanOut
+		<< ",\"lookups\":" << r.lookupCount
+		<< ",\"ns_per_lookup\":" << (r.lookupCount == 0 ? 0 : r.totalTimeNs / r.lookupCount)
+		<< ",\"records_per_sec\":" << (seconds > 0 ? uint64_t(double(r.lookupCount) * r.fanOut / seconds) : 0)
+		<< ",\"found\":" << (r.isFound ? "true" : "false")
+		<< "}";
+	return ss.str();
+}
+
+template<typename Func>
+static N_NameMatchResult Measure(const std::string& kernel, uint32_t fanOut, uint64_t lookupCount, Func lookup)
+{
+	N_NameMatchResult result = { kernel, fanOut, lookupCount, 0, true };
+	auto t1 = std::chrono::high_resolution_clock::now();
+	for (uint64_t i = 0; i < lookupCount; ++i)result.isFound &= lookup();
+	auto t2 = std::chrono::high_resolution_clock::now();
+	result.totalTimeNs = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count());
+	return result;
+}
+
+static void RunBenchmark(uint32_t fanOut, std::ostream& out)
+{
+	std::mt19937 rng(fanOut);
+	std::vector<std::string> names;
+	for (uint32_t i = 0; i < fanOut; ++i)names.push_back("file_" + std::to_string(rng()) + "_" + std::to_string(i) + ".dat");
+	const std::string& target = names.back();
+
+	//legacy : fixed records in a directory file
+	std::vector<char> legacyDirFile(8 + size_t(fanOut) * sizeof(N_LegacyDirFileRecord));
+	for (uint32_t i = 0; i < fanOut; ++i)
+	{
+		N_LegacyDirFileRecord record;
+		memcpy(record.name, names.at(i).c_str(), names.at(i).size());
+		record.indexNodeId = i;
+		memcpy(&legacyDirFile.at(8 + size_t(i) * sizeof(record)), &record, sizeof(record));
+	}
+
+	//packed : hash array (the names are only touched on a hash hit, so they are left out).
+	//distinct random hashes, target hash is the last one
+	std::vector<char> hashArray(size_t(fanOut) * 4);
+	std::vector<uint32_t> hashes(fanOut);
+	uint32_t targetHash = rng() | 1;
+	for (uint32_t i = 0; i + 1 < fanOut; ++i)
+	{
+		hashes.at(i) = rng() & ~1u;
+	}
+	hashes.back() = targetHash;
+	memcpy(hashArray.data(), hashes.data(), hashArray.size());
+
+	uint64_t legacyLookupCount = std::max<uint64_t>(1, c_legacyScannedRecordsPerMeasure / fanOut);
+	out << ToJson(Measure("legacy", fanOut, legacyLookupCount, [&]()
+	{
+		std::vector<N_LegacyDirFileRecord> records(fanOut);
+		memcpy(records.data(), &legacyDirFile.at(8), size_t(fanOut) * sizeof(N_LegacyDirFileRecord));
+		for (auto& record : records)
+			if (record.name == target)return true;
+		return false;
+	})) << std::endl;
+
+	struct { NOISE_NAME_MATCH_KERNEL kernel; const char* name; } kernels[] =
+	{
+		{ NOISE_NAME_MATCH_KERNEL_SCALAR, "scalar" },
+		{ NOISE_NAME_MATCH_KERNEL_SSE2, "sse2" },
+		{ NOISE_NAME_MATCH_KERNEL_AVX2, "avx2" },
+	};
+	uint64_t lookupCount = std::max<uint64_t>(1, c_scannedRecordsPerMeasure / fanOut);
+	for (auto& k : kernels)
+	{
+		//unsupported kernels would silently fall back, so they are not reported
+		if (k.kernel > CNameMatcher::GetSupportedKernel())continue;
+		const char* pHashArray = hashArray.data();
+		out << ToJson(Measure(k.name, fanOut, lookupCount, [&]()
+		{
+			return CNameMatcher::FindHash(pHashArray, 0, fanOut, targetHash, k.kernel) == fanOut - 1;
+		})) << std::endl;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	g_pLogFile = new std::ofstream;
+
+	std::string outputPath = "benchmark_NameMatch.jsonl";
+	bool isQuickMode = false;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::string(argv[i]) == "--quick")isQuickMode = true;
+		else outputPath = argv[i];
+	}
+
+	std::ofstream outFile(outputPath, std::ios::trunc);
+	if (!outFile.is_open())
+	{
+		std::cout << "benchmark: output file can't be created : " << outputPath << std::endl;
+		return 1;
+	}
+
+	std::vector<uint32_t> fanOuts = { 8, 64, 512, 4096, 32768, 262144 };
+	if (isQuickMode)fanOuts = { 64, 4096 };
+
+	for (uint32_t fanOut : fanOuts)
+	{
+		std::cout << "benchmark: fan-out=" << fanOut << std::endl;
+		std::ostringstream lines;
+		RunBenchmark(fanOut, lines);
+		std::cout << lines.str();
+		outFile << lines.str();
+	}
+
+	outFile.close();
+	delete g_pLogFile;
+	return 0;
+}
@@ -0,0 +1,335 @@
+
+/***********************************************************************
+
+						cppTrace Replay
+
+			Desc: replay a trace recorded by IFileSystem::StartTraceRecording
+			against a fresh image or a copy of a snapshotted image,
+			and report per-operation latency as JSON lines.
+
+			usage: benchmark_TraceReplay <trace> [--image snapshot.nvd]
+						[--threads N] [--login user password] [--output out.jsonl]
+
+			--image		replay on a copy of the given image (the snapshot
+							itself is never modified), otherwise a fresh image
+							with the recorded geometry is created.
+			--threads	records are dispatched to N worker threads by the
+							thread id they were recorded with. IFileSystem is not
+							thread-safe, so calls are serialized by a lock; latency
+							is measured inside the lock (service time) and
+							including the lock wait (response time).
+
+			imports (of files, folders and archives) read the recorded
+			host paths. exports are written to scratch files next to the
+			replay image instead (removed after replay), and a later
+			import of an exported path reads its scratch file.
+
+************************************************************************/
+
+#include "Noise3D.h"
+#include <algorithm>
+#include <map>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace Noise3D::Core;
+std::ofstream* g_pLogFile;
+
+static const char* c_replayImagePath = "replay_tmp.nvd";
+
+static const char* OpName(uint8_t opCode)
+{
+	switch (opCode)
+	{
+	case NOISE_TRACE_OP_LOGIN: return "login";
+	case NOISE_TRACE_OP_SET_WORKING_DIR: return "set_working_dir";
+	case NOISE_TRACE_OP_CREATE_FOLDER: return "create_folder";
+	case NOISE_TRACE_OP_DELETE_FOLDER: return "delete_folder";
+	case NOISE_TRACE_OP_ENUMERATE: return "enumerate";
+	case NOISE_TRACE_OP_CREATE_FILE: return "create_file";
+	case NOISE_TRACE_OP_DELETE_FILE: return "delete_file";
+	case NOISE_TRACE_OP_OPEN_FILE: return "open_file";
+	case NOISE_TRACE_OP_CLOSE_FILE: return "close_file";
+	case NOISE_TRACE_OP_FILE_READ: return "read";
+	case NOISE_TRACE_OP_FILE_WRITE: return "write";
+	case NOISE_TRACE_OP_FILE_RESIZE: return "resize";
+	case NOISE_TRACE_OP_WALK: return "walk";
+	case NOISE_TRACE_OP_RENAME: return "rename";
+	case NOISE_TRACE_OP_CLONE_FILE: return "clone";
+	case NOISE_TRACE_OP_COMPRESS_FILE: return "compress";
+	case NOISE_TRACE_OP_IMPORT_FILE: return "import_file";
+	case NOISE_TRACE_OP_EXPORT_FILE: return "export_file";
+	case NOISE_TRACE_OP_IMPORT_DIRECTORY: return "import_directory";
+	case NOISE_TRACE_OP_EXPORT_ARCHIVE: return "export_archive";
+	case NOISE_TRACE_OP_IMPORT_ARCHIVE: return "import_archive";
+	default: return "unknown";
+	}
+}
+
+struct N_ReplayOpStat
+{
+	std::vector<uint64_t> serviceTime;
+	std::vector<uint64_t> responseTime;
+	uint32_t resultMismatchCount = 0;//result differs from the recorded one
+};
+
+class CTraceReplayer
+{
+public:
+
+	CTraceReplayer(IFileSystem& fs) :mFileSystem(fs) {}
+
+	void Replay(std::vector<N_TraceRecord>& records, uint32_t threadCount)
+	{
+		//dispatch records to worker threads
+		std::vector<std::vector<N_TraceRecord*>> perThreadRecords(threadCount);
+		for (auto& r : records)perThreadRecords.at(r.threadId % threadCount).push_back(&r);
+
+		std::vector<std::thread> workers;
+		for (uint32_t i = 0; i < threadCount; ++i)
+		{
+			workers.push_back(std::thread([this, &perThreadRecords, i]()
+			{
+				std::vector<char> buffer;
+				for (auto pRecord : perThreadRecords.at(i))mFunction_ReplayRecord(*pRecord, buffer);
+			}));
+		}
+		for (auto& w : workers)w.join();
+
+		//files that were left opened by the trace
+		for (auto& pair : mOpenedFiles)mFileSystem.CloseFile(pair.second);
+		mOpenedFiles.clear();
+
+		for (auto& pair : mExportedPaths)std::remove(pair.second.c_str());
+		mExportedPaths.clear();
+	}
+
+	void Report(std::ostream& out, uint32_t threadCount)
+	{
+		for (auto& pair : mStats)
+		{
+			auto& stat = pair.second;
+			uint64_t totalServiceTime = 0;
+			for (auto t : stat.serviceTime)totalServiceTime += t;
+			std::sort(stat.serviceTime.begin(), stat.serviceTime.end());
+			std::sort(stat.responseTime.begin(), stat.responseTime.end());
+			auto percentile = [](std::vector<uint64_t>& v, double p) ->uint64_t {return v.empty() ? 0 : v.at(size_t(p * double(v.size() - 1) + 0.5)); };
+
+			out << "{\"suite\":\"trace_replay\""
+				<< ",\"threads\":" << threadCount
+				<< ",\"op\":\"" << OpName(pair.first) << "\""
+				<< ",\"count\":" << stat.serviceTime.size()
+				<< ",\"result_mismatches\":" << stat.resultMismatchCount
+				<< ",\"ops_per_sec\":" << (totalServiceTime == 0 ? 0.0 : double(stat.serviceTime.size()) * 1e9 / double(totalServiceTime))
+				<< ",\"p50_ns\":" << percentile(stat.serviceTime, 0.5)
+				<< ",\"p99_ns\":" << percentile(stat.serviceTime, 0.99)
+				<< ",\"max_ns\":" << percentile(stat.serviceTime, 1.0)
+				<< ",\"response_p50_ns\":" << percentile(stat.responseTime, 0.5)
+				<< ",\"response_p99_ns\":" << percentile(stat.responseTime, 0.99)
+				<< "}" << std::endl;
+		}
+	}
+
+private:
+
+	//host path of recorded export -> scratch file it's replayed to
+	NFilePath mFunction_GetHostPath(const std::string& recordedPath, bool isExport)
+	{
+		auto iter = mExportedPaths.find(recordedPath);
+		if (iter != mExportedPaths.end())return iter->second;
+		if (!isExport)return recordedPath;
+		NFilePath scratchPath = std::string(c_replayImagePath) + ".export" + std::to_string(mExportedPaths.size());
+		mExportedPaths[recordedPath] = scratchPath;
+		return scratchPath;
+	}
+
+	void mFunction_ReplayRecord(const N_TraceRecord& r, std::vector<char>& buffer)
+	{
+		//password is not recorded, login is done once before replay
+		if (r.opCode == NOISE_TRACE_OP_LOGIN)return;
+		if (r.opCode == NOISE_TRACE_OP_FILE_READ || r.opCode == NOISE_TRACE_OP_FILE_WRITE)
+		{
+			if (buffer.size() < r.arg1)buffer.resize(size_t(r.arg1));
+		}
+
+		auto t0 = std::chrono::high_resolution_clock::now();
+		std::lock_guard<std::mutex> lock(mLock);
+		auto t1 = std::chrono::high_resolution_clock::now();
+
+		bool result = true;
+		switch (r.opCode)
+		{
+		case NOISE_TRACE_OP_SET_WORKING_DIR: result = mFileSystem.SetWorkingDir(r.name); break;
+		case NOISE_TRACE_OP_CREATE_FOLDER: result = mFileSystem.CreateFolder(r.name); break;
+		case NOISE_TRACE_OP_DELETE_FOLDER: result = mFileSystem.DeleteFolder(r.name); break;
+		case NOISE_TRACE_OP_ENUMERATE: { N_FileSystemEnumResult res; mFileSystem.EnumerateFilesAndDirs(res); break; }
+		case NOISE_TRACE_OP_WALK:
+		{
+			//recorded predicate is unknown, every child within the recorded depth matches
+			N_FileSystemWalkOptions options;
+			options.maxDepth = uint32_t(r.arg0);
+			result = mFileSystem.Walk(r.name, options, [](const char*, const N_IndexNode&, bool) {return true; }, [](const std::string&, const N_IndexNode&, bool) {});
+			break;
+		}
+		case NOISE_TRACE_OP_RENAME:
+		{
+			size_t separator = r.name.find('\0');
+			result = (separator != std::string::npos) && mFileSystem.Rename(r.name.substr(0, separator), r.name.substr(separator + 1));
+			break;
+		}
+		case NOISE_TRACE_OP_CLONE_FILE:
+		{
+			size_t separator = r.name.find('\0');
+			result = (separator != std::string::npos) && mFileSystem.CloneFile(r.name.substr(0, separator), r.name.substr(separator + 1));
+			break;
+		}
+		case NOISE_TRACE_OP_IMPORT_FILE:
+		case NOISE_TRACE_OP_IMPORT_DIRECTORY:
+		case NOISE_TRACE_OP_IMPORT_ARCHIVE:
+		{
+			size_t separator = r.name.find('\0');
+			if (separator == std::string::npos) { result = false; break; }
+			NFilePath hostPath = mFunction_GetHostPath(r.name.substr(0, separator), false);
+			std::string path = r.name.substr(separator + 1);
+			if (r.opCode == NOISE_TRACE_OP_IMPORT_FILE)result = mFileSystem.ImportFile(hostPath, path);
+			else if (r.opCode == NOISE_TRACE_OP_IMPORT_DIRECTORY)result = mFileSystem.ImportDirectory(hostPath, path);
+			else result = mFileSystem.ImportArchive(hostPath, path);
+			break;
+		}
+		case NOISE_TRACE_OP_EXPORT_FILE:
+		case NOISE_TRACE_OP_EXPORT_ARCHIVE:
+		{
+			size_t separator = r.name.find('\0');
+			if (separator == std::string::npos) { result = false; break; }
+			NFilePath hostPath = mFunction_GetHostPath(r.name.substr(separator + 1), true);
+			result = (r.opCode == NOISE_TRACE_OP_EXPORT_FILE) ?
+				mFileSystem.ExportFile(r.name.substr(0, separator), hostPath) :
+				mFileSystem.ExportArchive(r.name.substr(0, separator), hostPath);
+			break;
+		}
+		case NOISE_TRACE_OP_CREATE_FILE: result = mFileSystem.CreateFile(r.name, r.arg0, NOISE_FILE_ACCESS_MODE(r.arg1)); break;
+		case NOISE_TRACE_OP_DELETE_FILE: result = mFileSystem.DeleteFile(r.name); break;
+		case NOISE_TRACE_OP_COMPRESS_FILE: result = mFileSystem.CompressFile(r.name); break;
+		case NOISE_TRACE_OP_OPEN_FILE:
+		{
+			IFile* pFile = mFileSystem.OpenFile(r.name);
+			result = (pFile != nullptr);
+			if (pFile != nullptr)mOpenedFiles[r.fileHandle] = pFile;
+			break;
+		}
+		case NOISE_TRACE_OP_CLOSE_FILE:
+		case NOISE_TRACE_OP_FILE_READ:
+		case NOISE_TRACE_OP_FILE_WRITE:
+		case NOISE_TRACE_OP_FILE_RESIZE:
+		{
+			auto iter = mOpenedFiles.find(r.fileHandle);
+			if (iter == mOpenedFiles.end()) { result = false; break; }
+			if (r.opCode == NOISE_TRACE_OP_CLOSE_FILE)
+			{
+				result = mFileSystem.CloseFile(iter->second);
+				mOpenedFiles.erase(iter);
+			}
+			else if (r.opCode == NOISE_TRACE_OP_FILE_READ)
+			{
+				iter->second->Read(buffer.data(), r.arg0, r.arg1);
+			}
+			else if (r.opCode == NOISE_TRACE_OP_FILE_RESIZE)
+			{
+				result = iter->second->Resize(r.arg0);
+			}
+			else
+			{
+				result = iter->second->Write(buffer.data(), r.arg0, r.arg1);
+			}
+			break;
+		}
+		default:
+			return;
+		}
+
+		auto t2 = std::chrono::high_resolution_clock::now();
+		N_ReplayOpStat& stat = mStats[r.opCode];
+		stat.serviceTime.push_back(uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count()));
+		stat.responseTime.push_back(uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t0).count()));
+		if ((result ? 1 : 0) != r.result)++stat.resultMismatchCount;
+	}
+
+	IFileSystem& mFileSystem;
+	std::mutex mLock;
+	std::unordered_map<uint32_t, IFile*> mOpenedFiles;//trace file handle -> opened file
+	std::unordered_map<std::string, NFilePath> mExportedPaths;
+	std::map<uint8_t, N_ReplayOpStat> mStats;
+};
+
+static bool CopyImage(const std::string& srcPath, const std::string& dstPath)
+{
+	std::ifstream src(srcPath, std::ios::binary);
+	std::ofstream dst(dstPath, std::ios::binary | std::ios::trunc);
+	if (!src.is_open() || !dst.is_open())return false;
+	dst << src.rdbuf();
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	g_pLogFile = new std::ofstream;
+
+	if (argc < 2)
+	{
+		std::cout << "usage: benchmark_TraceReplay <trace> [--image snapshot.nvd] [--threads N] [--login user password] [--output out.jsonl]" << std::endl;
+		return 1;
+	}
+
+	std::string tracePath = argv[1];
+	std::string snapshotPath = "";
+	std::string outputPath = "benchmark_TraceReplay.jsonl";
+	std::string userName = "ROOT", password = "ROOT666666";
+	uint32_t threadCount = 1;
+	for (int i = 2; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--image" && i + 1 < argc)snapshotPath = argv[++i];
+		else if (arg == "--threads" && i + 1 < argc)threadCount = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "--output" && i + 1 < argc)outputPath = argv[++i];
+		else if (arg == "--login" && i + 2 < argc) { userName = argv[++i]; password = argv[++i]; }
+	}
+
+	CTraceReader reader;
+	if (!reader.Open(tracePath))
+	{
+		std::cout << "replay: trace can't be opened : " << tracePath << std::endl;
+		return 1;
+	}
+	std::vector<N_TraceRecord> records;
+	N_TraceRecord record;
+	while (reader.ReadNext(record))records.push_back(record);
+
+	N_VirtualDiskFormatOptions options;
+	options.capacity = reader.GetVDiskCapacity();
+	options.indexNodeCount = reader.GetIndexNodeCount();
+	options.blockSize = reader.GetBlockSize();
+
+	IFileSystem fs;
+	bool isImageReady = snapshotPath != "" ?
+		CopyImage(snapshotPath, c_replayImagePath) :
+		fs.CreateVirtualDisk(c_replayImagePath, options);
+	if (!isImageReady || !fs.InstallVirtualDisk(c_replayImagePath))
+	{
+		std::cout << "replay: virtual disk image can't be prepared." << std::endl;
+		return 1;
+	}
+	fs.Login(userName, password);
+
+	std::cout << "replay: " << records.size() << " records, " << threadCount << " thread(s)" << std::endl;
+	CTraceReplayer replayer(fs);
+	replayer.Replay(records, threadCount);
+
+	std::ofstream outFile(outputPath, std::ios::trunc);
+	replayer.Report(outFile, threadCount);
+	replayer.Report(std::cout, threadCount);
+
+	fs.UninstallVirtualDisk();
+	std::remove(c_replayImagePath);
+	delete g_pLogFile;
+	return 0;
+}
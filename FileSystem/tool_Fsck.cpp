@@ -0,0 +1,80 @@
+
+/***********************************************************************
+
+						cppFsck Tool
+
+			Desc: check (and optionally repair) a virtual disk image.
+
+			usage: tool_Fsck <image> [--repair] [--threads N]
+
+			exit code: 0 = consistent, 1 = problems found (or remain
+			after repair), 2 = image can't be installed
+
+************************************************************************/
+
+#include "Noise3D.h"
+#include <cstdlib>
+
+using namespace Noise3D::Core;
+std::ofstream* g_pLogFile;
+
+int main(int argc, char* argv[])
+{
+	g_pLogFile = new std::ofstream("fsck_log.txt", std::ios::trunc);
+
+	if (argc < 2)
+	{
+		std::cout << "usage: tool_Fsck <image> [--repair] [--threads N]" << std::endl;
+		return 2;
+	}
+
+	bool isRepairEnabled = false;
+	uint32_t threadCount = 0;
+	for (int i = 2; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--repair")isRepairEnabled = true;
+		else if (arg == "--threads" && i + 1 < argc)threadCount = uint32_t(std::max(0, std::atoi(argv[++i])));
+	}
+
+	IFileSystem fs;
+	if (!fs.InstallVirtualDisk(argv[1]))
+	{
+		std::cout << "fsck: image can't be installed (see fsck_log.txt)." << std::endl;
+		return 2;
+	}
+
+	auto t1 = std::chrono::high_resolution_clock::now();
+	CFileSystemChecker checker(fs);
+	N_FileSystemCheckReport report;
+	bool isConsistent = checker.Check(report, isRepairEnabled, threadCount);
+	auto t2 = std::chrono::high_resolution_clock::now();
+
+	for (auto& msg : report.messages)std::cout << msg << std::endl;
+	std::cout << "********************************" << std::endl;
+	std::cout << "directories : " << report.directoryCount << std::endl;
+	std::cout << "files : " << report.fileCount << std::endl;
+	std::cout << "used bytes : " << report.usedBytes << std::endl;
+	std::cout << "dangling dir records : " << report.danglingRecordCount << std::endl;
+	std::cout << "multiply linked i-nodes : " << report.multiplyLinkedINodeCount << std::endl;
+	std::cout << "dir size mismatches : " << report.dirSizeMismatchCount << std::endl;
+	std::cout << "duplicate names : " << report.duplicateNameCount << std::endl;
+	std::cout << "out of range extents : " << report.outOfRangeExtentCount << std::endl;
+	std::cout << "overlapping extents : " << report.overlappingExtentCount << std::endl;
+	std::cout << "leaked i-nodes : " << report.leakedINodeCount << std::endl;
+	std::cout << "allocators consistent : " << (report.isAllocatorConsistent ? "yes" : "no") << std::endl;
+	N_ChecksumReport checksumReport;
+	fs.GetChecksumReport(checksumReport);
+	std::cout << "i-node table checksum : " << (checksumReport.isIndexNodeTableCorrupted ? "mismatch" : "ok") << std::endl;
+	std::cout << "corrupted blocks : " << checksumReport.corruptedBlocks.size() << std::endl;
+	std::cout << "repaired : " << (report.isRepaired ? "yes" : "no") << std::endl;
+	std::cout << "check time : " << std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count() << " ms" << std::endl;
+	std::cout << (isConsistent ? "image is consistent." : "image is NOT consistent.") << std::endl;
+
+	//image is only written back when it has been repaired
+	if (report.isRepaired)fs.UninstallVirtualDisk();
+
+	g_pLogFile->close();
+	delete g_pLogFile;
+	return isConsistent ? 0 : 1;
+}
@@ -29,9 +29,41 @@ int main()
 	a.Release(7000, 1000);//2-side merge
 
 
-	uint32_t addr1 = a.Allocate(1000);//managed allocation (first fit)
-	uint32_t addr2 = a.Allocate(500);
-	uint32_t addr3 = a.Allocate(6000);//failed
+	uint64_t addr1 = a.Allocate(1000);//managed allocation (first fit)
+	uint64_t addr2 = a.Allocate(500);
+	uint64_t addr3 = a.Allocate(6000);//failed
+
+	CAllocator b(10000, NOISE_ALLOCATION_POLICY_BEST_FIT);
+	b.Allocate(1000, 100);
+	b.Allocate(1300, 100);
+	b.Allocate(1500, 8500);//free segments: [0,1000) [1100,1300) [1400,1500)
+	uint64_t addr4 = b.Allocate(100);//best fit:1400
+	uint64_t addr5 = b.Allocate(150);//best fit:1100
+	uint32_t freeSegCount = b.GetFreeSegmentCount();//2
+	uint64_t largestFree = b.GetLargestFreeSegmentSize();//1000
+
+	CAllocator c(6ull * 1024 * 1024 * 1024);//address space beyond 4GB
+	uint64_t addr6 = c.Allocate(5ull * 1024 * 1024 * 1024);//0
+	uint64_t addr7 = c.Allocate(1024);//5GB
+	bool isReleased = c.Release(addr6, 5ull * 1024 * 1024 * 1024);//true
+
+	CAllocator d(1000);
+	d.Allocate(0, 1000);
+	d.Release(500, 100);//free segments: [500,600)
+	std::vector<N_AddressRange> ranges = { N_AddressRange(600,50), N_AddressRange(0,100), N_AddressRange(100,20) };
+	bool isBatchReleased = d.ReleaseRanges(ranges);//true, free segments: [0,120) [500,650)
+	std::vector<N_AddressRange> badRanges = { N_AddressRange(200,10), N_AddressRange(640,20) };
+	bool isBadBatchReleased = d.ReleaseRanges(badRanges);//false, [640,650) is free already (nothing released)
+	uint32_t batchFreeSegCount = d.GetFreeSegmentCount();//2
+
+	CAllocator e(1000);
+	uint64_t sharedAddr = e.Allocate(100);//0
+	e.AddReference(sharedAddr);
+	e.AddReference(sharedAddr);//3 references
+	bool isRefReleased = e.Release(sharedAddr, 100);//true, still allocated
+	std::vector<N_AddressRange> sharedRanges = { N_AddressRange(sharedAddr,100), N_AddressRange(sharedAddr,100) };
+	bool isSharedBatchReleased = e.ReleaseRanges(sharedRanges);//true, last reference frees it
+	uint64_t sharedFreeSpace = e.GetFreeSpace();//1000
 
 	return 0;
 };
@@ -103,6 +103,129 @@ int main()
 	b = fs.DeleteFile("file3");
 	InfoOfWorkingDir();
 
+	//image file is verified against block checksums in background
+	b = fs.StartScrubber(64 * 1024 * 1024);//
+	b = fs.StartScrubber(64 * 1024 * 1024);//xxx
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	N_ChecksumReport checksumReport;
+	fs.GetChecksumReport(checksumReport);
+	DEBUG_MSG("verified bytes:" << checksumReport.verifiedBytes << "\t corrupted blocks:" << checksumReport.corruptedBlocks.size());
+	fs.StopScrubber();
+
+	//in-memory image is backed by huge pages when host allows it
+	DEBUG_MSG("huge page backed image bytes:" << fs.GetVDiskImageHugePageSize());
+
+	//online grow : user file space is relocated behind the enlarged i-node table
+	b = fs.GrowVirtualDisk(fs.GetVDiskCapacity() * 2);
+	b = fs.GrowVirtualDisk(fs.GetVDiskCapacity() / 2);//xxx
+	InfoOfWorkingDir();
+
+	//tiny file lies in its i-node, and moves to an extent when it grows
+	b = fs.CreateFile("tiny.txt", 16, NOISE_FILE_ACCESS_MODE_OWNER_RW);
+	IFile* pTinyFile = fs.OpenFile("tiny.txt");
+	b = pTinyFile->Resize(4096);//
+	b = pTinyFile->Resize(32);//
+	fs.CloseFile(pTinyFile);
+	InfoOfWorkingDir();
+
+	//find : every file larger than 100 bytes under /testLevel1
+	N_FileSystemWalkOptions walkOptions;
+	b = fs.Walk("/testLevel1", walkOptions,
+		[](const char* /*name*/, const N_IndexNode& node, bool /*isFolder*/) {return node.size > 100; },
+		[](const std::string& path, const N_IndexNode& node, bool /*isFolder*/) {DEBUG_MSG("found:" << path << "\t size:" << node.size); });
+	walkOptions.maxDepth = 1;
+	b = fs.Walk("/testLevel2", walkOptions, nullptr, nullptr);//xxx
+	b = fs.Walk("/testLevel1", walkOptions, nullptr, nullptr);//(count only)
+
+	//rename & move only rewrite directory entries
+	b = fs.Rename("file2", "file2_renamed");//
+	b = fs.Rename("/testLevel1/testLevel2/bottomFolder1", "/bottomFolder1_moved");//
+	b = fs.Rename("/testLevel1", "/testLevel1/testLevel2/inside");//xxx
+	InfoOfWorkingDir();
+
+	//attribute queries are answered by the metadata index (no i-node table scan)
+	b = fs.EnableMetadataIndex(true);
+	std::vector<N_MetadataIndexEntry> largestFiles;
+	fs.GetMetadataIndex()->GetLargestFiles(3, largestFiles);
+	uint64_t rootBytes = fs.GetMetadataIndex()->GetOwnerBytes(NOISE_FILE_OWNER_ROOT);
+	DEBUG_MSG("largest files:" << largestFiles.size() << "\t bytes owned by ROOT:" << rootBytes);
+	std::vector<N_MetadataIndexEntry> writableFiles;
+	fs.GetMetadataIndex()->GetFilesByAccessMode(NOISE_FILE_ACCESS_MODE_OWNER_WRITE, writableFiles);
+	b = fs.DeleteFile("file1");
+	uint32_t indexedFileCount = fs.GetMetadataIndex()->GetFileCount();
+	DEBUG_MSG("writable files:" << writableFiles.size() << "\t indexed files after deletion:" << indexedFileCount);
+
+	//clone shares the extent until one of them is written
+	b = fs.CreateFile("original.dat", 3000, NOISE_FILE_ACCESS_MODE_OWNER_RW);
+	b = fs.CloneFile("original.dat", "/cloned.dat");//
+	b = fs.CloneFile("original.dat", "/cloned.dat");//xxx
+	IFile* pOriginalFile = fs.OpenFile("original.dat");
+	char cowData[] = "copy on write";
+	pOriginalFile->Write(cowData, 0, sizeof(cowData));
+	fs.CloseFile(pOriginalFile);
+	InfoOfWorkingDir();
+
+	//snapshot keeps the state before rename, only modified blocks are copied
+	b = fs.CreateSnapshot();//
+	b = fs.CreateSnapshot();//xxx
+	b = fs.Rename("original.dat", "original_renamed.dat");
+	b = fs.WriteSnapshot("666_snapshot.nvd");//
+	fs.ReleaseSnapshot();
+
+	//identical files share one extent (cloned.dat is identical to original.dat before it was written)
+	b = fs.CreateFile("cloned_copy.dat", 3000, NOISE_FILE_ACCESS_MODE_OWNER_RW);
+	N_DedupReport dedupReport;
+	b = fs.DeduplicateFiles(dedupReport);
+	DEBUG_MSG("deduplicated files:" << dedupReport.dedupedFileCount << "\t saved bytes:" << dedupReport.savedBytes);
+
+	//compressed file is decompressed chunk by chunk when it's read
+	b = fs.CreateFile("compressed.txt", 200000, NOISE_FILE_ACCESS_MODE_OWNER_RW);
+	IFile* pCompressedFile = fs.OpenFile("compressed.txt");
+	std::string text;
+	while (text.size() < 200000)text += "compressed chunk " + std::to_string(text.size()) + "\n";
+	std::vector<char> textBuffer(text.begin(), text.begin() + 200000);
+	pCompressedFile->Write(&textBuffer.at(0), 0, 200000);
+	b = fs.CompressFile("compressed.txt");//xxx
+	fs.CloseFile(pCompressedFile);
+	b = fs.CompressFile("compressed.txt");//
+	pCompressedFile = fs.OpenFile("compressed.txt");
+	char compressedText[64] = { 0 };
+	pCompressedFile->Read(compressedText, 131000, 63);
+	DEBUG_MSG("read from compressed file:" << compressedText);
+	fs.CloseFile(pCompressedFile);
+
+	//small appends are gathered by write stream, reader follows with its own cursor
+	b = fs.CreateFile("stream.log", 0, NOISE_FILE_ACCESS_MODE_OWNER_RW);
+	IFile* pStreamFile = fs.OpenFile("stream.log");
+	{
+		CFileWriteStream writeStream(pStreamFile);
+		for (int i = 0; i < 1000; ++i)
+		{
+			std::string line = "stream line " + std::to_string(i) + "\n";
+			writeStream.Write(line.c_str(), line.size());
+		}
+	}
+	CFileReadStream readStream(pStreamFile, pStreamFile->GetFileSize() - 16);
+	char streamText[17] = { 0 };
+	readStream.Read(streamText, 16);
+	DEBUG_MSG("stream file size:" << pStreamFile->GetFileSize() << "\t tail:" << streamText);
+	fs.CloseFile(pStreamFile);
+
+	//files are copied between host and virtual disk straight into/out of their extents
+	b = fs.ExportFile("compressed.txt", "compressed_export.txt");//
+	b = fs.ImportFile("compressed_export.txt", "imported.txt");//
+	b = fs.ImportFile("compressed_export.txt", "imported.txt");//xxx
+	std::remove("compressed_export.txt");
+
+	//a subtree is moved between images as one sequential archive
+	b = fs.ExportArchive("/testLevel1", "subtree.narc");//
+	b = fs.ImportArchive("subtree.narc", "/archivedLevel1");//
+	std::remove("subtree.narc");
+
+	//read-only installs are refused while the image is installed for writing
+	IFileSystem readOnlyFs;
+	b = readOnlyFs.InstallVirtualDisk("666.nvd", true);//xxx
+
 	g_pLogFile->close();
 	delete g_pLogFile;
 	//fs.UninstallVirtualDisk();Ϳڴӳdebugȱдȥ